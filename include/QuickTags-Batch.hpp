@@ -0,0 +1,431 @@
+#pragma once
+#include "QuickTags.hpp"
+#include "QuickTags-Simd.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <type_traits>
+
+// Batch versions of QuickTag::Matches/MatchesExact, testing one query against a span of tags.
+//
+// The query is fixed for the whole batch, so its depth and prefix mask are worked out once and
+// each tag only needs a (value & mask) == query compare, which maps directly onto SIMD compares.
+// Results are written either as a bitmask (bit i of word i/64 is set when tags[i] matches), or
+// as a compacted list of matching indices.
+//
+// The kernels process blocks of 64 tags, one output word at a time, the tail is done in scalar.
+// The SSE2/AVX2/AVX-512 path is chosen at runtime through QTagUtil::Simd::GetLevel. 128 and 256-bit
+// base types compare whole tags with 64-bit (or byte) lane compares, then reduce the lanes per tag.
+
+namespace QTagUtil
+{
+  namespace Batch
+  {
+    static constexpr std::size_t BlockSize = 64;
+
+    // Number of uint64 words needed to hold the result bitmask for numTags tags
+    constexpr std::size_t GetNumResultWords(const std::size_t numTags)
+    {
+      return (numTags + BlockSize - 1) / BlockSize;
+    }
+
+    namespace Internal
+    {
+      template<class T>
+      inline std::uint64_t MatchBlockScalar(const T* values, const std::size_t count, const T mask, const T query)
+      {
+        std::uint64_t bits = 0;
+        for (std::size_t i = 0; i < count; ++i)
+        {
+          bits |= std::uint64_t(T(values[i] & mask) == query) << i;
+        }
+        return bits;
+      }
+
+#if QTAG_SIMD_X86
+      template<class T>
+      QTAG_TARGET("sse2") inline std::uint64_t MatchBlockSSE2(const T* values, const T mask, const T query)
+      {
+        std::uint64_t bits = 0;
+        const __m128i* ptr = reinterpret_cast<const __m128i*>(values);
+        if constexpr (sizeof(T) == 1)
+        {
+          const __m128i m = _mm_set1_epi8((char)mask);
+          const __m128i q = _mm_set1_epi8((char)query);
+          for (int i = 0; i < 4; ++i)
+          {
+            const __m128i eq = _mm_cmpeq_epi8(_mm_and_si128(_mm_loadu_si128(ptr + i), m), q);
+            bits |= std::uint64_t((std::uint16_t)_mm_movemask_epi8(eq)) << (i * 16);
+          }
+        }
+        else if constexpr (sizeof(T) == 2)
+        {
+          const __m128i m = _mm_set1_epi16((short)mask);
+          const __m128i q = _mm_set1_epi16((short)query);
+          for (int i = 0; i < 4; ++i)
+          {
+            // Saturating pack keeps 0/-1, giving one byte per lane for movemask
+            const __m128i eq0 = _mm_cmpeq_epi16(_mm_and_si128(_mm_loadu_si128(ptr + i * 2 + 0), m), q);
+            const __m128i eq1 = _mm_cmpeq_epi16(_mm_and_si128(_mm_loadu_si128(ptr + i * 2 + 1), m), q);
+            bits |= std::uint64_t((std::uint16_t)_mm_movemask_epi8(_mm_packs_epi16(eq0, eq1))) << (i * 16);
+          }
+        }
+        else if constexpr (sizeof(T) == 4)
+        {
+          const __m128i m = _mm_set1_epi32((int)mask);
+          const __m128i q = _mm_set1_epi32((int)query);
+          for (int i = 0; i < 4; ++i)
+          {
+            const __m128i eq0 = _mm_cmpeq_epi32(_mm_and_si128(_mm_loadu_si128(ptr + i * 4 + 0), m), q);
+            const __m128i eq1 = _mm_cmpeq_epi32(_mm_and_si128(_mm_loadu_si128(ptr + i * 4 + 1), m), q);
+            const __m128i eq2 = _mm_cmpeq_epi32(_mm_and_si128(_mm_loadu_si128(ptr + i * 4 + 2), m), q);
+            const __m128i eq3 = _mm_cmpeq_epi32(_mm_and_si128(_mm_loadu_si128(ptr + i * 4 + 3), m), q);
+            const __m128i packed = _mm_packs_epi16(_mm_packs_epi32(eq0, eq1), _mm_packs_epi32(eq2, eq3));
+            bits |= std::uint64_t((std::uint16_t)_mm_movemask_epi8(packed)) << (i * 16);
+          }
+        }
+        else if constexpr (sizeof(T) == 8)
+        {
+          // No 64-bit compare in SSE2, both 32-bit halves must match
+          const __m128i m = _mm_set1_epi64x((long long)mask);
+          const __m128i q = _mm_set1_epi64x((long long)query);
+          for (int i = 0; i < 32; ++i)
+          {
+            const __m128i eq32 = _mm_cmpeq_epi32(_mm_and_si128(_mm_loadu_si128(ptr + i), m), q);
+            const __m128i eq64 = _mm_and_si128(eq32, _mm_shuffle_epi32(eq32, _MM_SHUFFLE(2, 3, 0, 1)));
+            bits |= std::uint64_t(_mm_movemask_pd(_mm_castsi128_pd(eq64))) << (i * 2);
+          }
+        }
+        else if constexpr (sizeof(T) == 16)
+        {
+          // One tag per register, every byte must match
+          const __m128i m = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&mask));
+          const __m128i q = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&query));
+          for (int i = 0; i < 64; ++i)
+          {
+            const __m128i eq = _mm_cmpeq_epi8(_mm_and_si128(_mm_loadu_si128(ptr + i), m), q);
+            bits |= std::uint64_t(_mm_movemask_epi8(eq) == 0xFFFF) << i;
+          }
+        }
+        else
+        {
+          // Two registers per tag
+          const __m128i m0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&mask));
+          const __m128i m1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&mask) + 1);
+          const __m128i q0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&query));
+          const __m128i q1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&query) + 1);
+          for (int i = 0; i < 64; ++i)
+          {
+            const __m128i eq0 = _mm_cmpeq_epi8(_mm_and_si128(_mm_loadu_si128(ptr + i * 2 + 0), m0), q0);
+            const __m128i eq1 = _mm_cmpeq_epi8(_mm_and_si128(_mm_loadu_si128(ptr + i * 2 + 1), m1), q1);
+            bits |= std::uint64_t(_mm_movemask_epi8(_mm_and_si128(eq0, eq1)) == 0xFFFF) << i;
+          }
+        }
+        return bits;
+      }
+
+      template<class T>
+      QTAG_TARGET("avx2") inline std::uint64_t MatchBlockAVX2(const T* values, const T mask, const T query)
+      {
+        std::uint64_t bits = 0;
+        const __m256i* ptr = reinterpret_cast<const __m256i*>(values);
+        if constexpr (sizeof(T) == 1)
+        {
+          const __m256i m = _mm256_set1_epi8((char)mask);
+          const __m256i q = _mm256_set1_epi8((char)query);
+          for (int i = 0; i < 2; ++i)
+          {
+            const __m256i eq = _mm256_cmpeq_epi8(_mm256_and_si256(_mm256_loadu_si256(ptr + i), m), q);
+            bits |= std::uint64_t((std::uint32_t)_mm256_movemask_epi8(eq)) << (i * 32);
+          }
+        }
+        else if constexpr (sizeof(T) == 2)
+        {
+          const __m256i m = _mm256_set1_epi16((short)mask);
+          const __m256i q = _mm256_set1_epi16((short)query);
+          for (int i = 0; i < 2; ++i)
+          {
+            const __m256i eq0 = _mm256_cmpeq_epi16(_mm256_and_si256(_mm256_loadu_si256(ptr + i * 2 + 0), m), q);
+            const __m256i eq1 = _mm256_cmpeq_epi16(_mm256_and_si256(_mm256_loadu_si256(ptr + i * 2 + 1), m), q);
+            // Pack works per 128-bit lane, so restore order across lanes before movemask
+            const __m256i packed = _mm256_permute4x64_epi64(_mm256_packs_epi16(eq0, eq1), _MM_SHUFFLE(3, 1, 2, 0));
+            bits |= std::uint64_t((std::uint32_t)_mm256_movemask_epi8(packed)) << (i * 32);
+          }
+        }
+        else if constexpr (sizeof(T) == 4)
+        {
+          const __m256i m = _mm256_set1_epi32((int)mask);
+          const __m256i q = _mm256_set1_epi32((int)query);
+          for (int i = 0; i < 8; ++i)
+          {
+            const __m256i eq = _mm256_cmpeq_epi32(_mm256_and_si256(_mm256_loadu_si256(ptr + i), m), q);
+            bits |= std::uint64_t(_mm256_movemask_ps(_mm256_castsi256_ps(eq))) << (i * 8);
+          }
+        }
+        else if constexpr (sizeof(T) == 8)
+        {
+          const __m256i m = _mm256_set1_epi64x((long long)mask);
+          const __m256i q = _mm256_set1_epi64x((long long)query);
+          for (int i = 0; i < 16; ++i)
+          {
+            const __m256i eq = _mm256_cmpeq_epi64(_mm256_and_si256(_mm256_loadu_si256(ptr + i), m), q);
+            bits |= std::uint64_t(_mm256_movemask_pd(_mm256_castsi256_pd(eq))) << (i * 4);
+          }
+        }
+        else if constexpr (sizeof(T) == 16)
+        {
+          // Two tags per register, a tag matches when both of its 64-bit words do
+          const __m256i m = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(&mask)));
+          const __m256i q = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(&query)));
+          for (int i = 0; i < 32; ++i)
+          {
+            const __m256i eq = _mm256_cmpeq_epi64(_mm256_and_si256(_mm256_loadu_si256(ptr + i), m), q);
+            const unsigned int words = (unsigned int)_mm256_movemask_pd(_mm256_castsi256_pd(eq));
+            const unsigned int pairs = words & (words >> 1);
+            bits |= std::uint64_t((pairs & 1) | ((pairs >> 1) & 2)) << (i * 2);
+          }
+        }
+        else
+        {
+          // One tag per register
+          const __m256i m = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&mask));
+          const __m256i q = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&query));
+          for (int i = 0; i < 64; ++i)
+          {
+            const __m256i eq = _mm256_cmpeq_epi64(_mm256_and_si256(_mm256_loadu_si256(ptr + i), m), q);
+            bits |= std::uint64_t(_mm256_movemask_pd(_mm256_castsi256_pd(eq)) == 0xF) << i;
+          }
+        }
+        return bits;
+      }
+
+      template<class T>
+      QTAG_TARGET("avx512f,avx512bw") inline std::uint64_t MatchBlockAVX512(const T* values, const T mask, const T query)
+      {
+        std::uint64_t bits = 0;
+        if constexpr (sizeof(T) == 1)
+        {
+          const __m512i m = _mm512_set1_epi8((char)mask);
+          const __m512i q = _mm512_set1_epi8((char)query);
+          bits = _mm512_cmpeq_epi8_mask(_mm512_and_si512(_mm512_loadu_si512(values), m), q);
+        }
+        else if constexpr (sizeof(T) == 2)
+        {
+          const __m512i m = _mm512_set1_epi16((short)mask);
+          const __m512i q = _mm512_set1_epi16((short)query);
+          for (int i = 0; i < 2; ++i)
+          {
+            const __m512i v = _mm512_loadu_si512(values + i * 32);
+            bits |= std::uint64_t(_mm512_cmpeq_epi16_mask(_mm512_and_si512(v, m), q)) << (i * 32);
+          }
+        }
+        else if constexpr (sizeof(T) == 4)
+        {
+          const __m512i m = _mm512_set1_epi32((int)mask);
+          const __m512i q = _mm512_set1_epi32((int)query);
+          for (int i = 0; i < 4; ++i)
+          {
+            const __m512i v = _mm512_loadu_si512(values + i * 16);
+            bits |= std::uint64_t(_mm512_cmpeq_epi32_mask(_mm512_and_si512(v, m), q)) << (i * 16);
+          }
+        }
+        else if constexpr (sizeof(T) == 8)
+        {
+          const __m512i m = _mm512_set1_epi64((long long)mask);
+          const __m512i q = _mm512_set1_epi64((long long)query);
+          for (int i = 0; i < 8; ++i)
+          {
+            const __m512i v = _mm512_loadu_si512(values + i * 8);
+            bits |= std::uint64_t(_mm512_cmpeq_epi64_mask(_mm512_and_si512(v, m), q)) << (i * 8);
+          }
+        }
+        else if constexpr (sizeof(T) == 16)
+        {
+          // Four tags per register, keep the even bits where both words of a tag matched, then compact them
+          const __m512i m = _mm512_broadcast_i32x4(_mm_loadu_si128(reinterpret_cast<const __m128i*>(&mask)));
+          const __m512i q = _mm512_broadcast_i32x4(_mm_loadu_si128(reinterpret_cast<const __m128i*>(&query)));
+          for (int i = 0; i < 16; ++i)
+          {
+            const __m512i v = _mm512_loadu_si512(values + i * 4);
+            const unsigned int words = _mm512_cmpeq_epi64_mask(_mm512_and_si512(v, m), q);
+            unsigned int pairs = words & (words >> 1) & 0x55;
+            pairs = (pairs | (pairs >> 1)) & 0x33;
+            pairs = (pairs | (pairs >> 2)) & 0x0F;
+            bits |= std::uint64_t(pairs) << (i * 4);
+          }
+        }
+        else
+        {
+          // Two tags per register
+          const __m512i m = _mm512_broadcast_i64x4(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(&mask)));
+          const __m512i q = _mm512_broadcast_i64x4(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(&query)));
+          for (int i = 0; i < 32; ++i)
+          {
+            const __m512i v = _mm512_loadu_si512(values + i * 2);
+            const unsigned int words = _mm512_cmpeq_epi64_mask(_mm512_and_si512(v, m), q);
+            bits |= std::uint64_t(((words & 0x0F) == 0x0F) | (((words & 0xF0) == 0xF0) << 1)) << (i * 2);
+          }
+        }
+        return bits;
+      }
+
+      // One loop per ISA so the block function is inlined into a body compiled for the same target
+      template<class T>
+      QTAG_TARGET("sse2") inline void MatchBlocksSSE2(const T* values, const std::size_t numBlocks, const T mask, const T query, std::uint64_t* outBits)
+      {
+        for (std::size_t b = 0; b < numBlocks; ++b)
+        {
+          outBits[b] = MatchBlockSSE2(values + b * BlockSize, mask, query);
+        }
+      }
+
+      template<class T>
+      QTAG_TARGET("avx2") inline void MatchBlocksAVX2(const T* values, const std::size_t numBlocks, const T mask, const T query, std::uint64_t* outBits)
+      {
+        for (std::size_t b = 0; b < numBlocks; ++b)
+        {
+          outBits[b] = MatchBlockAVX2(values + b * BlockSize, mask, query);
+        }
+      }
+
+      template<class T>
+      QTAG_TARGET("avx512f,avx512bw") inline void MatchBlocksAVX512(const T* values, const std::size_t numBlocks, const T mask, const T query, std::uint64_t* outBits)
+      {
+        for (std::size_t b = 0; b < numBlocks; ++b)
+        {
+          outBits[b] = MatchBlockAVX512(values + b * BlockSize, mask, query);
+        }
+      }
+#endif
+
+      // Writes GetNumResultWords(count) words to outBits, bit set where (values[i] & mask) == query
+      template<class T>
+      void MatchMasked(const T* values, const std::size_t count, const T mask, const T query, std::uint64_t* outBits)
+      {
+        static_assert(IsQTagBaseType<T>, "Batch kernels expect a QuickTag base type");
+
+        const std::size_t numBlocks = count / BlockSize;
+        std::size_t b = 0;
+
+#if QTAG_SIMD_X86
+        // Kernels load whole power of two tags, other UIntN widths (24 bytes, over 32) stay scalar
+        if constexpr (std::has_single_bit(sizeof(T)) && sizeof(T) <= 32)
+        {
+          switch (Simd::GetLevel())
+          {
+          case Simd::ELevel::AVX512: MatchBlocksAVX512(values, numBlocks, mask, query, outBits); b = numBlocks; break;
+          case Simd::ELevel::AVX2  : MatchBlocksAVX2(values, numBlocks, mask, query, outBits); b = numBlocks; break;
+          case Simd::ELevel::SSE2  : MatchBlocksSSE2(values, numBlocks, mask, query, outBits); b = numBlocks; break;
+          default: break;
+          }
+        }
+#endif
+
+        for (; b < numBlocks; ++b)
+        {
+          outBits[b] = MatchBlockScalar(values + b * BlockSize, BlockSize, mask, query);
+        }
+
+        const std::size_t tail = count - numBlocks * BlockSize;
+        if (tail > 0)
+        {
+          outBits[numBlocks] = MatchBlockScalar(values + numBlocks * BlockSize, tail, mask, query);
+        }
+      }
+
+      // Same as MatchMasked, but writes the indices of matching values instead, returns how many were written
+      // outIndices must have space for count indices (the worst case)
+      template<class T>
+      std::size_t MatchMaskedIndices(const T* values, const std::size_t count, const T mask, const T query, std::uint32_t* outIndices)
+      {
+        // Run the bitmask kernel over chunks small enough for the stack, then compact
+        constexpr std::size_t ChunkWords = 64;
+        constexpr std::size_t ChunkSize = ChunkWords * BlockSize;
+        std::uint64_t chunkBits[ChunkWords];
+
+        std::size_t numWritten = 0;
+        for (std::size_t chunkStart = 0; chunkStart < count; chunkStart += ChunkSize)
+        {
+          const std::size_t chunkCount = (count - chunkStart) < ChunkSize ? (count - chunkStart) : ChunkSize;
+          MatchMasked(values + chunkStart, chunkCount, mask, query, chunkBits);
+
+          const std::size_t numWords = GetNumResultWords(chunkCount);
+          for (std::size_t w = 0; w < numWords; ++w)
+          {
+            std::uint64_t bits = chunkBits[w];
+            const std::uint32_t base = std::uint32_t(chunkStart + w * BlockSize);
+            while (bits)
+            {
+              outIndices[numWritten++] = base + (std::uint32_t)std::countr_zero(bits);
+              bits &= bits - 1; // Clear lowest set bit
+            }
+          }
+        }
+        return numWritten;
+      }
+
+      template<class QTag>
+      const typename QTag::TagBaseType* GetRawValues(std::span<const QTag> tags)
+      {
+        // QuickTag is just its Value, so a span of tags can be read as a span of raw values
+        static_assert(sizeof(QTag) == sizeof(typename QTag::TagBaseType) && std::is_standard_layout_v<QTag>);
+        return reinterpret_cast<const typename QTag::TagBaseType*>(tags.data());
+      }
+    }
+  }
+
+  // Bitmask of tags[i].Matches(query), outBits must hold at least Batch::GetNumResultWords(tags.size()) words
+  template<class QTag>
+  void MatchesBatch(std::span<const std::type_identity_t<QTag>> tags, const QTag query, std::span<std::uint64_t> outBits)
+  {
+    using BaseType = typename QTag::TagBaseType;
+    if (!query.IsValid())
+    {
+      std::fill_n(outBits.data(), Batch::GetNumResultWords(tags.size()), std::uint64_t(0));
+      return;
+    }
+    const BaseType mask = QTag::GetPrefixMask(query.GetDepth());
+    Batch::Internal::MatchMasked(Batch::Internal::GetRawValues(tags), tags.size(), mask, query.GetRaw(), outBits.data());
+  }
+
+  // Bitmask of tags[i].MatchesExact(query), outBits must hold at least Batch::GetNumResultWords(tags.size()) words
+  template<class QTag>
+  void MatchesExactBatch(std::span<const std::type_identity_t<QTag>> tags, const QTag query, std::span<std::uint64_t> outBits)
+  {
+    using BaseType = typename QTag::TagBaseType;
+    if (!query.IsValid())
+    {
+      std::fill_n(outBits.data(), Batch::GetNumResultWords(tags.size()), std::uint64_t(0));
+      return;
+    }
+    Batch::Internal::MatchMasked(Batch::Internal::GetRawValues(tags), tags.size(), BaseType(~BaseType(0)), query.GetRaw(), outBits.data());
+  }
+
+  // Indices of tags matching query, outIndices must hold tags.size() entries, returns the number written
+  template<class QTag>
+  std::size_t MatchesBatchIndices(std::span<const std::type_identity_t<QTag>> tags, const QTag query, std::span<std::uint32_t> outIndices)
+  {
+    using BaseType = typename QTag::TagBaseType;
+    if (!query.IsValid())
+    {
+      return 0;
+    }
+    const BaseType mask = QTag::GetPrefixMask(query.GetDepth());
+    return Batch::Internal::MatchMaskedIndices(Batch::Internal::GetRawValues(tags), tags.size(), mask, query.GetRaw(), outIndices.data());
+  }
+
+  // Indices of tags exactly equal to query, outIndices must hold tags.size() entries, returns the number written
+  template<class QTag>
+  std::size_t MatchesExactBatchIndices(std::span<const std::type_identity_t<QTag>> tags, const QTag query, std::span<std::uint32_t> outIndices)
+  {
+    using BaseType = typename QTag::TagBaseType;
+    if (!query.IsValid())
+    {
+      return 0;
+    }
+    return Batch::Internal::MatchMaskedIndices(Batch::Internal::GetRawValues(tags), tags.size(), BaseType(~BaseType(0)), query.GetRaw(), outIndices.data());
+  }
+}
@@ -0,0 +1,452 @@
+#pragma once
+#include "QuickTags.hpp"
+#include "QuickTags-Container.hpp"
+#include "QuickTags-Loader.hpp"
+#include "QuickTags-Simd.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <span>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// A tag set as one bit per known tag, for when entities carry many tags out of a few thousand.
+//
+// QuickTagOrdinalTable gives every tag in the loaded set a dense ordinal (its index in sorted
+// order) and precomputes each tag's ancestor closure: a bitset of the tag itself plus all of its
+// parents. A QuickTagBitset keeps the tags that were added (Explicit) and the union of their
+// closures (Implicit), so the hierarchical queries reduce to word loops with no per-tag branching:
+//   HasTag(q)       Implicit[q]
+//   HasAny(other)   (Implicit & other.Explicit) != 0
+//   HasAll(other)   (other.Explicit & ~Implicit) == 0
+// with the same results as the matching QuickTagContainer queries.
+//
+// Closures take NumTags * NumTags bits, about 2MB for 4096 tags. Bitsets that are compared must
+// share the same ordinal table.
+
+namespace QTagUtil
+{
+  namespace Bitset
+  {
+    namespace Internal
+    {
+      inline std::uint64_t AnyAndScalar(const std::uint64_t* a, const std::uint64_t* b, const std::size_t numWords)
+      {
+        std::uint64_t any = 0;
+        for (std::size_t w = 0; w < numWords; ++w)
+        {
+          any |= a[w] & b[w];
+        }
+        return any;
+      }
+
+      // Bits set in b but not in a
+      inline std::uint64_t AnyAndNotScalar(const std::uint64_t* a, const std::uint64_t* b, const std::size_t numWords)
+      {
+        std::uint64_t any = 0;
+        for (std::size_t w = 0; w < numWords; ++w)
+        {
+          any |= b[w] & ~a[w];
+        }
+        return any;
+      }
+
+      inline void OrIntoScalar(std::uint64_t* dst, const std::uint64_t* src, const std::size_t numWords)
+      {
+        for (std::size_t w = 0; w < numWords; ++w)
+        {
+          dst[w] |= src[w];
+        }
+      }
+
+#if QTAG_SIMD_X86
+      QTAG_TARGET("avx2") inline std::uint64_t AnyAndAVX2(const std::uint64_t* a, const std::uint64_t* b, const std::size_t numWords)
+      {
+        __m256i acc = _mm256_setzero_si256();
+        std::size_t w = 0;
+        for (; w + 4 <= numWords; w += 4)
+        {
+          const __m256i va = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + w));
+          const __m256i vb = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + w));
+          acc = _mm256_or_si256(acc, _mm256_and_si256(va, vb));
+        }
+        return std::uint64_t(!_mm256_testz_si256(acc, acc)) | AnyAndScalar(a + w, b + w, numWords - w);
+      }
+
+      QTAG_TARGET("avx2") inline std::uint64_t AnyAndNotAVX2(const std::uint64_t* a, const std::uint64_t* b, const std::size_t numWords)
+      {
+        __m256i acc = _mm256_setzero_si256();
+        std::size_t w = 0;
+        for (; w + 4 <= numWords; w += 4)
+        {
+          const __m256i va = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + w));
+          const __m256i vb = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + w));
+          acc = _mm256_or_si256(acc, _mm256_andnot_si256(va, vb));
+        }
+        return std::uint64_t(!_mm256_testz_si256(acc, acc)) | AnyAndNotScalar(a + w, b + w, numWords - w);
+      }
+
+      QTAG_TARGET("avx2") inline void OrIntoAVX2(std::uint64_t* dst, const std::uint64_t* src, const std::size_t numWords)
+      {
+        std::size_t w = 0;
+        for (; w + 4 <= numWords; w += 4)
+        {
+          const __m256i vd = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(dst + w));
+          const __m256i vs = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + w));
+          _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + w), _mm256_or_si256(vd, vs));
+        }
+        OrIntoScalar(dst + w, src + w, numWords - w);
+      }
+#endif
+
+      // Short sets aren't worth the dispatch
+      inline bool UseAVX2(const std::size_t numWords)
+      {
+#if QTAG_SIMD_X86
+        return numWords >= 8 && Simd::GetLevel() >= Simd::ELevel::AVX2;
+#else
+        (void)numWords;
+        return false;
+#endif
+      }
+
+      inline bool AnyAnd(const std::uint64_t* a, const std::uint64_t* b, const std::size_t numWords)
+      {
+#if QTAG_SIMD_X86
+        if (UseAVX2(numWords))
+        {
+          return AnyAndAVX2(a, b, numWords) != 0;
+        }
+#endif
+        return AnyAndScalar(a, b, numWords) != 0;
+      }
+
+      inline bool AnyAndNot(const std::uint64_t* a, const std::uint64_t* b, const std::size_t numWords)
+      {
+#if QTAG_SIMD_X86
+        if (UseAVX2(numWords))
+        {
+          return AnyAndNotAVX2(a, b, numWords) != 0;
+        }
+#endif
+        return AnyAndNotScalar(a, b, numWords) != 0;
+      }
+
+      inline void OrInto(std::uint64_t* dst, const std::uint64_t* src, const std::size_t numWords)
+      {
+#if QTAG_SIMD_X86
+        if (UseAVX2(numWords))
+        {
+          OrIntoAVX2(dst, src, numWords);
+          return;
+        }
+#endif
+        OrIntoScalar(dst, src, numWords);
+      }
+
+      inline std::size_t PopCount(const std::uint64_t* words, const std::size_t numWords)
+      {
+        std::size_t count = 0;
+        for (std::size_t w = 0; w < numWords; ++w)
+        {
+          count += (std::size_t)std::popcount(words[w]);
+        }
+        return count;
+      }
+    }
+  }
+}
+
+// Dense ordinals and ancestor closures for a fixed set of tags
+template<class QTag>
+class QuickTagOrdinalTable
+{
+public:
+  static constexpr std::uint32_t InvalidOrdinal = ~std::uint32_t(0);
+
+  // Build from trees that have been through TreeifyTags and EnumerateTags, ancestors come from the
+  // ParentTag chain. Tags deeper than the tag type are left out, as in QuickTagNameTable.
+  void Build(const std::list<QTagUtil::TagTreeNode>& tagTrees)
+  {
+    std::vector<std::pair<QTag, const QTagUtil::TagTreeNode*>> tagNodes;
+    for (const QTagUtil::TagTreeNode& tree : tagTrees)
+    {
+      CollectNodes(tree, QTag(), 0, tagNodes);
+    }
+    std::sort(tagNodes.begin(), tagNodes.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+
+    Tags.clear();
+    std::unordered_map<const QTagUtil::TagTreeNode*, std::uint32_t> nodeOrdinals;
+    nodeOrdinals.reserve(tagNodes.size());
+    for (const std::pair<QTag, const QTagUtil::TagTreeNode*>& tagNode : tagNodes)
+    {
+      nodeOrdinals.emplace(tagNode.second, (std::uint32_t)Tags.size());
+      Tags.push_back(tagNode.first);
+    }
+
+    ResizeClosures();
+    for (std::uint32_t ordinal = 0; ordinal < (std::uint32_t)Tags.size(); ++ordinal)
+    {
+      std::uint64_t* closure = GetClosureWords(ordinal);
+      SetBit(closure, ordinal);
+      for (const QTagUtil::TagTreeNode* parent = tagNodes[ordinal].second->ParentTag; parent; parent = parent->ParentTag)
+      {
+        SetBit(closure, nodeOrdinals.at(parent));
+      }
+    }
+  }
+
+  // Build from sorted, unique, valid tags, e.g. QuickTagNameTable::GetTags or TagRegistry::GetTags
+  // Ancestors are whichever prefixes of each tag are also in the set
+  void Build(std::span<const QTag> sortedTags)
+  {
+    Tags.assign(sortedTags.begin(), sortedTags.end());
+
+    ResizeClosures();
+    for (std::uint32_t ordinal = 0; ordinal < (std::uint32_t)Tags.size(); ++ordinal)
+    {
+      std::uint64_t* closure = GetClosureWords(ordinal);
+      SetBit(closure, ordinal);
+      for (int depth = Tags[ordinal].GetDepth() - 1; depth > 0; --depth)
+      {
+        const std::uint32_t parentOrdinal = FindOrdinal(QTag(Tags[ordinal].GetRaw() & QTag::GetPrefixMask(depth)));
+        if (parentOrdinal != InvalidOrdinal)
+        {
+          SetBit(closure, parentOrdinal);
+        }
+      }
+    }
+  }
+
+  std::uint32_t FindOrdinal(const QTag tag) const
+  {
+    typename std::vector<QTag>::const_iterator it = std::lower_bound(Tags.begin(), Tags.end(), tag);
+    if (it == Tags.end() || *it != tag)
+    {
+      return InvalidOrdinal;
+    }
+    return std::uint32_t(it - Tags.begin());
+  }
+
+  QTag GetTag(const std::uint32_t ordinal) const { return Tags[ordinal]; }
+
+  // All tags in ordinal order, which is sorted order
+  std::span<const QTag> GetTags() const { return Tags; }
+  std::size_t Num() const { return Tags.size(); }
+  std::size_t GetNumWords() const { return NumWords; }
+
+  // The tag's own bit plus its ancestors' bits, GetNumWords() long
+  std::span<const std::uint64_t> GetClosure(const std::uint32_t ordinal) const
+  {
+    return std::span<const std::uint64_t>(Closures.data() + ordinal * NumWords, NumWords);
+  }
+
+  std::size_t GetMemoryUsage() const
+  {
+    return Tags.capacity() * sizeof(QTag) + Closures.capacity() * sizeof(std::uint64_t);
+  }
+
+private:
+  void CollectNodes(const QTagUtil::TagTreeNode& node, QTag tag, const int depth, std::vector<std::pair<QTag, const QTagUtil::TagTreeNode*>>& outTagNodes)
+  {
+    // Tree is deeper than the tag type, nothing below here can be represented
+    if (depth >= (int)QTag::GetNumFields())
+    {
+      return;
+    }
+
+    tag.SetField((unsigned char)depth, (typename QTag::TagBaseType)node.TagAsInt);
+    outTagNodes.emplace_back(tag, &node);
+    for (const QTagUtil::TagTreeNode& subTag : node.SubTags)
+    {
+      CollectNodes(subTag, tag, depth + 1, outTagNodes);
+    }
+  }
+
+  void ResizeClosures()
+  {
+    Tags.shrink_to_fit();
+    NumWords = (Tags.size() + 63) / 64;
+    Closures.assign(Tags.size() * NumWords, 0);
+    Closures.shrink_to_fit();
+  }
+
+  std::uint64_t* GetClosureWords(const std::uint32_t ordinal) { return Closures.data() + ordinal * NumWords; }
+
+  static void SetBit(std::uint64_t* words, const std::uint32_t ordinal)
+  {
+    words[ordinal / 64] |= std::uint64_t(1) << (ordinal % 64);
+  }
+
+  std::vector<QTag> Tags;
+  std::vector<std::uint64_t> Closures; // Tags.size() rows of NumWords words
+  std::size_t NumWords = 0;
+};
+
+// Set of tags from one QuickTagOrdinalTable, which must outlive it
+// Tags that aren't in the table can't be added
+template<class QTag>
+class QuickTagBitset
+{
+public:
+  using OrdinalTable = QuickTagOrdinalTable<QTag>;
+
+  QuickTagBitset()
+    : Table(nullptr)
+  {}
+
+  explicit QuickTagBitset(const OrdinalTable& table)
+    : Table(&table)
+    , Explicit(table.GetNumWords(), 0)
+    , Implicit(table.GetNumWords(), 0)
+  {}
+
+  template<std::size_t InlineCapacity>
+  QuickTagBitset(const OrdinalTable& table, const QuickTagContainer<QTag, InlineCapacity>& container)
+    : QuickTagBitset(table)
+  {
+    AddTags(std::span<const QTag>(container.GetData(), container.Num()));
+  }
+
+  // Adds tag if it is in the table and not already present, returns true if the bitset changed
+  bool AddTag(const QTag& tag)
+  {
+    const std::uint32_t ordinal = Table ? Table->FindOrdinal(tag) : OrdinalTable::InvalidOrdinal;
+    if (ordinal == OrdinalTable::InvalidOrdinal || TestBit(Explicit, ordinal))
+    {
+      return false;
+    }
+
+    Explicit[ordinal / 64] |= std::uint64_t(1) << (ordinal % 64);
+    QTagUtil::Bitset::Internal::OrInto(Implicit.data(), Table->GetClosure(ordinal).data(), Implicit.size());
+    return true;
+  }
+
+  // Returns the number of tags added
+  std::size_t AddTags(std::span<const QTag> tags)
+  {
+    std::size_t numAdded = 0;
+    for (const QTag& tag : tags)
+    {
+      numAdded += AddTag(tag);
+    }
+    return numAdded;
+  }
+
+  // Removes exactly tag (descendants are left alone), returns true if the bitset changed
+  bool RemoveTag(const QTag& tag)
+  {
+    const std::uint32_t ordinal = Table ? Table->FindOrdinal(tag) : OrdinalTable::InvalidOrdinal;
+    if (ordinal == OrdinalTable::InvalidOrdinal || !TestBit(Explicit, ordinal))
+    {
+      return false;
+    }
+
+    Explicit[ordinal / 64] &= ~(std::uint64_t(1) << (ordinal % 64));
+    // Other tags can share ancestors, so rebuild the closure union from what is left
+    std::fill(Implicit.begin(), Implicit.end(), std::uint64_t(0));
+    ForEachOrdinal([this](const std::uint32_t remaining)
+      {
+        QTagUtil::Bitset::Internal::OrInto(Implicit.data(), Table->GetClosure(remaining).data(), Implicit.size());
+      });
+    return true;
+  }
+
+  // "A.1" in bitset: HasTag("A") is True, HasTag("A.1") is True, HasTag("A.1.2") is False
+  bool HasTag(const QTag& tagToMatch) const
+  {
+    const std::uint32_t ordinal = Table ? Table->FindOrdinal(tagToMatch) : OrdinalTable::InvalidOrdinal;
+    return ordinal != OrdinalTable::InvalidOrdinal && TestBit(Implicit, ordinal);
+  }
+
+  bool HasTagExact(const QTag& tagToMatch) const
+  {
+    const std::uint32_t ordinal = Table ? Table->FindOrdinal(tagToMatch) : OrdinalTable::InvalidOrdinal;
+    return ordinal != OrdinalTable::InvalidOrdinal && TestBit(Explicit, ordinal);
+  }
+
+  // True if any tag in other is matched (hierarchically) by a tag in this bitset
+  // Empty other returns False
+  bool HasAny(const QuickTagBitset& other) const
+  {
+    return QTagUtil::Bitset::Internal::AnyAnd(Implicit.data(), other.Explicit.data(), std::min(Implicit.size(), other.Explicit.size()));
+  }
+
+  // True if every tag in other is matched (hierarchically) by a tag in this bitset
+  // Empty other returns True
+  bool HasAll(const QuickTagBitset& other) const
+  {
+    return !QTagUtil::Bitset::Internal::AnyAndNot(Implicit.data(), other.Explicit.data(), std::min(Implicit.size(), other.Explicit.size()));
+  }
+
+  // True if no tag in other is matched by a tag in this bitset
+  bool HasNone(const QuickTagBitset& other) const
+  {
+    return !HasAny(other);
+  }
+
+  void Reset()
+  {
+    std::fill(Explicit.begin(), Explicit.end(), std::uint64_t(0));
+    std::fill(Implicit.begin(), Implicit.end(), std::uint64_t(0));
+  }
+
+  std::size_t Num() const { return QTagUtil::Bitset::Internal::PopCount(Explicit.data(), Explicit.size()); }
+  bool IsEmpty() const { return !QTagUtil::Bitset::Internal::AnyAnd(Explicit.data(), Explicit.data(), Explicit.size()); }
+
+  const OrdinalTable* GetTable() const { return Table; }
+  std::span<const std::uint64_t> GetExplicitWords() const { return Explicit; }
+  std::span<const std::uint64_t> GetImplicitWords() const { return Implicit; }
+
+  // Calls visitor(ordinal) for each added tag, in ascending (sorted tag) order
+  template<class Visitor>
+  void ForEachOrdinal(Visitor&& visitor) const
+  {
+    for (std::size_t w = 0; w < Explicit.size(); ++w)
+    {
+      std::uint64_t bits = Explicit[w];
+      while (bits)
+      {
+        visitor(std::uint32_t(w * 64 + (std::size_t)std::countr_zero(bits)));
+        bits &= bits - 1; // Clear lowest set bit
+      }
+    }
+  }
+
+  // Appends the added tags in sorted order, the sorted vector form
+  void GetTags(std::vector<QTag>& outTags) const
+  {
+    outTags.reserve(outTags.size() + Num());
+    ForEachOrdinal([&](const std::uint32_t ordinal)
+      {
+        outTags.push_back(Table->GetTag(ordinal));
+      });
+  }
+
+  template<std::size_t InlineCapacity>
+  void GetTags(QuickTagContainer<QTag, InlineCapacity>& outContainer) const
+  {
+    outContainer.Reserve(outContainer.Num() + Num());
+    ForEachOrdinal([&](const std::uint32_t ordinal)
+      {
+        outContainer.AddTag(Table->GetTag(ordinal));
+      });
+  }
+
+  bool operator==(const QuickTagBitset& rhs) const { return Table == rhs.Table && Explicit == rhs.Explicit; }
+  bool operator!=(const QuickTagBitset& rhs) const { return !(*this == rhs); }
+
+private:
+  static bool TestBit(const std::vector<std::uint64_t>& words, const std::uint32_t ordinal)
+  {
+    return (words[ordinal / 64] >> (ordinal % 64)) & 1;
+  }
+
+  const OrdinalTable* Table;
+  std::vector<std::uint64_t> Explicit; // Tags added
+  std::vector<std::uint64_t> Implicit; // Union of the added tags' ancestor closures
+};
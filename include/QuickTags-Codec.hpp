@@ -0,0 +1,552 @@
+#pragma once
+#include "QuickTags.hpp"
+#include "QuickTags-Container.hpp"
+#include "QuickTags-Simd.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <vector>
+
+// Compact encoding of sorted tag sets for replication and save files.
+//
+// A stream starts with a header recording the QTag's field layout, so a decoder built for a
+// different layout refuses it, then holds any number of sets back to back. Each set is a varint
+// count followed by its tags in one of two modes:
+//
+// Prefix mode (no dictionary): each tag stores only the fields after the ones it shares with the
+// tag before it. A header byte (shared fields << 4 | new fields, or two varints past 15 fields) is
+// followed by the new fields as varints, the first as a delta from the previous tag's field where
+// they share a parent. Siblings cost two bytes whatever the base type.
+//
+// Dictionary mode: both ends hold the same sorted registry tags (QuickTagNameTable::GetTags,
+// TagRegistry::GetTags...) and each tag is the delta between its index and the previous one's.
+// Deltas are written as Stream VByte: one control byte per four deltas giving each one's length,
+// then the bytes, so AVX2 machines decode four at a time with a byte shuffle. The header records the
+// dictionary's size, a decoder with a different sized dictionary refuses the stream.
+
+namespace QTagUtil
+{
+  namespace Codec
+  {
+    static constexpr char Magic[4] = { 'Q', 'T', 'S', 'C' };
+    static constexpr std::uint8_t Version = 1;
+
+    enum class EMode : std::uint8_t
+    {
+      Prefix = 0,
+      Dictionary = 1
+    };
+
+    inline void WriteVarint(std::vector<std::uint8_t>& out, std::uint64_t value)
+    {
+      while (value >= 0x80)
+      {
+        out.push_back(std::uint8_t(value | 0x80));
+        value >>= 7;
+      }
+      out.push_back(std::uint8_t(value));
+    }
+
+    // Returns false on a truncated or over-long varint
+    inline bool ReadVarint(const std::uint8_t*& pos, const std::uint8_t* const end, std::uint64_t& outValue)
+    {
+      outValue = 0;
+      for (unsigned int shift = 0; shift < 64 && pos < end; shift += 7)
+      {
+        const std::uint8_t byte = *pos++;
+        outValue |= std::uint64_t(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0)
+        {
+          return true;
+        }
+      }
+      return false;
+    }
+
+    namespace Internal
+    {
+      // Stream VByte length code for a delta, bytes - 1
+      inline std::uint8_t GetLengthCode(const std::uint32_t value)
+      {
+        return std::uint8_t((value > 0xFF) + (value > 0xFFFF) + (value > 0xFFFFFF));
+      }
+
+      struct StreamVByteTables
+      {
+        std::uint8_t Lengths[256];           // Data bytes for each control byte
+        std::uint8_t Shuffles[256][16];      // pshufb masks widening each delta to 32 bits
+      };
+
+      constexpr StreamVByteTables GenStreamVByteTables()
+      {
+        StreamVByteTables tables = {};
+        for (int control = 0; control < 256; ++control)
+        {
+          std::uint8_t offset = 0;
+          for (int lane = 0; lane < 4; ++lane)
+          {
+            const int numBytes = ((control >> (lane * 2)) & 3) + 1;
+            for (int b = 0; b < 4; ++b)
+            {
+              // 0x80 zeroes the byte
+              tables.Shuffles[control][lane * 4 + b] = b < numBytes ? std::uint8_t(offset + b) : 0x80;
+            }
+            offset += (std::uint8_t)numBytes;
+          }
+          tables.Lengths[control] = offset;
+        }
+        return tables;
+      }
+
+      inline constexpr StreamVByteTables StreamVByte = GenStreamVByteTables();
+
+      // Decodes the deltas of numGroups full control groups into running indices, starting from
+      // previous. Returns the data bytes read
+      inline std::size_t DecodeGroupsScalar(const std::uint8_t* controls, const std::size_t numGroups, const std::uint8_t* data, std::uint32_t previous, std::uint32_t* outIndices)
+      {
+        const std::uint8_t* const dataStart = data;
+        for (std::size_t g = 0; g < numGroups; ++g)
+        {
+          const std::uint8_t control = controls[g];
+          for (int lane = 0; lane < 4; ++lane)
+          {
+            const int numBytes = ((control >> (lane * 2)) & 3) + 1;
+            std::uint32_t delta = 0;
+            for (int b = 0; b < numBytes; ++b)
+            {
+              delta |= std::uint32_t(data[b]) << (b * 8);
+            }
+            data += numBytes;
+            previous += delta;
+            outIndices[g * 4 + lane] = previous;
+          }
+        }
+        return std::size_t(data - dataStart);
+      }
+
+#if QTAG_SIMD_X86
+      // As DecodeGroupsScalar, four lanes at a time. Loads 16 data bytes per group whatever its
+      // length, the caller makes sure they're there
+      QTAG_TARGET("avx2") inline std::size_t DecodeGroupsAVX2(const std::uint8_t* controls, const std::size_t numGroups, const std::uint8_t* data, const std::uint32_t previous, std::uint32_t* outIndices)
+      {
+        const std::uint8_t* const dataStart = data;
+        __m128i running = _mm_set1_epi32((int)previous);
+        for (std::size_t g = 0; g < numGroups; ++g)
+        {
+          const std::uint8_t control = controls[g];
+          const __m128i shuffle = _mm_loadu_si128(reinterpret_cast<const __m128i*>(StreamVByte.Shuffles[control]));
+          __m128i deltas = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data)), shuffle);
+          data += StreamVByte.Lengths[control];
+
+          // Inclusive prefix sum across the four lanes, then carry on from the last group
+          deltas = _mm_add_epi32(deltas, _mm_slli_si128(deltas, 4));
+          deltas = _mm_add_epi32(deltas, _mm_slli_si128(deltas, 8));
+          const __m128i indices = _mm_add_epi32(deltas, running);
+          _mm_storeu_si128(reinterpret_cast<__m128i*>(outIndices + g * 4), indices);
+          running = _mm_shuffle_epi32(indices, 0xFF);
+        }
+        return std::size_t(data - dataStart);
+      }
+#endif
+    }
+  }
+}
+
+template<class QTag>
+class QuickTagSetEncoder
+{
+public:
+  // Appends to outBuffer, starting with the stream header
+  // sortedDictionary switches to dictionary mode, and must outlive the encoder
+  explicit QuickTagSetEncoder(std::vector<std::uint8_t>& outBuffer, std::span<const QTag> sortedDictionary={})
+    : Buffer(outBuffer)
+    , Dictionary(sortedDictionary)
+  {
+    for (const char c : QTagUtil::Codec::Magic)
+    {
+      Buffer.push_back((std::uint8_t)c);
+    }
+    Buffer.push_back(QTagUtil::Codec::Version);
+    Buffer.push_back((std::uint8_t)(Dictionary.empty() ? QTagUtil::Codec::EMode::Prefix : QTagUtil::Codec::EMode::Dictionary));
+    Buffer.push_back((std::uint8_t)QTag::GetNumFields());
+    for (std::size_t f = 0; f < QTag::GetNumFields(); ++f)
+    {
+      Buffer.push_back(QTag::GetFieldBitWidth((unsigned char)f));
+    }
+    QTagUtil::Codec::WriteVarint(Buffer, Dictionary.size());
+  }
+
+  // Appends one set. Tags must be valid, sorted and unique, and in the dictionary if there is one
+  // Returns false (leaving the buffer as it was) otherwise
+  bool Encode(std::span<const QTag> sortedTags)
+  {
+    const std::size_t rollback = Buffer.size();
+    QTagUtil::Codec::WriteVarint(Buffer, sortedTags.size());
+    const bool bEncoded = Dictionary.empty() ? EncodePrefix(sortedTags) : EncodeDictionary(sortedTags);
+    if (!bEncoded)
+    {
+      Buffer.resize(rollback);
+    }
+    return bEncoded;
+  }
+
+  template<std::size_t InlineCapacity>
+  bool Encode(const QuickTagContainer<QTag, InlineCapacity>& container)
+  {
+    return Encode(std::span<const QTag>(container.GetData(), container.Num()));
+  }
+
+  // Encodes every container in turn, returns the number encoded before the first failure
+  template<std::size_t InlineCapacity>
+  std::size_t EncodeMany(std::span<const QuickTagContainer<QTag, InlineCapacity>> containers)
+  {
+    for (std::size_t c = 0; c < containers.size(); ++c)
+    {
+      if (!Encode(containers[c]))
+      {
+        return c;
+      }
+    }
+    return containers.size();
+  }
+
+private:
+  static constexpr bool bWideHeader = QTag::GetNumFields() > 15;
+
+  bool EncodePrefix(std::span<const QTag> sortedTags)
+  {
+    QTag previous;
+    int previousDepth = 0;
+    for (std::size_t i = 0; i < sortedTags.size(); ++i)
+    {
+      const QTag tag = sortedTags[i];
+      if (!tag.IsValid() || (i > 0 && !(previous < tag)))
+      {
+        return false;
+      }
+
+      // Sorted and unique, so the tag is never an ancestor of the one before and differs in a
+      // field it has
+      const int depth = tag.GetDepth();
+      int shared = 0;
+      while (shared < previousDepth && tag.GetField((unsigned char)shared) == previous.GetField((unsigned char)shared))
+      {
+        ++shared;
+      }
+
+      const int numNew = depth - shared;
+      if constexpr (bWideHeader)
+      {
+        QTagUtil::Codec::WriteVarint(Buffer, (std::uint64_t)shared);
+        QTagUtil::Codec::WriteVarint(Buffer, (std::uint64_t)numNew);
+      }
+      else
+      {
+        Buffer.push_back(std::uint8_t((shared << 4) | numNew));
+      }
+
+      // Fields are non-zero, so store less one, and the first new field after a shared parent
+      // sorts above the previous tag's
+      for (int f = shared; f < depth; ++f)
+      {
+        std::uint64_t value = (std::uint64_t)tag.GetField((unsigned char)f) - 1;
+        if (f == shared && shared < previousDepth)
+        {
+          value -= (std::uint64_t)previous.GetField((unsigned char)f);
+        }
+        QTagUtil::Codec::WriteVarint(Buffer, value);
+      }
+
+      previous = tag;
+      previousDepth = depth;
+    }
+    return true;
+  }
+
+  bool EncodeDictionary(std::span<const QTag> sortedTags)
+  {
+    const std::size_t numGroups = (sortedTags.size() + 3) / 4;
+    const std::size_t controlsStart = Buffer.size();
+    Buffer.resize(controlsStart + numGroups, 0);
+
+    // Tags are sorted, so each search starts where the last one left off
+    typename std::span<const QTag>::iterator searchStart = Dictionary.begin();
+    std::uint32_t previous = 0;
+    for (std::size_t i = 0; i < sortedTags.size(); ++i)
+    {
+      searchStart = std::lower_bound(searchStart, Dictionary.end(), sortedTags[i]);
+      if (searchStart == Dictionary.end() || *searchStart != sortedTags[i] || (i > 0 && sortedTags[i] == sortedTags[i - 1]))
+      {
+        return false;
+      }
+
+      const std::uint32_t index = std::uint32_t(searchStart - Dictionary.begin());
+      const std::uint32_t delta = index - previous;
+      previous = index;
+
+      const std::uint8_t code = QTagUtil::Codec::Internal::GetLengthCode(delta);
+      Buffer[controlsStart + i / 4] |= std::uint8_t(code << ((i % 4) * 2));
+      for (int b = 0; b <= code; ++b)
+      {
+        Buffer.push_back(std::uint8_t(delta >> (b * 8)));
+      }
+    }
+    return true;
+  }
+
+  std::vector<std::uint8_t>& Buffer;
+  std::span<const QTag> Dictionary;
+};
+
+template<class QTag>
+class QuickTagSetDecoder
+{
+public:
+  // buffer must outlive the decoder, sortedDictionary must match the encoder's
+  // Check IsValid, a stream for another layout or dictionary is refused up front
+  explicit QuickTagSetDecoder(std::span<const std::uint8_t> buffer, std::span<const QTag> sortedDictionary={})
+    : Pos(buffer.data())
+    , End(buffer.data() + buffer.size())
+    , Dictionary(sortedDictionary)
+  {
+    bValid = ReadHeader();
+  }
+
+  bool IsValid() const { return bValid; }
+  // True once every set has been read, or the stream turned out to be malformed
+  bool IsDone() const { return !bValid || Pos == End; }
+
+  // Replaces outTags with the next set, returns false at the end of the stream or on bad data
+  bool Decode(std::vector<QTag>& outTags)
+  {
+    outTags.clear();
+    if (IsDone())
+    {
+      return false;
+    }
+
+    std::uint64_t numTags;
+    // Every tag takes at least a byte in either mode, so a count past that is corrupt
+    if (!QTagUtil::Codec::ReadVarint(Pos, End, numTags) || numTags > std::uint64_t(End - Pos))
+    {
+      bValid = false;
+      return false;
+    }
+    outTags.resize((std::size_t)numTags);
+    bValid = bDictionary ? DecodeDictionary(outTags) : DecodePrefix(outTags);
+    if (!bValid)
+    {
+      outTags.clear();
+    }
+    return bValid;
+  }
+
+  template<std::size_t InlineCapacity>
+  bool Decode(QuickTagContainer<QTag, InlineCapacity>& outContainer)
+  {
+    outContainer.Reset();
+    if (!Decode(Scratch))
+    {
+      return false;
+    }
+    // Already sorted, so every add lands at the end
+    outContainer.Reserve(Scratch.size());
+    for (const QTag tag : Scratch)
+    {
+      outContainer.AddTag(tag);
+    }
+    return true;
+  }
+
+  // Decodes into each container in turn, returns the number decoded before the stream ran out
+  template<std::size_t InlineCapacity>
+  std::size_t DecodeMany(std::span<QuickTagContainer<QTag, InlineCapacity>> outContainers)
+  {
+    for (std::size_t c = 0; c < outContainers.size(); ++c)
+    {
+      if (!Decode(outContainers[c]))
+      {
+        return c;
+      }
+    }
+    return outContainers.size();
+  }
+
+private:
+  static constexpr bool bWideHeader = QTag::GetNumFields() > 15;
+
+  bool ReadHeader()
+  {
+    const std::size_t fixedSize = sizeof(QTagUtil::Codec::Magic) + 3 + QTag::GetNumFields();
+    if (std::size_t(End - Pos) < fixedSize || std::memcmp(Pos, QTagUtil::Codec::Magic, sizeof(QTagUtil::Codec::Magic)) != 0)
+    {
+      return false;
+    }
+    Pos += sizeof(QTagUtil::Codec::Magic);
+    const std::uint8_t version = *Pos++;
+    const std::uint8_t mode = *Pos++;
+    const std::uint8_t numFields = *Pos++;
+    if (version != QTagUtil::Codec::Version || mode > (std::uint8_t)QTagUtil::Codec::EMode::Dictionary || numFields != QTag::GetNumFields())
+    {
+      return false;
+    }
+    for (std::size_t f = 0; f < QTag::GetNumFields(); ++f)
+    {
+      if (*Pos++ != QTag::GetFieldBitWidth((unsigned char)f))
+      {
+        return false;
+      }
+    }
+
+    bDictionary = mode == (std::uint8_t)QTagUtil::Codec::EMode::Dictionary;
+    std::uint64_t dictionarySize;
+    return QTagUtil::Codec::ReadVarint(Pos, End, dictionarySize) && dictionarySize == (bDictionary ? Dictionary.size() : 0);
+  }
+
+  bool DecodePrefix(std::span<QTag> outTags)
+  {
+    QTag previous;
+    int previousDepth = 0;
+    for (QTag& outTag : outTags)
+    {
+      std::uint64_t shared;
+      std::uint64_t numNew;
+      if constexpr (bWideHeader)
+      {
+        if (!QTagUtil::Codec::ReadVarint(Pos, End, shared) || !QTagUtil::Codec::ReadVarint(Pos, End, numNew))
+        {
+          return false;
+        }
+      }
+      else
+      {
+        if (Pos == End)
+        {
+          return false;
+        }
+        shared = *Pos >> 4;
+        numNew = *Pos & 0xF;
+        ++Pos;
+      }
+      if (shared > (std::uint64_t)previousDepth || numNew == 0 || shared + numNew > QTag::GetNumFields())
+      {
+        return false;
+      }
+
+      QTag tag(previous.GetRaw() & QTag::GetPrefixMask((int)shared));
+      const int depth = int(shared + numNew);
+      for (int f = (int)shared; f < depth; ++f)
+      {
+        std::uint64_t value;
+        if (!QTagUtil::Codec::ReadVarint(Pos, End, value))
+        {
+          return false;
+        }
+        const std::uint64_t previousField = f == (int)shared && (int)shared < previousDepth ? (std::uint64_t)previous.GetField((unsigned char)f) : 0;
+        // Stored less one (and as a delta on the previous tag's field), so anything that would pass
+        // the largest value the field holds is corrupt. Checked before adding so it can't wrap
+        // around, which keeps decoded sets strictly increasing.
+        const unsigned int bits = QTag::GetFieldBitWidth((unsigned char)f);
+        const std::uint64_t maxFieldValue = bits < 64 ? (std::uint64_t(1) << bits) - 1 : ~std::uint64_t(0);
+        if (previousField >= maxFieldValue || value > maxFieldValue - 1 - previousField)
+        {
+          return false;
+        }
+        tag.SetField((unsigned char)f, (typename QTag::TagBaseType)(value + previousField + 1));
+      }
+
+      outTag = tag;
+      previous = tag;
+      previousDepth = depth;
+    }
+    return true;
+  }
+
+  bool DecodeDictionary(std::span<QTag> outTags)
+  {
+    namespace Internal = QTagUtil::Codec::Internal;
+
+    const std::size_t numTags = outTags.size();
+    const std::size_t numGroups = (numTags + 3) / 4;
+    const std::size_t numFullGroups = numTags / 4;
+    if (std::size_t(End - Pos) < numGroups)
+    {
+      return false;
+    }
+    const std::uint8_t* const controls = Pos;
+    const std::uint8_t* data = Pos + numGroups;
+
+    // Check the data is all there before touching it, the tail group only has numTags % 4 lanes
+    std::size_t dataSize = 0;
+    for (std::size_t g = 0; g < numFullGroups; ++g)
+    {
+      dataSize += Internal::StreamVByte.Lengths[controls[g]];
+    }
+    for (std::size_t i = numFullGroups * 4; i < numTags; ++i)
+    {
+      dataSize += ((controls[numFullGroups] >> ((i % 4) * 2)) & 3) + 1;
+    }
+    if (std::size_t(End - data) < dataSize)
+    {
+      return false;
+    }
+
+    Indices.resize(numGroups * 4);
+    std::uint32_t* const indices = Indices.data();
+
+    // SIMD loads read 16 bytes per group, so stop it where that would run off the buffer
+    std::size_t numSimdGroups = 0;
+#if QTAG_SIMD_X86
+    if (QTagUtil::Simd::GetLevel() >= QTagUtil::Simd::ELevel::AVX2)
+    {
+      std::size_t safeData = 0;
+      while (numSimdGroups < numFullGroups && std::size_t(End - data) >= safeData + 16)
+      {
+        safeData += Internal::StreamVByte.Lengths[controls[numSimdGroups]];
+        ++numSimdGroups;
+      }
+      data += Internal::DecodeGroupsAVX2(controls, numSimdGroups, data, 0, indices);
+    }
+#endif
+    const std::uint32_t previous = numSimdGroups > 0 ? indices[numSimdGroups * 4 - 1] : 0;
+    data += Internal::DecodeGroupsScalar(controls + numSimdGroups, numFullGroups - numSimdGroups, data, previous, indices + numSimdGroups * 4);
+
+    std::uint32_t running = numFullGroups > 0 ? indices[numFullGroups * 4 - 1] : 0;
+    for (std::size_t i = numFullGroups * 4; i < numTags; ++i)
+    {
+      const int numBytes = ((controls[numFullGroups] >> ((i % 4) * 2)) & 3) + 1;
+      std::uint32_t delta = 0;
+      for (int b = 0; b < numBytes; ++b)
+      {
+        delta |= std::uint32_t(data[b]) << (b * 8);
+      }
+      data += numBytes;
+      running += delta;
+      indices[i] = running;
+    }
+
+    // Indices must climb strictly and stay inside the dictionary, or the stream is corrupt
+    for (std::size_t i = 0; i < numTags; ++i)
+    {
+      if (indices[i] >= Dictionary.size() || (i > 0 && indices[i] <= indices[i - 1]))
+      {
+        return false;
+      }
+      outTags[i] = Dictionary[indices[i]];
+    }
+
+    Pos = data;
+    return true;
+  }
+
+  const std::uint8_t* Pos;
+  const std::uint8_t* End;
+  std::span<const QTag> Dictionary;
+  std::vector<std::uint32_t> Indices;
+  std::vector<QTag> Scratch;
+  bool bDictionary = false;
+  bool bValid = false;
+};
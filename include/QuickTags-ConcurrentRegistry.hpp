@@ -0,0 +1,225 @@
+#pragma once
+#include "QuickTags.hpp"
+#include "QuickTags-Loader.hpp"
+#include "QuickTags-IdManifest.hpp"
+#include "QuickTags-NameTable.hpp"
+#include "QuickTags-Resolver.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <set>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// Tag registry that can take new tags at runtime while other threads keep resolving and formatting.
+//
+// Readers see an immutable Snapshot (a resolver, a name table and a version) through one atomic
+// pointer. Writers are serialised by a mutex, build a whole new snapshot off to the side and swap
+// it in, then wait on ReadEpochs until every reader that could still see the old snapshot has left
+// before freeing it. Readers never lock or allocate, entering is an increment on a per-thread
+// counter and a re-check of the epoch.
+//
+// Values are kept stable across additions with a TagIdManifest (see EnumerateTagsStable), so tags
+// already handed out stay valid and keep their names. Seeding the registry with the manifest from
+// GetManifest keeps them stable across runs too. An addition that needs more bits than the
+// QTag's fields have is rejected as a whole and the current snapshot stays published.
+
+namespace QTagUtil
+{
+  // Two-phase epoch counter in the style of userspace RCU
+  // Readers bump the counter for the current epoch's parity, Synchronize flips the epoch and waits
+  // for the old parity to drain. Counters are spread over cache lines by thread to avoid every
+  // reader hammering one line.
+  class ReadEpochs
+  {
+  public:
+    class ReadGuard
+    {
+    public:
+      explicit ReadGuard(const ReadEpochs& epochs);
+      ~ReadGuard();
+      ReadGuard(const ReadGuard&) = delete;
+      ReadGuard& operator=(const ReadGuard&) = delete;
+
+    private:
+      std::atomic<std::uint32_t>* Counter;
+    };
+
+    // Returns once every ReadGuard alive at the time of the call has been destroyed
+    // Must not be called from a thread holding a ReadGuard on the same epochs, it would never return
+    void Synchronize();
+
+  private:
+    static constexpr std::size_t NumSlots = 64;
+    struct alignas(64) ReaderSlot
+    {
+      std::atomic<std::uint32_t> Counts[2] = { 0, 0 };
+    };
+
+    mutable ReaderSlot Slots[NumSlots];
+    std::atomic<std::uint32_t> Epoch = 0;
+  };
+
+  enum class EAddTagsResult
+  {
+    Added,       // New snapshot published
+    NoChange,    // Every tag was already registered
+    Overflow,    // Some field would need more bits than the QTag has, nothing was published
+    InvalidName  // Empty name, empty segment or whitespace, nothing was published
+  };
+
+  // Same rules as BuildTagStringSetFromFile, plus no empty segments
+  bool IsValidTagName(std::string_view name);
+}
+
+template<class QTag>
+class QuickTagConcurrentRegistry
+{
+public:
+  // Immutable once published
+  struct Snapshot
+  {
+    std::uint64_t Version = 0;
+    QuickTagResolver<QTag> Resolver;
+    QuickTagNameTable<QTag> Names;
+  };
+
+  // Pins the snapshot that was current when it was made, keep it short lived, a writer publishing
+  // in the meantime waits for it before it can free the old snapshot
+  class ReadHandle
+  {
+  public:
+    explicit ReadHandle(const QuickTagConcurrentRegistry& registry)
+      : Guard(registry.Epochs)
+      , Pinned(registry.Current.load(std::memory_order_seq_cst))
+    {}
+
+    const Snapshot& operator*() const { return *Pinned; }
+    const Snapshot* operator->() const { return Pinned; }
+
+  private:
+    QTagUtil::ReadEpochs::ReadGuard Guard;
+    const Snapshot* Pinned;
+  };
+
+  explicit QuickTagConcurrentRegistry(QTagUtil::ETagSetFlags flags=QTagUtil::ETagSetFlags::None)
+    : Flags(flags)
+    , Current(new Snapshot())
+  {}
+
+  // Starts from a manifest written by an earlier run, so tags get back the values they had then,
+  // whether they are added in the same batches and order or not
+  explicit QuickTagConcurrentRegistry(QTagUtil::TagIdManifest manifest, QTagUtil::ETagSetFlags flags=QTagUtil::ETagSetFlags::None)
+    : Flags(flags)
+    , Manifest(std::move(manifest))
+    , Current(new Snapshot())
+  {}
+
+  // Assumes no readers remain
+  ~QuickTagConcurrentRegistry()
+  {
+    delete Current.load();
+  }
+
+  QuickTagConcurrentRegistry(const QuickTagConcurrentRegistry&) = delete;
+  QuickTagConcurrentRegistry& operator=(const QuickTagConcurrentRegistry&) = delete;
+
+  // Reader side, never locks
+  ReadHandle Read() const { return ReadHandle(*this); }
+
+  QTag Resolve(const std::string_view name) const { return Read()->Resolver.Resolve(name); }
+  std::string_view GetName(const QTag tag, std::span<char> buffer) const { return Read()->Names.GetName(tag, buffer); }
+  std::uint64_t GetVersion() const { return Read()->Version; }
+
+  // Writer side. Adds the tags (and their implied parents) and publishes a new snapshot
+  // On Overflow, outOverflowingFields gets the index of each field that no longer fits
+  QTagUtil::EAddTagsResult AddTags(std::span<const std::string_view> names, std::vector<std::uint32_t>* outOverflowingFields=nullptr)
+  {
+    std::lock_guard<std::mutex> lock(WriterMutex);
+
+    std::set<std::string> newNames = TagNames;
+    const std::size_t numBefore = newNames.size();
+    for (const std::string_view name : names)
+    {
+      if (!QTagUtil::IsValidTagName(name))
+      {
+        return QTagUtil::EAddTagsResult::InvalidName;
+      }
+      std::string foldedName(name);
+      if (IsCaseInsensitive())
+      {
+        for (char& c : foldedName)
+        {
+          c = (c >= 'a' && c <= 'z') ? char(c - ('a' - 'A')) : c;
+        }
+      }
+      newNames.insert(std::move(foldedName));
+    }
+    if (newNames.size() == numBefore)
+    {
+      return QTagUtil::EAddTagsResult::NoChange;
+    }
+
+    // Enumerate against a copy of the manifest, so a rejected batch leaves no trace
+    std::list<QTagUtil::TagTreeNode> tagTrees;
+    QTagUtil::TreeifyTags(newNames, tagTrees);
+    QTagUtil::TagIdManifest newManifest = Manifest;
+    QTagUtil::EnumerateTagsStable(tagTrees, newManifest);
+
+    std::vector<std::uint32_t> valueRanges;
+    std::vector<std::uint32_t> requiredBits;
+    QTagUtil::FindTagValueRanges(tagTrees, valueRanges);
+    QTagUtil::GetRequiredBitsPerField(valueRanges, requiredBits);
+    if (!QTagUtil::FitsLayout<QTag>(requiredBits, outOverflowingFields))
+    {
+      return QTagUtil::EAddTagsResult::Overflow;
+    }
+
+    Snapshot* const snapshot = new Snapshot();
+    snapshot->Version = Current.load(std::memory_order_relaxed)->Version + 1;
+    snapshot->Resolver.Build(tagTrees, Flags);
+    snapshot->Names.Build(tagTrees);
+
+    TagNames = std::move(newNames);
+    Manifest = std::move(newManifest);
+
+    const Snapshot* const oldSnapshot = Current.exchange(snapshot, std::memory_order_seq_cst);
+    Epochs.Synchronize();
+    delete oldSnapshot;
+    return QTagUtil::EAddTagsResult::Added;
+  }
+
+  QTagUtil::EAddTagsResult AddTag(const std::string_view name, std::vector<std::uint32_t>* outOverflowingFields=nullptr)
+  {
+    return AddTags(std::span<const std::string_view>(&name, 1), outOverflowingFields);
+  }
+
+  // Values given out so far, pass it to the next run's constructor to keep them stable across runs
+  QTagUtil::TagIdManifest GetManifest() const
+  {
+    std::lock_guard<std::mutex> lock(WriterMutex);
+    return Manifest;
+  }
+
+  bool IsCaseInsensitive() const
+  {
+    return (unsigned int)Flags & (unsigned int)QTagUtil::ETagSetFlags::CaseInsensitive;
+  }
+
+private:
+  const QTagUtil::ETagSetFlags Flags;
+
+  // Writer only
+  mutable std::mutex WriterMutex;
+  std::set<std::string> TagNames;
+  QTagUtil::TagIdManifest Manifest;
+
+  std::atomic<const Snapshot*> Current;
+  QTagUtil::ReadEpochs Epochs;
+};
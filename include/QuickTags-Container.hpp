@@ -0,0 +1,249 @@
+#pragma once
+#include "QuickTags.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <utility>
+
+// A flat set of QuickTags, kept sorted by raw value.
+//
+// Because GenFieldOffsets packs the first field into the most significant bits, a tag and all
+// of its descendants occupy one contiguous run of raw values: [tag, tag | ~prefixMask].
+// That means hierarchical queries only need a lower_bound per query tag (or a merge when the
+// query is itself a sorted container) rather than calling Matches against every stored tag.
+//
+// Storage is a small inline buffer which spills to the heap once InlineCapacity is exceeded.
+template<class QTag, std::size_t InlineCapacity = 8>
+class QuickTagContainer
+{
+  static_assert(InlineCapacity > 0, "QuickTagContainer needs at least one inline slot");
+
+public:
+  using TagType = QTag;
+  using iterator = const QTag*;
+  using const_iterator = const QTag*;
+
+  QuickTagContainer()
+    : Data(InlineStorage)
+    , Size(0)
+    , Capacity(InlineCapacity)
+  {}
+
+  QuickTagContainer(std::initializer_list<QTag> tags)
+    : QuickTagContainer()
+  {
+    for (const QTag& tag : tags)
+    {
+      AddTag(tag);
+    }
+  }
+
+  QuickTagContainer(const QuickTagContainer& other)
+    : QuickTagContainer()
+  {
+    CopyFrom(other);
+  }
+
+  QuickTagContainer(QuickTagContainer&& other) noexcept
+    : QuickTagContainer()
+  {
+    MoveFrom(other);
+  }
+
+  ~QuickTagContainer()
+  {
+    FreeHeap();
+  }
+
+  QuickTagContainer& operator=(const QuickTagContainer& other)
+  {
+    if (this != &other)
+    {
+      Size = 0;
+      CopyFrom(other);
+    }
+    return *this;
+  }
+
+  QuickTagContainer& operator=(QuickTagContainer&& other) noexcept
+  {
+    if (this != &other)
+    {
+      FreeHeap();
+      Data = InlineStorage;
+      Size = 0;
+      Capacity = InlineCapacity;
+      MoveFrom(other);
+    }
+    return *this;
+  }
+
+  // Adds tag if it is valid and not already present, returns true if the container changed
+  bool AddTag(const QTag& tag)
+  {
+    if (!tag.IsValid())
+    {
+      return false;
+    }
+
+    QTag* it = std::lower_bound(Data, Data + Size, tag);
+    if (it != Data + Size && *it == tag)
+    {
+      return false;
+    }
+
+    const std::size_t insertIdx = it - Data;
+    Reserve(Size + 1);
+    std::copy_backward(Data + insertIdx, Data + Size, Data + Size + 1);
+    Data[insertIdx] = tag;
+    ++Size;
+    return true;
+  }
+
+  // Removes exactly tag (descendants are left alone), returns true if the container changed
+  bool RemoveTag(const QTag& tag)
+  {
+    QTag* it = std::lower_bound(Data, Data + Size, tag);
+    if (it == Data + Size || *it != tag)
+    {
+      return false;
+    }
+
+    std::copy(it + 1, Data + Size, it);
+    --Size;
+    return true;
+  }
+
+  // "A.1" in container: HasTag("A") is True, HasTag("A.1") is True, HasTag("A.1.2") is False
+  bool HasTag(const QTag& tagToMatch) const
+  {
+    // The first stored tag >= tagToMatch is the only candidate, any descendant sorts directly after it
+    const QTag* it = std::lower_bound(Data, Data + Size, tagToMatch);
+    return it != Data + Size && it->Matches(tagToMatch);
+  }
+
+  bool HasTagExact(const QTag& tagToMatch) const
+  {
+    if (!tagToMatch.IsValid())
+    {
+      return false;
+    }
+    return std::binary_search(Data, Data + Size, tagToMatch);
+  }
+
+  // True if any tag in other is matched (hierarchically) by a tag in this container
+  // Empty other returns False
+  template<std::size_t OtherCapacity>
+  bool HasAny(const QuickTagContainer<QTag, OtherCapacity>& other) const
+  {
+    // Both sides are sorted, so the candidate for each query only ever moves forwards
+    const QTag* it = Data;
+    const QTag* const end = Data + Size;
+    for (const QTag& tagToMatch : other)
+    {
+      it = std::lower_bound(it, end, tagToMatch);
+      if (it == end)
+      {
+        return false;
+      }
+      if (it->Matches(tagToMatch))
+      {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // True if every tag in other is matched (hierarchically) by a tag in this container
+  // Empty other returns True
+  template<std::size_t OtherCapacity>
+  bool HasAll(const QuickTagContainer<QTag, OtherCapacity>& other) const
+  {
+    const QTag* it = Data;
+    const QTag* const end = Data + Size;
+    for (const QTag& tagToMatch : other)
+    {
+      it = std::lower_bound(it, end, tagToMatch);
+      if (it == end || !it->Matches(tagToMatch))
+      {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  void Reset()
+  {
+    Size = 0;
+  }
+
+  void Reserve(const std::size_t newCapacity)
+  {
+    if (newCapacity <= Capacity)
+    {
+      return;
+    }
+
+    const std::size_t grownCapacity = std::max(newCapacity, Capacity * 2);
+    QTag* newData = new QTag[grownCapacity];
+    std::copy(Data, Data + Size, newData);
+    FreeHeap();
+    Data = newData;
+    Capacity = grownCapacity;
+  }
+
+  std::size_t Num() const { return Size; }
+  bool IsEmpty() const { return Size == 0; }
+  bool IsInline() const { return Data == InlineStorage; }
+
+  const QTag& operator[](const std::size_t idx) const { return Data[idx]; }
+  const QTag* GetData() const { return Data; }
+
+  const QTag* begin() const { return Data; }
+  const QTag* end() const { return Data + Size; }
+
+  bool operator==(const QuickTagContainer& rhs) const { return std::equal(begin(), end(), rhs.begin(), rhs.end()); }
+  bool operator!=(const QuickTagContainer& rhs) const { return !(*this == rhs); }
+
+private:
+  void FreeHeap()
+  {
+    if (Data != InlineStorage)
+    {
+      delete[] Data;
+    }
+  }
+
+  void CopyFrom(const QuickTagContainer& other)
+  {
+    Reserve(other.Size);
+    std::copy(other.Data, other.Data + other.Size, Data);
+    Size = other.Size;
+  }
+
+  void MoveFrom(QuickTagContainer& other)
+  {
+    if (other.Data == other.InlineStorage)
+    {
+      std::copy(other.Data, other.Data + other.Size, Data);
+      Size = other.Size;
+    }
+    else
+    {
+      // Steal the heap buffer
+      Data = other.Data;
+      Size = other.Size;
+      Capacity = other.Capacity;
+      other.Data = other.InlineStorage;
+      other.Capacity = InlineCapacity;
+    }
+    other.Size = 0;
+  }
+
+  QTag* Data;
+  std::size_t Size;
+  std::size_t Capacity;
+  QTag InlineStorage[InlineCapacity];
+};
@@ -0,0 +1,89 @@
+#pragma once
+#include <cstdint>
+#include <set>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Tag tree held in one contiguous node array rather than nested std::lists.
+//
+// Nodes are laid out breadth first, so the roots are [0, NumRoots) and every node's children are
+// the contiguous range [FirstChild, FirstChild + NumChildren). Segment names live in a single pool.
+// Building looks children up through a hash of (parent, segment), and enumeration falls out of the
+// layout, so going from sorted tag strings to an enumerated tree is linear in the input size.
+
+namespace QTagUtil
+{
+  struct FlatTagNode
+  {
+    static constexpr std::uint32_t InvalidIndex = ~std::uint32_t(0);
+
+    std::uint32_t Parent;
+    std::uint32_t FirstChild;
+    std::uint32_t NumChildren;
+    std::uint32_t SegmentOffset;
+    std::uint32_t SegmentLength;
+    std::uint32_t Depth;
+    std::uint64_t TagAsInt; // Position among siblings +1, as EnumerateTags assigns
+  };
+
+  class FlatTagTree
+  {
+  public:
+    // inSortedTags must be sorted and unique, as if it had come from a std::set<std::string>
+    // Sibling order (and so enumeration) is first appearance order, the same as TreeifyTags
+    void Build(std::span<const std::string_view> inSortedTags);
+    void Build(const std::set<std::string>& inStringSet);
+    void Reset();
+
+    std::size_t Num() const { return Nodes.size(); }
+    bool IsEmpty() const { return Nodes.empty(); }
+
+    std::span<const FlatTagNode> GetNodes() const { return Nodes; }
+    std::span<const FlatTagNode> GetRoots() const { return std::span<const FlatTagNode>(Nodes.data(), NumRoots); }
+    std::span<const FlatTagNode> GetChildren(const FlatTagNode& node) const
+    {
+      return std::span<const FlatTagNode>(Nodes.data() + node.FirstChild, node.NumChildren);
+    }
+    std::uint32_t GetIndex(const FlatTagNode& node) const { return std::uint32_t(&node - Nodes.data()); }
+
+    std::string_view GetSegment(const FlatTagNode& node) const
+    {
+      return std::string_view(SegmentPool.data() + node.SegmentOffset, node.SegmentLength);
+    }
+
+    // Same result as QTagUtil::FindTagRanges on the equivalent list tree
+    void FindTagRanges(std::vector<std::uint32_t>& outRanges) const;
+
+    // Calls visitor(node) for every node in pre-order, parents before children and siblings in
+    // order, which for an enumerated tree is ascending packed value order
+    template<class Visitor>
+    void VisitPreOrder(Visitor&& visitor) const
+    {
+      std::vector<std::uint32_t> stack;
+      for (std::uint32_t idx = NumRoots; idx-- > 0; )
+      {
+        stack.push_back(idx);
+      }
+      while (!stack.empty())
+      {
+        const FlatTagNode& node = Nodes[stack.back()];
+        stack.pop_back();
+        visitor(node);
+        for (std::uint32_t child = node.NumChildren; child-- > 0; )
+        {
+          stack.push_back(node.FirstChild + child);
+        }
+      }
+    }
+
+  private:
+    template<class StringRange>
+    void BuildImpl(const StringRange& inSortedTags);
+
+    std::vector<FlatTagNode> Nodes;
+    std::string SegmentPool;
+    std::uint32_t NumRoots = 0;
+  };
+}
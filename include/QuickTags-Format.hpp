@@ -0,0 +1,57 @@
+#pragma once
+#include "QuickTags.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+
+// Formatting many tags into one contiguous buffer, for log and telemetry dumps.
+//
+// Every tag is at most QTag::MaxStringLength chars, so the worst case size of a batch is known up
+// front. The buffer is sized once and each tag is written straight into it with QuickTag::ToChars,
+// so a batch does no per-tag allocation and no bounds checks beyond std::to_chars' own.
+
+namespace QTagUtil
+{
+  // Bytes FormatTags can write for numTags tags, each tag plus its separator
+  template<class QTag>
+  constexpr std::size_t GetFormatBufferSize(const std::size_t numTags)
+  {
+    return numTags * (QTag::MaxStringLength + 1);
+  }
+
+  // Writes each tag followed by separator into buffer, which must hold
+  // GetFormatBufferSize<QTag>(tags.size()) bytes. Returns the bytes written, no null terminator
+  // If outOffsets is given, the start of each tag's string is appended to it
+  template<class QTag>
+  std::size_t FormatTags(std::span<const QTag> tags, char* const buffer, const char separator='\n', std::vector<std::uint32_t>* outOffsets=nullptr)
+  {
+    char* pos = buffer;
+    if (outOffsets)
+    {
+      outOffsets->reserve(outOffsets->size() + tags.size());
+    }
+    for (const QTag& tag : tags)
+    {
+      if (outOffsets)
+      {
+        outOffsets->push_back(std::uint32_t(pos - buffer));
+      }
+      pos = tag.ToChars(pos, pos + QTag::MaxStringLength).ptr;
+      *pos++ = separator;
+    }
+    return std::size_t(pos - buffer);
+  }
+
+  // As FormatTags, appending to outString, which grows once for the whole batch
+  template<class QTag>
+  void AppendTags(std::span<const QTag> tags, std::string& outString, const char separator='\n')
+  {
+    const std::size_t start = outString.size();
+    outString.resize(start + GetFormatBufferSize<QTag>(tags.size()));
+    const std::size_t numWritten = FormatTags(tags, outString.data() + start, separator);
+    outString.resize(start + numWritten);
+  }
+}
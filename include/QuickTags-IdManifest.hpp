@@ -0,0 +1,90 @@
+#pragma once
+#include "QuickTags-Loader.hpp"
+
+#include <cstdint>
+#include <istream>
+#include <map>
+#include <ostream>
+#include <span>
+#include <string>
+#include <vector>
+
+// Stable tag values across revisions of the tag files.
+//
+// EnumerateTags numbers siblings by sorted position, so adding "A.15" shifts every sibling after
+// it and changes their packed values. A manifest records the field value given to every tag name
+// (and the layout the values were packed with), EnumerateTagsStable reuses those values, gives new
+// tags the lowest free slot among their siblings and tombstones tags that have gone, so a removed
+// tag's value is never handed to a different tag.
+//
+// Manifest files are plain text, one entry per line, sorted by name so they diff well:
+//   layout 5 5 5 3
+//   tag A.2 2
+//   dead A.7 7
+
+namespace QTagUtil
+{
+  class TagRegistry;
+
+  struct StableEnumerateStats
+  {
+    std::size_t NumKept = 0;    // Tags that kept their manifest value
+    std::size_t NumAdded = 0;   // New tags, given free slots
+    std::size_t NumRevived = 0; // Tombstoned tags that came back with their old value
+    std::size_t NumRemoved = 0; // Tags newly tombstoned
+  };
+
+  class TagIdManifest
+  {
+  public:
+    struct Entry
+    {
+      std::uint64_t Value; // Field value at the tag's own depth
+      bool bTombstone;
+    };
+
+    // Returns false on a malformed manifest, the manifest is left empty
+    bool Read(std::istream& inStream);
+    // A missing file is not an error, it reads as an empty manifest (first run)
+    bool ReadFile(const std::string& path);
+    bool Write(std::ostream& outStream) const;
+    bool WriteFile(const std::string& path) const;
+
+    // Seed from a registry written by an earlier revision, it has no tombstones
+    void ReadFromRegistry(const TagRegistry& registry);
+
+    void Reset();
+
+    const Entry* Find(const std::string& name) const;
+    const std::map<std::string, Entry>& GetEntries() const { return Entries; }
+    std::size_t Num() const { return Entries.size(); }
+
+    // Field bits the values were last packed with, empty if never set
+    const std::vector<std::uint32_t>& GetLayout() const { return Layout; }
+    void SetLayout(std::span<const std::uint32_t> fieldBits) { Layout.assign(fieldBits.begin(), fieldBits.end()); }
+
+  private:
+    friend void EnumerateTagsStable(std::list<TagTreeNode>& tags, TagIdManifest& ioManifest, StableEnumerateStats* outStats);
+
+    std::map<std::string, Entry> Entries;
+    std::vector<std::uint32_t> Layout;
+  };
+
+  // Replacement for EnumerateTags that keeps manifest values, updating the manifest in place
+  // Siblings are reordered by value, so a pre-order walk is still in ascending packed value order
+  void EnumerateTagsStable(std::list<TagTreeNode>& tags, TagIdManifest& ioManifest, StableEnumerateStats* outStats=nullptr);
+
+  // True if every required field fits in the layout, fields that don't are added to outOverflowingFields
+  bool FitsLayout(const std::vector<std::uint32_t>& requiredBits, std::span<const std::uint32_t> layoutBits, std::vector<std::uint32_t>* outOverflowingFields=nullptr);
+
+  template<class QTag>
+  bool FitsLayout(const std::vector<std::uint32_t>& requiredBits, std::vector<std::uint32_t>* outOverflowingFields=nullptr)
+  {
+    std::vector<std::uint32_t> layoutBits;
+    for (std::size_t f = 0; f < QTag::GetNumFields(); ++f)
+    {
+      layoutBits.push_back(QTag::GetFieldBitWidth((unsigned char)f));
+    }
+    return FitsLayout(requiredBits, layoutBits, outOverflowingFields);
+  }
+}
@@ -0,0 +1,214 @@
+#pragma once
+#include "QuickTags.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+// Inverted index from tags to the entities carrying them.
+//
+// Each packed tag value keys a posting list of entity IDs. Because the first field is packed into
+// the highest bits, a tag and all of its descendants are one contiguous run of keys, so "everything
+// tagged A.2 or below" is a range scan over the sorted keys plus a union of their posting lists.
+//
+// Posting lists are compressed roaring-style: IDs are split into chunks by their high 16 bits and
+// each chunk holds its low 16 bits either as a sorted uint16 array (2 bytes per ID) or, once it
+// holds more than 4096 IDs, as a 65536-bit bitmap (8KB). Adding or removing an ID only touches its
+// own chunk, and unions OR chunks into a bitmap rather than merging sorted runs.
+
+namespace QTagUtil
+{
+  class TagPostingList
+  {
+  public:
+    // Chunks holding more IDs than this switch from array to bitmap
+    static constexpr std::uint32_t MaxArrayCardinality = 4096;
+
+    // Return true if the list changed
+    bool Add(std::uint32_t id);
+    bool Remove(std::uint32_t id);
+    bool Contains(std::uint32_t id) const;
+
+    std::size_t Num() const { return NumIds; }
+    bool IsEmpty() const { return NumIds == 0; }
+    void Reset();
+
+    // Appends the IDs in ascending order
+    void Decode(std::vector<std::uint32_t>& outIds) const;
+
+    std::size_t GetMemoryUsage() const;
+
+    // Appends the sorted, unique union of the lists' IDs
+    static void Union(std::span<const TagPostingList* const> lists, std::vector<std::uint32_t>& outIds);
+
+  private:
+    struct Chunk
+    {
+      std::uint16_t Key; // High 16 bits of every ID in the chunk
+      std::uint32_t Cardinality;
+      std::vector<std::uint16_t> Array;  // Sorted low bits, while Cardinality <= MaxArrayCardinality
+      std::vector<std::uint64_t> Bitmap; // 1024 words otherwise
+
+      bool IsBitmap() const { return !Bitmap.empty(); }
+    };
+
+    static void DecodeChunk(const Chunk& chunk, std::vector<std::uint32_t>& outIds);
+
+    std::vector<Chunk> Chunks; // Sorted by Key
+    std::size_t NumIds = 0;
+  };
+}
+
+template<class QTag>
+class QuickTagIndex
+{
+public:
+  // Indexes entityId under tag, returns false for invalid tags or if it was already there
+  bool Add(const QTag tag, const std::uint32_t entityId)
+  {
+    if (!tag.IsValid())
+    {
+      return false;
+    }
+
+    typename std::vector<QTag>::iterator it = std::lower_bound(Keys.begin(), Keys.end(), tag);
+    const std::size_t keyIdx = it - Keys.begin();
+    if (it == Keys.end() || *it != tag)
+    {
+      Keys.insert(it, tag);
+      Lists.emplace(Lists.begin() + keyIdx);
+    }
+    return Lists[keyIdx].Add(entityId);
+  }
+
+  // Returns false if entityId wasn't indexed under exactly tag
+  bool Remove(const QTag tag, const std::uint32_t entityId)
+  {
+    typename std::vector<QTag>::iterator it = std::lower_bound(Keys.begin(), Keys.end(), tag);
+    if (it == Keys.end() || *it != tag)
+    {
+      return false;
+    }
+
+    const std::size_t keyIdx = it - Keys.begin();
+    if (!Lists[keyIdx].Remove(entityId))
+    {
+      return false;
+    }
+
+    // Keys without entities would only slow down range scans
+    if (Lists[keyIdx].IsEmpty())
+    {
+      Keys.erase(it);
+      Lists.erase(Lists.begin() + keyIdx);
+    }
+    return true;
+  }
+
+  // Returns the number of tags entityId was added under
+  std::size_t AddTags(const std::uint32_t entityId, std::span<const QTag> tags)
+  {
+    std::size_t numAdded = 0;
+    for (const QTag& tag : tags)
+    {
+      numAdded += Add(tag, entityId);
+    }
+    return numAdded;
+  }
+
+  std::size_t RemoveTags(const std::uint32_t entityId, std::span<const QTag> tags)
+  {
+    std::size_t numRemoved = 0;
+    for (const QTag& tag : tags)
+    {
+      numRemoved += Remove(tag, entityId);
+    }
+    return numRemoved;
+  }
+
+  // Appends the sorted, unique IDs of entities with query or any tag below it
+  // Indexed under "A.2.1": Find("A.2") and Find("A.2.1") return it, Find("A.2.1.3") does not
+  void Find(const QTag query, std::vector<std::uint32_t>& outEntities) const
+  {
+    if (!query.IsValid())
+    {
+      return;
+    }
+
+    // Descendants follow the query in key order, so the range ends at the first key outside its prefix
+    const typename QTag::TagBaseType mask = QTag::GetPrefixMask(query.GetDepth());
+    const std::size_t first = std::lower_bound(Keys.begin(), Keys.end(), query) - Keys.begin();
+    std::size_t last = first;
+    while (last < Keys.size() && (Keys[last].GetRaw() & mask) == query.GetRaw())
+    {
+      ++last;
+    }
+
+    if (last - first == 1)
+    {
+      Lists[first].Decode(outEntities);
+    }
+    else if (last > first)
+    {
+      std::vector<const QTagUtil::TagPostingList*> lists;
+      lists.reserve(last - first);
+      for (std::size_t keyIdx = first; keyIdx < last; ++keyIdx)
+      {
+        lists.push_back(&Lists[keyIdx]);
+      }
+      QTagUtil::TagPostingList::Union(lists, outEntities);
+    }
+  }
+
+  // Appends the sorted IDs of entities indexed under exactly query
+  void FindExact(const QTag query, std::vector<std::uint32_t>& outEntities) const
+  {
+    if (const QTagUtil::TagPostingList* list = FindList(query))
+    {
+      list->Decode(outEntities);
+    }
+  }
+
+  bool HasEntityExact(const QTag tag, const std::uint32_t entityId) const
+  {
+    const QTagUtil::TagPostingList* list = FindList(tag);
+    return list && list->Contains(entityId);
+  }
+
+  // Posting list for exactly tag, nullptr if nothing is indexed under it
+  const QTagUtil::TagPostingList* FindList(const QTag tag) const
+  {
+    typename std::vector<QTag>::const_iterator it = std::lower_bound(Keys.begin(), Keys.end(), tag);
+    if (it == Keys.end() || *it != tag)
+    {
+      return nullptr;
+    }
+    return &Lists[it - Keys.begin()];
+  }
+
+  void Reset()
+  {
+    Keys.clear();
+    Lists.clear();
+  }
+
+  // Tags with at least one entity, sorted
+  std::span<const QTag> GetKeys() const { return Keys; }
+  std::size_t NumKeys() const { return Keys.size(); }
+
+  std::size_t GetMemoryUsage() const
+  {
+    std::size_t bytes = Keys.capacity() * sizeof(QTag) + Lists.capacity() * sizeof(QTagUtil::TagPostingList);
+    for (const QTagUtil::TagPostingList& list : Lists)
+    {
+      bytes += list.GetMemoryUsage();
+    }
+    return bytes;
+  }
+
+private:
+  std::vector<QTag> Keys;
+  std::vector<QTagUtil::TagPostingList> Lists; // Parallel to Keys
+};
@@ -0,0 +1,81 @@
+#pragma once
+#include "QuickTags-Loader.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <string>
+#include <vector>
+
+// Layout optimiser for the analyser.
+//
+// GetRequiredBitsPerField sizes each depth for the widest parent anywhere in the forest, so one
+// wide subtree can push every tag into a bigger base type. AnalyseLayout reports how many bits
+// each depth wastes for a typical parent, which subtrees are setting the widths, and proposes
+// changes that would fit a smaller EQTagIntBase:
+//   SplitSubtree:  move a subtree's descendants into a tag type of their own, the subtree's root
+//                  stays in the main type as the tag that says "look in the other type"
+//   GroupChildren: give a wide parent an extra level of group tags ("A.X" becomes "A.G3.X"), so
+//                  its children need fewer bits at the cost of a deeper layout and renamed tags
+//
+// Memory estimates count one of every registered tag. Containers, indices and tag arrays scale
+// the same way for tags drawn evenly from the registry.
+
+namespace QTagUtil
+{
+  // layoutBits sizes UIntN, the other bases are fixed
+  std::size_t GetIntBaseBytes(EQTagIntBase base, const std::vector<std::uint32_t>& layoutBits);
+
+  struct LayoutDepthReport
+  {
+    std::uint32_t FieldBits = 0;
+    std::uint32_t NumTags = 0;       // Tags whose own field is at this depth
+    std::uint32_t NumParents = 0;    // Tags with children at this depth, the top level counts as one
+    double MeanWastedBits = 0.0;     // Mean over parents of FieldBits less the bits their children need
+    std::string WidestParent;        // Parent whose children set FieldBits, empty for the top level
+    std::uint32_t RunnerUpBits = 0;  // Most bits any other parent needs, the width without WidestParent
+  };
+
+  struct LayoutSubtree
+  {
+    std::string Name;
+    std::size_t NumTags = 0;        // Descendants, excluding the subtree's own tag
+    std::uint32_t BitsFreed = 0;    // Layout bits saved if the subtree had no descendants
+  };
+
+  enum class ELayoutProposal
+  {
+    SplitSubtree,
+    GroupChildren
+  };
+
+  struct LayoutProposal
+  {
+    ELayoutProposal Kind;
+    std::string Subtree;
+    std::vector<std::uint32_t> LayoutBits;      // Main tag type after the change
+    EQTagIntBase Base;
+    std::vector<std::uint32_t> SplitLayoutBits; // SplitSubtree, the new type for the subtree's descendants
+    EQTagIntBase SplitBase = EQTagIntBase::UInt8;
+    std::uint32_t NumGroups = 0;                // GroupChildren, group tags added under Subtree
+    std::size_t NumTagsAffected = 0;            // Tags moved to the new type or renamed under a group
+    std::uint64_t BytesBefore = 0;
+    std::uint64_t BytesAfter = 0;
+  };
+
+  struct LayoutReport
+  {
+    std::vector<std::uint32_t> LayoutBits;
+    EQTagIntBase Base = EQTagIntBase::UInt8;
+    std::uint32_t UsedBits = 0;
+    std::size_t NumTags = 0;
+    std::vector<LayoutDepthReport> Depths;
+    std::vector<LayoutSubtree> HeaviestSubtrees;  // Most bits freed first
+    std::vector<LayoutProposal> Proposals;        // Only those reaching a smaller base, biggest saving first
+  };
+
+  // inTags must be enumerated (EnumerateTags or EnumerateTagsStable)
+  // Considers the subtrees setting each depth's width and their ancestors, so it stays a few
+  // passes over the tree rather than one per tag
+  void AnalyseLayout(const std::list<TagTreeNode>& inTags, LayoutReport& outReport, std::size_t maxSubtrees=5);
+}
@@ -0,0 +1,389 @@
+#pragma once
+#include "QuickTags.hpp"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Tag name literals resolved at compile time against a registry embedded in the program.
+//
+// The registry is a constexpr array of tag names (std::string_view, const char* or anything else
+// convertible to std::string_view), or a single string holding a whole tag file. It's taken through
+// the same rules as the loaders: names with spaces or tabs are skipped (so redirect lines are
+// harmless), files are split into lines with empty lines and a trailing '\r' dropped, names are
+// sorted and deduplicated, split on '.' and enumerated in order of first appearance, as
+// TreeifyTags and EnumerateTags would. Intermediate tags exist whether or not they're listed.
+//
+//   constexpr std::string_view GameTagNames[] = { "A", "A.1", "A.2.1", ... };
+//   #define QTAG(name) QTAG_LITERAL(GameTag, GameTagNames, name)
+//   constexpr GameTag tag = QTAG("A.2.1");
+//
+// A name that isn't in the registry fails to compile in UnknownTagLiteral, and one that the layout
+// can't hold (too deep, or a field value too wide) in TagLiteralDoesNotFitLayout. The registry is
+// built once per translation unit and each literal is a hash probe per segment, both entirely at
+// compile time. A few thousand names take a few seconds to build, larger registries may need the
+// compiler's constexpr limits raised (-fconstexpr-ops-limit, -fconstexpr-steps).
+
+#define QTAG_LITERAL(QTagType, TagNames, name) (QTagUtil::ResolveTagLiteral<QTagType, TagNames>(name))
+
+namespace QTagUtil
+{
+  template<class QTag>
+  struct ConstTagEntry
+  {
+    std::string_view Segment; // Views the registry
+    std::uint32_t Parent;
+    std::uint32_t Depth;
+    std::uint64_t TagAsInt;
+    QTag Tag;
+    bool bFits; // False where the layout can't hold this tag, Tag is then left empty
+  };
+
+  // Tree nodes in the order the loaders create them, each hashed by (parent, segment) as in FlatTagTree
+  template<class QTag, std::size_t MaxTags>
+  struct ConstTagRegistry
+  {
+    static constexpr std::uint32_t InvalidIndex = ~std::uint32_t(0);
+    // At most half full
+    static constexpr std::size_t NumSlots = std::bit_ceil(MaxTags * 2 + 2);
+
+    std::array<ConstTagEntry<QTag>, MaxTags> Entries;
+    std::array<std::uint32_t, NumSlots> Slots;
+    std::size_t NumTags;
+
+    constexpr std::size_t Num() const { return NumTags; }
+
+    // Null if name isn't in the registry. Each '.' starts a segment, so empty segments match what the
+    // loaders named them ("A." is the empty child of A)
+    constexpr const ConstTagEntry<QTag>* Find(const std::string_view name) const
+    {
+      std::uint32_t idx = InvalidIndex;
+      for (std::size_t segmentStart = 0; ; )
+      {
+        const std::size_t segmentEnd = name.find('.', segmentStart);
+        idx = FindChild(idx, name.substr(segmentStart, segmentEnd == std::string_view::npos ? std::string_view::npos : segmentEnd - segmentStart));
+        if (idx == InvalidIndex || segmentEnd == std::string_view::npos)
+        {
+          return idx == InvalidIndex ? nullptr : &Entries[idx];
+        }
+        segmentStart = segmentEnd + 1;
+      }
+    }
+
+    constexpr std::uint32_t FindChild(const std::uint32_t parent, const std::string_view segment) const
+    {
+      for (std::size_t slot = GetSlot(parent, segment); Slots[slot] != InvalidIndex; slot = (slot + 1) & (NumSlots - 1))
+      {
+        const ConstTagEntry<QTag>& entry = Entries[Slots[slot]];
+        if (entry.Parent == parent && entry.Segment == segment)
+        {
+          return Slots[slot];
+        }
+      }
+      return InvalidIndex;
+    }
+
+    // The child of parent named segment, added if it's new. As in EnumerateTags, children are
+    // numbered from 1 in the order they're added.
+    constexpr std::uint32_t FindOrAddChild(const std::uint32_t parent, const std::string_view segment, std::uint64_t& inOutNumChildren)
+    {
+      std::size_t slot = GetSlot(parent, segment);
+      for (; Slots[slot] != InvalidIndex; slot = (slot + 1) & (NumSlots - 1))
+      {
+        const ConstTagEntry<QTag>& entry = Entries[Slots[slot]];
+        if (entry.Parent == parent && entry.Segment == segment)
+        {
+          return Slots[slot];
+        }
+      }
+      const std::uint32_t idx = (std::uint32_t)NumTags++;
+      Entries[idx] = { segment, parent, parent == InvalidIndex ? 0 : Entries[parent].Depth + 1, ++inOutNumChildren, QTag(), true };
+      Slots[slot] = idx;
+      return idx;
+    }
+
+  private:
+    static constexpr std::size_t GetSlot(const std::uint32_t parent, const std::string_view segment)
+    {
+      return (std::size_t)HashTagName(segment, parent) & (NumSlots - 1);
+    }
+  };
+
+  namespace Internal
+  {
+    // Not constexpr, so reaching either of these during constant evaluation is the compile error
+    inline void UnknownTagLiteral() {}
+    inline void TagLiteralDoesNotFitLayout() {}
+
+    // Sorting is most of the cost of building a registry, and constant evaluation makes character by
+    // character comparison slow, so names are ordered by their first 8 characters packed into an
+    // integer, and only compared beyond that on a tie
+    struct ConstTagName
+    {
+      std::uint64_t Key;
+      std::string_view Name;
+
+      constexpr bool operator<(const ConstTagName& other) const
+      {
+        if (Key != other.Key)
+        {
+          return Key < other.Key;
+        }
+        // Matches std::string_view, which compares as unsigned char
+        const std::size_t length = std::min(Name.size(), other.Name.size());
+        for (std::size_t i = sizeof(Key); i < length; ++i)
+        {
+          if (Name[i] != other.Name[i])
+          {
+            return (unsigned char)Name[i] < (unsigned char)other.Name[i];
+          }
+        }
+        return Name.size() < other.Name.size();
+      }
+
+      constexpr bool operator==(const ConstTagName& other) const
+      {
+        return Key == other.Key && Name == other.Name;
+      }
+    };
+
+    // Sorted, unique names of a registry, NumNames of MaxNames are used
+    template<std::size_t MaxNames>
+    struct ConstTagNames
+    {
+      std::array<ConstTagName, MaxNames> Names;
+      std::size_t NumNames;
+    };
+
+    template<std::size_t MaxNames>
+    constexpr void AddConstTagName(const std::string_view name, ConstTagNames<MaxNames>& outNames)
+    {
+      // As BuildTagStringSetFromFile, the empty name adds no nodes so is dropped too
+      std::uint64_t key = 0;
+      for (std::size_t i = 0; i < name.size(); ++i)
+      {
+        if (name[i] == ' ' || name[i] == '\t')
+        {
+          return;
+        }
+        key = i < sizeof(key) ? key | (std::uint64_t((unsigned char)name[i]) << (56 - 8 * i)) : key;
+      }
+      if (!name.empty())
+      {
+        outNames.Names[outNames.NumNames++] = { key, name };
+      }
+    }
+
+    template<const auto& TagNames>
+    constexpr bool IsConstTagFile()
+    {
+      return std::is_convertible_v<decltype(TagNames), std::string_view>;
+    }
+
+    template<const auto& TagNames>
+    constexpr std::size_t GetMaxConstTagNames()
+    {
+      if constexpr (IsConstTagFile<TagNames>())
+      {
+        const std::string_view text = TagNames;
+        return (std::size_t)std::count(text.begin(), text.end(), '\n') + 1;
+      }
+      else
+      {
+        return std::size(TagNames);
+      }
+    }
+
+    // Registry names in the loader's order, a single string is split into lines as SplitTagLines does
+    template<const auto& TagNames>
+    constexpr auto BuildConstTagNames()
+    {
+      ConstTagNames<GetMaxConstTagNames<TagNames>()> names{};
+      if constexpr (IsConstTagFile<TagNames>())
+      {
+        const std::string_view text = TagNames;
+        for (std::size_t lineStart = 0; lineStart < text.size(); )
+        {
+          std::size_t lineEnd = text.find('\n', lineStart);
+          lineEnd = lineEnd == std::string_view::npos ? text.size() : lineEnd;
+          std::string_view line = text.substr(lineStart, lineEnd - lineStart);
+          if (!line.empty() && line.back() == '\r')
+          {
+            line.remove_suffix(1);
+          }
+          AddConstTagName(line, names);
+          lineStart = lineEnd + 1;
+        }
+      }
+      else
+      {
+        for (const auto& name : TagNames)
+        {
+          AddConstTagName(name, names);
+        }
+      }
+
+      // Tag files are usually kept sorted, which is much cheaper to check than to sort again
+      const auto namesBegin = names.Names.begin();
+      const auto namesEnd = namesBegin + names.NumNames;
+      if (!std::is_sorted(namesBegin, namesEnd))
+      {
+        std::sort(namesBegin, namesEnd);
+      }
+      names.NumNames = (std::size_t)(std::unique(namesBegin, namesEnd) - namesBegin);
+      return names;
+    }
+
+    // Built once, then shared by sizing the registry and filling it
+    template<const auto& TagNames>
+    inline constexpr auto ConstTagNamesFor = BuildConstTagNames<TagNames>();
+
+    // Number of leading segments tagName shares with prevName, its previous name in sorted order,
+    // and where the first segment after them starts
+    constexpr std::size_t GetNumSharedSegments(const std::string_view prevName, const std::string_view tagName, std::size_t& outSegmentStart)
+    {
+      std::size_t numShared = 0;
+      std::size_t i = 0;
+      outSegmentStart = 0;
+      for (; i < tagName.size() && i < prevName.size() && tagName[i] == prevName[i]; ++i)
+      {
+        if (tagName[i] == '.')
+        {
+          ++numShared;
+          outSegmentStart = i + 1;
+        }
+      }
+      // The previous name ending where this one has a '.' shares that segment too, unless it was
+      // the empty trailing segment that never became a node
+      if (i == prevName.size() && i < tagName.size() && tagName[i] == '.' && !prevName.empty() && prevName.back() != '.')
+      {
+        ++numShared;
+        outSegmentStart = i + 1;
+      }
+      return numShared;
+    }
+
+    // Segments not shared with the previous name. Only overcounts where sorting puts another name
+    // between two that share a node (A.B, A.B-x, A.B.c)
+    template<const auto& TagNames>
+    constexpr std::size_t GetMaxConstTags()
+    {
+      std::size_t maxTags = 0;
+      std::string_view prevName;
+      const auto& names = ConstTagNamesFor<TagNames>;
+      for (std::size_t nameIdx = 0; nameIdx < names.NumNames; ++nameIdx)
+      {
+        const ConstTagName& name = names.Names[nameIdx];
+        std::size_t segmentStart;
+        GetNumSharedSegments(prevName, name.Name, segmentStart);
+        maxTags += (std::size_t)std::count(name.Name.begin() + segmentStart, name.Name.end(), '.') + (segmentStart < name.Name.size() ? 1 : 0);
+        prevName = name.Name;
+      }
+      return maxTags;
+    }
+
+    template<class QTag>
+    constexpr bool FitsField(const std::uint32_t depth, const std::uint64_t value)
+    {
+      if (depth >= QTag::GetNumFields())
+      {
+        return false;
+      }
+      const unsigned char bits = QTag::GetFieldBitWidth((unsigned char)depth);
+      return bits >= 64 || value < (std::uint64_t(1) << bits);
+    }
+
+    template<class QTag, const auto& TagNames>
+    constexpr auto BuildConstTagRegistry()
+    {
+      using BaseType = typename QTag::TagBaseType;
+      using Registry = ConstTagRegistry<QTag, GetMaxConstTags<TagNames>()>;
+
+      Registry registry{};
+      registry.Slots.fill(Registry::InvalidIndex);
+      registry.NumTags = 0;
+
+      // Walk the sorted names as TreeifyTags does, splitting on '.' as SplitString does (a trailing
+      // empty segment is dropped). Neighbouring names mostly share leading segments, so each walk
+      // resumes below the last segment in common with the previous name.
+      const auto& names = ConstTagNamesFor<TagNames>;
+      std::size_t maxDepth = 0;
+      for (std::size_t nameIdx = 0; nameIdx < names.NumNames; ++nameIdx)
+      {
+        maxDepth = std::max(maxDepth, names.Names[nameIdx].Name.size() + 1);
+      }
+      std::vector<std::uint64_t> numChildren(registry.Entries.size() + 1, 0);
+      std::vector<std::uint32_t> path(maxDepth);
+      std::string_view prevName;
+      for (std::size_t nameIdx = 0; nameIdx < names.NumNames; ++nameIdx)
+      {
+        const std::string_view tagName = names.Names[nameIdx].Name;
+        std::size_t segmentStart;
+        std::size_t depth = GetNumSharedSegments(prevName, tagName, segmentStart);
+        prevName = tagName;
+
+        while (segmentStart < tagName.size())
+        {
+          std::size_t segmentEnd = tagName.find('.', segmentStart);
+          segmentEnd = segmentEnd == std::string_view::npos ? tagName.size() : segmentEnd;
+          // Top-level tags count their siblings in the last slot
+          const std::uint32_t parent = depth == 0 ? Registry::InvalidIndex : path[depth - 1];
+          std::uint64_t& parentNumChildren = numChildren[depth == 0 ? registry.Entries.size() : parent];
+          path[depth++] = registry.FindOrAddChild(parent, tagName.substr(segmentStart, segmentEnd - segmentStart), parentNumChildren);
+          segmentStart = segmentEnd + 1;
+        }
+      }
+
+      for (std::size_t idx = 0; idx < registry.NumTags; ++idx)
+      {
+        ConstTagEntry<QTag>& entry = registry.Entries[idx];
+
+        // Field values from the node up to its root, a node deeper than the layout never gets this far
+        BaseType fields[QTag::GetNumFields()] = {};
+        for (std::uint32_t fieldIdx = (std::uint32_t)idx; fieldIdx != Registry::InvalidIndex; fieldIdx = registry.Entries[fieldIdx].Parent)
+        {
+          const ConstTagEntry<QTag>& node = registry.Entries[fieldIdx];
+          if (!FitsField<QTag>(node.Depth, node.TagAsInt))
+          {
+            entry.bFits = false;
+            break;
+          }
+          fields[node.Depth] = (BaseType)node.TagAsInt;
+        }
+        if (entry.bFits)
+        {
+          entry.Tag = [&fields]<std::size_t... FieldIdx>(std::index_sequence<FieldIdx...>)
+          {
+            return QTag::MakeTag(fields[FieldIdx]...);
+          }(std::make_index_sequence<QTag::GetNumFields()>());
+        }
+      }
+      return registry;
+    }
+  }
+
+  // Built on first use in each translation unit, the names must outlive it (a constexpr array does)
+  template<class QTag, const auto& TagNames>
+  inline constexpr auto ConstTagRegistryFor = Internal::BuildConstTagRegistry<QTag, TagNames>();
+
+  template<class QTag, const auto& TagNames>
+  consteval QTag ResolveTagLiteral(const std::string_view name)
+  {
+    const ConstTagEntry<QTag>* entry = ConstTagRegistryFor<QTag, TagNames>.Find(name);
+    if (!entry)
+    {
+      Internal::UnknownTagLiteral();
+    }
+    else if (!entry->bFits)
+    {
+      Internal::TagLiteralDoesNotFitLayout();
+    }
+    return entry ? entry->Tag : QTag();
+  }
+}
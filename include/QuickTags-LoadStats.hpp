@@ -0,0 +1,192 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <new>
+#include <vector>
+
+// Per-stage wall time and heap stats for the loader pipeline.
+//
+// A ScopedLoadStage records one stage. When it ends, a LoadStageStats entry is appended to the
+// LoadStats and passed to OnStageComplete. LoadQuickTagsFromFile and LoadQuickTagsFromMappedFile
+// record their own stages when given a LoadStats. Callers can wrap anything else (TreeifyTags,
+// EnumerateTags, ...) themselves. Stages shouldn't nest, each one restarts peak tracking.
+//
+// The library can't see allocations without owning global operator new, so counting is opt-in:
+// put QTAG_DEFINE_ALLOCATION_TRACKING() in one .cpp of the program to install replacements that
+// report to QTagUtil::AllocTracking. Without it the allocation fields stay 0. Counters are
+// process-wide, so other threads allocating during a stage are counted too.
+
+namespace QTagUtil
+{
+  namespace AllocTracking
+  {
+    struct Counters
+    {
+      std::atomic<std::uint64_t> NumAllocations = 0;
+      std::atomic<std::uint64_t> LiveBytes = 0;
+      std::atomic<std::uint64_t> PeakBytes = 0;
+    };
+
+    inline Counters GlobalCounters;
+    inline std::atomic<bool> bEnabled = false; // Set by QTAG_DEFINE_ALLOCATION_TRACKING
+
+    inline bool IsEnabled() { return bEnabled.load(std::memory_order_relaxed); }
+
+    inline void RecordAlloc(const std::size_t bytes)
+    {
+      GlobalCounters.NumAllocations.fetch_add(1, std::memory_order_relaxed);
+      const std::uint64_t live = GlobalCounters.LiveBytes.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+      std::uint64_t peak = GlobalCounters.PeakBytes.load(std::memory_order_relaxed);
+      while (live > peak && !GlobalCounters.PeakBytes.compare_exchange_weak(peak, live, std::memory_order_relaxed))
+      {
+      }
+    }
+
+    inline void RecordFree(const std::size_t bytes)
+    {
+      GlobalCounters.LiveBytes.fetch_sub(bytes, std::memory_order_relaxed);
+    }
+
+    // Restarts the peak from the current live bytes
+    inline void ResetPeak()
+    {
+      GlobalCounters.PeakBytes.store(GlobalCounters.LiveBytes.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    }
+
+    namespace Internal
+    {
+      // Each block starts with its size, so frees can be counted without sized delete
+      constexpr std::size_t HeaderSize = alignof(std::max_align_t);
+
+      inline void* Allocate(std::size_t bytes) noexcept
+      {
+        bytes = bytes == 0 ? 1 : bytes;
+        void* const block = std::malloc(bytes + HeaderSize);
+        if (!block)
+        {
+          return nullptr;
+        }
+        *static_cast<std::size_t*>(block) = bytes;
+        RecordAlloc(bytes);
+        return static_cast<char*>(block) + HeaderSize;
+      }
+
+      inline void* AllocateOrThrow(const std::size_t bytes)
+      {
+        void* const ptr = Allocate(bytes);
+        if (!ptr)
+        {
+          throw std::bad_alloc();
+        }
+        return ptr;
+      }
+
+      inline void Free(void* const ptr) noexcept
+      {
+        if (!ptr)
+        {
+          return;
+        }
+        void* const block = static_cast<char*>(ptr) - HeaderSize;
+        RecordFree(*static_cast<std::size_t*>(block));
+        std::free(block);
+      }
+    }
+  }
+
+  struct LoadStageStats
+  {
+    const char* Stage = nullptr;
+    double Milliseconds = 0.0;
+    std::uint64_t NumAllocations = 0; // These three stay 0 without allocation tracking
+    std::uint64_t PeakBytes = 0;      // Highest live heap above where the stage started
+    std::int64_t RetainedBytes = 0;   // Live heap change over the stage, what its output holds on to
+  };
+
+  struct LoadStats
+  {
+    std::vector<LoadStageStats> Stages;
+    std::function<void(const LoadStageStats&)> OnStageComplete; // Optional
+
+    double GetTotalMilliseconds() const
+    {
+      double total = 0.0;
+      for (const LoadStageStats& stage : Stages)
+      {
+        total += stage.Milliseconds;
+      }
+      return total;
+    }
+  };
+
+  // Records the enclosing scope as a stage of stats, does nothing if stats is null
+  class ScopedLoadStage
+  {
+  public:
+    ScopedLoadStage(LoadStats* stats, const char* stage)
+      : Stats(stats)
+      , Stage(stage)
+    {
+      if (Stats)
+      {
+        AllocTracking::ResetPeak();
+        StartAllocations = AllocTracking::GlobalCounters.NumAllocations.load(std::memory_order_relaxed);
+        StartLiveBytes = AllocTracking::GlobalCounters.LiveBytes.load(std::memory_order_relaxed);
+        Start = std::chrono::steady_clock::now();
+      }
+    }
+
+    ~ScopedLoadStage()
+    {
+      if (!Stats)
+      {
+        return;
+      }
+
+      // Sample before anything here allocates
+      const std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+      const AllocTracking::Counters& counters = AllocTracking::GlobalCounters;
+      LoadStageStats stageStats;
+      stageStats.Stage = Stage;
+      stageStats.Milliseconds = std::chrono::duration<double, std::milli>(end - Start).count();
+      stageStats.NumAllocations = counters.NumAllocations.load(std::memory_order_relaxed) - StartAllocations;
+      stageStats.PeakBytes = counters.PeakBytes.load(std::memory_order_relaxed) - StartLiveBytes;
+      stageStats.RetainedBytes = std::int64_t(counters.LiveBytes.load(std::memory_order_relaxed) - StartLiveBytes);
+
+      Stats->Stages.push_back(stageStats);
+      if (Stats->OnStageComplete)
+      {
+        Stats->OnStageComplete(stageStats);
+      }
+    }
+
+    ScopedLoadStage(const ScopedLoadStage&) = delete;
+    ScopedLoadStage& operator=(const ScopedLoadStage&) = delete;
+
+  private:
+    LoadStats* Stats;
+    const char* Stage;
+    std::chrono::steady_clock::time_point Start;
+    std::uint64_t StartAllocations = 0;
+    std::uint64_t StartLiveBytes = 0;
+  };
+}
+
+// Replaces global operator new/delete with versions that count into QTagUtil::AllocTracking
+// Use in exactly one .cpp of a program, at global scope
+#define QTAG_DEFINE_ALLOCATION_TRACKING() \
+  void* operator new(std::size_t bytes) { return QTagUtil::AllocTracking::Internal::AllocateOrThrow(bytes); } \
+  void* operator new[](std::size_t bytes) { return QTagUtil::AllocTracking::Internal::AllocateOrThrow(bytes); } \
+  void* operator new(std::size_t bytes, const std::nothrow_t&) noexcept { return QTagUtil::AllocTracking::Internal::Allocate(bytes); } \
+  void* operator new[](std::size_t bytes, const std::nothrow_t&) noexcept { return QTagUtil::AllocTracking::Internal::Allocate(bytes); } \
+  void operator delete(void* ptr) noexcept { QTagUtil::AllocTracking::Internal::Free(ptr); } \
+  void operator delete[](void* ptr) noexcept { QTagUtil::AllocTracking::Internal::Free(ptr); } \
+  void operator delete(void* ptr, std::size_t) noexcept { QTagUtil::AllocTracking::Internal::Free(ptr); } \
+  void operator delete[](void* ptr, std::size_t) noexcept { QTagUtil::AllocTracking::Internal::Free(ptr); } \
+  void operator delete(void* ptr, const std::nothrow_t&) noexcept { QTagUtil::AllocTracking::Internal::Free(ptr); } \
+  void operator delete[](void* ptr, const std::nothrow_t&) noexcept { QTagUtil::AllocTracking::Internal::Free(ptr); } \
+  static const bool bQTagAllocTrackingEnabled = (QTagUtil::AllocTracking::bEnabled = true)
@@ -1,7 +1,10 @@
 #pragma once
 #include "QuickTags.hpp"
+#include "QuickTags-FlatTree.hpp"
+#include "QuickTags-LoadStats.hpp"
 
 #include <string>
+#include <string_view>
 #include <fstream>
 #include <set>
 #include <map>
@@ -19,9 +22,16 @@ namespace QTagUtil
     CaseInsensitive = (1 << 0),
   };
 
-  void BuildTagStringSetFromFiles(std::vector<std::fstream>& inFiles, std::set<std::string>& outStringSet, ETagSetFlags flags=ETagSetFlags::None);
+  // numThreads > 1 reads files concurrently into per-thread sets and merges them, the result is the
+  // same as the sequential path for any thread count. 0 uses one thread per hardware thread.
+  void BuildTagStringSetFromFiles(std::vector<std::fstream>& inFiles, std::set<std::string>& outStringSet, ETagSetFlags flags=ETagSetFlags::None, unsigned int numThreads=1);
   void BuildTagStringSetFromFile(std::fstream& inFile, std::set<std::string>& outStringSet, ETagSetFlags flags=ETagSetFlags::None);
 
+  // Splits a buffer into tag lines without copying, views point into inBuffer
+  // Follows BuildTagStringSetFromFile's rules (lines with spaces or tabs are skipped) and also drops
+  // empty lines and a trailing '\r'. Newlines and whitespace are found with SIMD where available.
+  void SplitTagLines(std::string_view inBuffer, std::vector<std::string_view>& outLines);
+
   struct TagTreeNode
   {
     std::string Tag;
@@ -35,6 +45,12 @@ namespace QTagUtil
       , ParentTag(nullptr)
     {}
 
+    TagTreeNode(std::string_view tag)
+      : Tag(tag)
+      , TagAsInt(0)
+      , ParentTag(nullptr)
+    {}
+
     bool operator==(const TagTreeNode& other) const
     {
       return other.Tag == Tag;
@@ -42,10 +58,23 @@ namespace QTagUtil
   };
 
   void TreeifyTags(const std::set<std::string>& inStringSet, std::list<TagTreeNode>& outTagTrees);
+  // inSortedTags must be sorted and unique, as if it had come from a std::set<std::string>
+  void TreeifyTags(std::span<const std::string_view> inSortedTags, std::list<TagTreeNode>& outTagTrees);
+
+  // Memory-maps each file and builds the tag tree straight from views into the mapping, the only
+  // per-tag allocations are the tree's nodes. Returns false if any file couldn't be opened.
+  // Files are mapped, split and sorted in parallel with numThreads as for BuildTagStringSetFromFiles.
+  bool BuildTagTreeFromMappedFiles(const std::vector<std::string>& inPaths, std::list<TagTreeNode>& outTagTrees, ETagSetFlags flags=ETagSetFlags::None, unsigned int numThreads=1);
+  bool BuildTagTreeFromMappedFile(const std::string& inPath, std::list<TagTreeNode>& outTagTrees, ETagSetFlags flags=ETagSetFlags::None);
+  // As above, building a FlatTagTree, which comes out already enumerated
+  bool BuildFlatTagTreeFromMappedFiles(const std::vector<std::string>& inPaths, FlatTagTree& outTagTree, ETagSetFlags flags=ETagSetFlags::None, unsigned int numThreads=1);
 
   void EnumerateTags(std::list<TagTreeNode>& tags);
 
   void FindTagRanges(const std::list<TagTreeNode>& inTags, std::vector<std::uint32_t>& outRanges);
+  // Largest TagAsInt at each depth. Equal to FindTagRanges after EnumerateTags, but stable
+  // enumeration leaves gaps, so it's what a layout has to be able to hold.
+  void FindTagValueRanges(const std::list<TagTreeNode>& inTags, std::vector<std::uint32_t>& outRanges);
 
   void GetRequiredBitsPerField(const std::vector<std::uint32_t>& fieldRanges, std::vector<std::uint32_t>& outBits);
 
@@ -54,7 +83,10 @@ namespace QTagUtil
     UInt8,
     UInt16,
     UInt32,
-    UInt64
+    UInt64,
+    UInt128, // QTagUtil::UInt128
+    UInt256, // QTagUtil::UInt256
+    UIntN    // QTagUtil::UIntN<NumWords>, past 256 bits, NumWords is the layout's bits in 64-bit words
   };
   EQTagIntBase FindSmallestIntBase(const std::vector<std::uint32_t>& inBits);
 
@@ -108,9 +140,9 @@ namespace QTagUtil
         }
 
 #ifdef QTAG_DEBUGSTRINGS
-        char* tagAsString = tag.ValueAsString();
+        char tagAsString[QTag::MaxStringLength + 1];
+        tag.ToChars(tagAsString, sizeof(tagAsString));
         printf("%s:\t\t%s\n", tagString.c_str(), tagAsString);
-        delete[] tagAsString;
 #endif
 
         // Add to outTags
@@ -120,24 +152,86 @@ namespace QTagUtil
         outTagStringMap.emplace(tag, tagString);
       }
     }
+    // Flat tree version, names are built from the parent's name rather than by walking up per tag
+    template<class QTag>
+    void GetEachTagAsQTag(const FlatTagTree& tagTree, std::map<QTag, std::string>& outTagStringMap, std::vector<QTag>& outTags)
+    {
+      const std::span<const FlatTagNode> nodes = tagTree.GetNodes();
+      std::vector<QTag> nodeTags(nodes.size());
+      std::vector<const std::string*> nodeNames(nodes.size());
+
+      tagTree.VisitPreOrder([&](const FlatTagNode& node)
+        {
+          const std::uint32_t idx = tagTree.GetIndex(node);
+          // Tree is deeper than the tag type, nothing below here can be represented
+          if (node.Depth >= QTag::GetNumFields() || (node.Parent != FlatTagNode::InvalidIndex && !nodeNames[node.Parent]))
+          {
+            return;
+          }
+
+          QTag tag = node.Parent == FlatTagNode::InvalidIndex ? QTag() : nodeTags[node.Parent];
+          tag.SetField((unsigned char)node.Depth, (typename QTag::TagBaseType)node.TagAsInt);
+          nodeTags[idx] = tag;
+
+          std::string tagString;
+          if (node.Parent != FlatTagNode::InvalidIndex)
+          {
+            const std::string& parentName = *nodeNames[node.Parent];
+            tagString.reserve(parentName.size() + 1 + node.SegmentLength);
+            tagString.append(parentName).push_back('.');
+          }
+          tagString.append(tagTree.GetSegment(node));
+
+#ifdef QTAG_DEBUGSTRINGS
+          char tagAsString[QTag::MaxStringLength + 1];
+          tag.ToChars(tagAsString, sizeof(tagAsString));
+          printf("%s:\t\t%s\n", tagString.c_str(), tagAsString);
+#endif
+
+          outTags.push_back(tag);
+          // Map nodes are stable, so children can keep referring to their parent's name
+          nodeNames[idx] = &outTagStringMap.emplace(tag, std::move(tagString)).first->second;
+        });
+    }
   }  
 
+  // outStats, if given, gets a stage for each step of the pipeline
   template<class QTag>
-  void LoadQuickTagsFromFile(std::fstream& inFile, std::map<QTag, std::string>& outTagStringMap, std::vector<QTag>& outTags)
+  void LoadQuickTagsFromFile(std::fstream& inFile, std::map<QTag, std::string>& outTagStringMap, std::vector<QTag>& outTags, LoadStats* outStats=nullptr)
   {
     // Find all unique, valid tag strings
     std::set<std::string> stringSet;
-    BuildTagStringSetFromFile(inFile, stringSet);
+    {
+      ScopedLoadStage stage(outStats, "BuildTagStringSetFromFile");
+      BuildTagStringSetFromFile(inFile, stringSet);
+    }
 
-    // Build tree from split tags, enumerate (assign value to each sub-tag)
-    std::list<TagTreeNode> tagTree;
-    TreeifyTags(stringSet, tagTree);
-    EnumerateTags(tagTree);
+    // Build an enumerated tree from split tags (each sub-tag gets a value as it's laid out)
+    FlatTagTree tagTree;
+    {
+      ScopedLoadStage stage(outStats, "FlatTagTree::Build");
+      tagTree.Build(stringSet);
+    }
 
     // For each node in tree, create corresponding tag
-    for (const TagTreeNode& topLevelNode : tagTree)
+    ScopedLoadStage stage(outStats, "GetEachTagAsQTag");
+    Internal::GetEachTagAsQTag(tagTree, outTagStringMap, outTags);
+  }
+
+  // As LoadQuickTagsFromFile, reading through BuildFlatTagTreeFromMappedFiles
+  template<class QTag>
+  bool LoadQuickTagsFromMappedFile(const std::string& inPath, std::map<QTag, std::string>& outTagStringMap, std::vector<QTag>& outTags, LoadStats* outStats=nullptr)
+  {
+    FlatTagTree tagTree;
     {
-      Internal::GetEachTagAsQTag(topLevelNode, outTagStringMap, outTags);
+      ScopedLoadStage stage(outStats, "BuildFlatTagTreeFromMappedFiles");
+      if (!BuildFlatTagTreeFromMappedFiles({ inPath }, tagTree))
+      {
+        return false;
+      }
     }
+    ScopedLoadStage stage(outStats, "GetEachTagAsQTag");
+    Internal::GetEachTagAsQTag(tagTree, outTagStringMap, outTags);
+    return true;
   }
 }
@@ -0,0 +1,403 @@
+#pragma once
+#include "QuickTags.hpp"
+#include "QuickTags-Simd.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <utility>
+#include <vector>
+
+// Flat open-addressing map from QuickTag to V, for per-tag data looked up every tick.
+//
+// Keys are stored as raw values in one array with the values alongside, probed linearly from
+// HashRawValue. The zero tag is never valid so a raw 0 marks an empty slot, and removal shifts
+// the following run back rather than leaving tombstones, so lookups never slow down with churn.
+//
+// FindNearestAncestor is the inherited-config lookup: "A.2.1" falls back to "A.2", then "A".
+// Each ancestor is one masked probe (Value & GetPrefixMask(d)), and depths with no entries at all
+// are skipped outright, so a map keyed only on top level tags costs one probe whatever the query.
+//
+// V must be default constructible, empty slots hold a default V.
+template<class QTag, class V>
+class QuickTagMap
+{
+public:
+  using TagType = QTag;
+  using ValueType = V;
+
+  QuickTagMap() = default;
+
+  explicit QuickTagMap(const std::size_t expectedNum)
+  {
+    Reserve(expectedNum);
+  }
+
+  // Inserts or overwrites, returns true if tag was not already present
+  // Invalid tags are ignored and return false
+  bool Add(const QTag& tag, V value)
+  {
+    bool bAdded = false;
+    V* const slotValue = FindOrAddSlot(tag, bAdded);
+    if (slotValue == nullptr)
+    {
+      return false;
+    }
+    *slotValue = std::move(value);
+    return bAdded;
+  }
+
+  // Value for tag, default constructed first if absent. Null for an invalid tag
+  V* FindOrAdd(const QTag& tag)
+  {
+    bool bAdded = false;
+    return FindOrAddSlot(tag, bAdded);
+  }
+
+  V* Find(const QTag& tag)
+  {
+    const std::size_t slot = FindSlot(tag.GetRaw());
+    return slot != InvalidSlot ? &Values[slot] : nullptr;
+  }
+
+  const V* Find(const QTag& tag) const
+  {
+    const std::size_t slot = FindSlot(tag.GetRaw());
+    return slot != InvalidSlot ? &Values[slot] : nullptr;
+  }
+
+  bool Contains(const QTag& tag) const
+  {
+    return FindSlot(tag.GetRaw()) != InvalidSlot;
+  }
+
+  // Removes exactly tag (descendants are left alone), returns true if the map changed
+  bool Remove(const QTag& tag)
+  {
+    const std::size_t slot = FindSlot(tag.GetRaw());
+    if (slot == InvalidSlot)
+    {
+      return false;
+    }
+    --DepthCounts[tag.GetDepth()];
+    --Count;
+    EraseSlot(slot);
+    return true;
+  }
+
+  // Entry for the deepest of tag and its ancestors that is in the map, null if none are
+  // "A.2" in map: FindNearestAncestor("A.2.1") and FindNearestAncestor("A.2") give "A.2"'s value,
+  // FindNearestAncestor("A.1") gives "A"'s value if present, otherwise null
+  const V* FindNearestAncestor(const QTag& tag, QTag* outMatched=nullptr) const
+  {
+    if (Count == 0 || !tag.IsValid())
+    {
+      return nullptr;
+    }
+    for (int depth = tag.GetDepth(); depth > 0; --depth)
+    {
+      if (DepthCounts[depth] == 0)
+      {
+        continue;
+      }
+      const BaseType ancestor = tag.GetRaw() & QTag::GetPrefixMask(depth);
+      const std::size_t slot = FindSlot(ancestor);
+      if (slot != InvalidSlot)
+      {
+        if (outMatched)
+        {
+          *outMatched = QTag(ancestor);
+        }
+        return &Values[slot];
+      }
+    }
+    return nullptr;
+  }
+
+  V* FindNearestAncestor(const QTag& tag, QTag* outMatched=nullptr)
+  {
+    return const_cast<V*>(std::as_const(*this).FindNearestAncestor(tag, outMatched));
+  }
+
+  // Batch lookups, outValues[i] is the result for tags[i]
+  // Works through the tags a group at a time, prefetching each group's first slot before probing
+  // any of them, so the cache misses of a group overlap instead of queueing one after another
+  void FindMany(std::span<const QTag> tags, std::span<const V*> outValues) const
+  {
+    const std::size_t num = std::min(tags.size(), outValues.size());
+    if (Count == 0)
+    {
+      std::fill(outValues.begin(), outValues.begin() + num, nullptr);
+      return;
+    }
+
+    std::size_t homeSlots[BatchSize];
+    for (std::size_t groupBegin = 0; groupBegin < num; groupBegin += BatchSize)
+    {
+      const std::size_t groupSize = std::min(BatchSize, num - groupBegin);
+      for (std::size_t i = 0; i < groupSize; ++i)
+      {
+        homeSlots[i] = GetHomeSlot(tags[groupBegin + i].GetRaw());
+        QTAG_PREFETCH(&Keys[homeSlots[i]]);
+      }
+      for (std::size_t i = 0; i < groupSize; ++i)
+      {
+        const BaseType raw = tags[groupBegin + i].GetRaw();
+        // The zero tag would "find" the first empty slot
+        const std::size_t slot = raw != BaseType(0) ? FindSlotFrom(raw, homeSlots[i]) : InvalidSlot;
+        outValues[groupBegin + i] = slot != InvalidSlot ? &Values[slot] : nullptr;
+      }
+    }
+  }
+
+  // outMatched is optional, when given it gets the matched ancestor (or the zero tag) per query
+  void FindNearestAncestorMany(std::span<const QTag> tags, std::span<const V*> outValues, std::span<QTag> outMatched={}) const
+  {
+    const std::size_t num = std::min(tags.size(), outValues.size());
+    const bool bWantMatched = outMatched.size() >= num;
+    if (Count == 0)
+    {
+      std::fill(outValues.begin(), outValues.begin() + num, nullptr);
+      if (bWantMatched)
+      {
+        std::fill(outMatched.begin(), outMatched.begin() + num, QTag());
+      }
+      return;
+    }
+
+    // The deepest populated depth is the probe most likely to miss the cache and is prefetched,
+    // shallower fallbacks tend to be few distinct keys that stay resident
+    int startDepths[BatchSize];
+    std::size_t homeSlots[BatchSize];
+    for (std::size_t groupBegin = 0; groupBegin < num; groupBegin += BatchSize)
+    {
+      const std::size_t groupSize = std::min(BatchSize, num - groupBegin);
+      for (std::size_t i = 0; i < groupSize; ++i)
+      {
+        const QTag& tag = tags[groupBegin + i];
+        int depth = tag.IsValid() ? tag.GetDepth() : 0;
+        while (depth > 0 && DepthCounts[depth] == 0)
+        {
+          --depth;
+        }
+        startDepths[i] = depth;
+        if (depth > 0)
+        {
+          homeSlots[i] = GetHomeSlot(tag.GetRaw() & QTag::GetPrefixMask(depth));
+          QTAG_PREFETCH(&Keys[homeSlots[i]]);
+        }
+      }
+      for (std::size_t i = 0; i < groupSize; ++i)
+      {
+        const QTag& tag = tags[groupBegin + i];
+        const V* found = nullptr;
+        QTag matched;
+        for (int depth = startDepths[i]; depth > 0; --depth)
+        {
+          if (DepthCounts[depth] == 0)
+          {
+            continue;
+          }
+          const BaseType ancestor = tag.GetRaw() & QTag::GetPrefixMask(depth);
+          const std::size_t slot = FindSlotFrom(ancestor, depth == startDepths[i] ? homeSlots[i] : GetHomeSlot(ancestor));
+          if (slot != InvalidSlot)
+          {
+            found = &Values[slot];
+            matched = QTag(ancestor);
+            break;
+          }
+        }
+        outValues[groupBegin + i] = found;
+        if (bWantMatched)
+        {
+          outMatched[groupBegin + i] = matched;
+        }
+      }
+    }
+  }
+
+  // func(const QTag&, V&) for every entry, in slot order
+  template<class Func>
+  void ForEach(Func&& func)
+  {
+    for (std::size_t slot = 0; slot < Keys.size(); ++slot)
+    {
+      if (Keys[slot] != BaseType(0))
+      {
+        func(QTag(Keys[slot]), Values[slot]);
+      }
+    }
+  }
+
+  template<class Func>
+  void ForEach(Func&& func) const
+  {
+    for (std::size_t slot = 0; slot < Keys.size(); ++slot)
+    {
+      if (Keys[slot] != BaseType(0))
+      {
+        func(QTag(Keys[slot]), std::as_const(Values[slot]));
+      }
+    }
+  }
+
+  // Sizes the table so num entries fit without growing
+  void Reserve(const std::size_t num)
+  {
+    std::size_t capacity = MinCapacity;
+    while (capacity * MaxLoadNum < num * MaxLoadDen)
+    {
+      capacity *= 2;
+    }
+    if (capacity > Keys.size())
+    {
+      Rehash(capacity);
+    }
+  }
+
+  // Removes every entry, keeps the allocation
+  void Reset()
+  {
+    std::fill(Keys.begin(), Keys.end(), BaseType(0));
+    std::fill(Values.begin(), Values.end(), V());
+    std::fill(std::begin(DepthCounts), std::end(DepthCounts), 0);
+    Count = 0;
+  }
+
+  std::size_t Num() const { return Count; }
+  bool IsEmpty() const { return Count == 0; }
+  std::size_t GetCapacity() const { return Keys.size(); }
+
+  std::size_t GetMemoryUsage() const
+  {
+    return sizeof(*this)
+      + Keys.capacity() * sizeof(BaseType)
+      + Values.capacity() * sizeof(V);
+  }
+
+private:
+  using BaseType = typename QTag::TagBaseType;
+
+  static constexpr std::size_t InvalidSlot = ~std::size_t(0);
+  static constexpr std::size_t MinCapacity = 16;
+  static constexpr std::size_t BatchSize = 16;
+  // Grow past 3/4 full, linear probing degrades quickly beyond that
+  static constexpr std::size_t MaxLoadNum = 3;
+  static constexpr std::size_t MaxLoadDen = 4;
+
+  std::size_t GetHomeSlot(const BaseType& raw) const
+  {
+    return (std::size_t)QTagUtil::HashRawValue(raw) & (Keys.size() - 1);
+  }
+
+  std::size_t FindSlot(const BaseType& raw) const
+  {
+    if (Count == 0 || raw == BaseType(0))
+    {
+      return InvalidSlot;
+    }
+    return FindSlotFrom(raw, GetHomeSlot(raw));
+  }
+
+  // The load limit guarantees an empty slot, so the probe always ends
+  std::size_t FindSlotFrom(const BaseType& raw, std::size_t slot) const
+  {
+    const std::size_t mask = Keys.size() - 1;
+    while (true)
+    {
+      const BaseType& key = Keys[slot];
+      if (key == raw)
+      {
+        return slot;
+      }
+      if (key == BaseType(0))
+      {
+        return InvalidSlot;
+      }
+      slot = (slot + 1) & mask;
+    }
+  }
+
+  V* FindOrAddSlot(const QTag& tag, bool& bOutAdded)
+  {
+    bOutAdded = false;
+    if (!tag.IsValid())
+    {
+      return nullptr;
+    }
+    if ((Count + 1) * MaxLoadDen > Keys.size() * MaxLoadNum)
+    {
+      Rehash(Keys.empty() ? MinCapacity : Keys.size() * 2);
+    }
+
+    const BaseType raw = tag.GetRaw();
+    const std::size_t mask = Keys.size() - 1;
+    std::size_t slot = GetHomeSlot(raw);
+    while (Keys[slot] != BaseType(0))
+    {
+      if (Keys[slot] == raw)
+      {
+        return &Values[slot];
+      }
+      slot = (slot + 1) & mask;
+    }
+
+    Keys[slot] = raw;
+    ++DepthCounts[tag.GetDepth()];
+    ++Count;
+    bOutAdded = true;
+    return &Values[slot];
+  }
+
+  // Backward shift deletion: pull later entries of the run into the hole when the hole lies
+  // between their home slot and where they sit now, so no probe sequence is ever broken
+  void EraseSlot(std::size_t hole)
+  {
+    const std::size_t mask = Keys.size() - 1;
+    std::size_t next = (hole + 1) & mask;
+    while (Keys[next] != BaseType(0))
+    {
+      const std::size_t home = GetHomeSlot(Keys[next]);
+      // Distance from home to next, wrapping, compared with distance from home to the hole
+      if (((next - home) & mask) >= ((next - hole) & mask))
+      {
+        Keys[hole] = Keys[next];
+        Values[hole] = std::move(Values[next]);
+        hole = next;
+      }
+      next = (next + 1) & mask;
+    }
+    Keys[hole] = BaseType(0);
+    Values[hole] = V();
+  }
+
+  void Rehash(const std::size_t newCapacity)
+  {
+    std::vector<BaseType> oldKeys(newCapacity, BaseType(0));
+    std::vector<V> oldValues(newCapacity);
+    Keys.swap(oldKeys);
+    Values.swap(oldValues);
+
+    const std::size_t mask = newCapacity - 1;
+    for (std::size_t oldSlot = 0; oldSlot < oldKeys.size(); ++oldSlot)
+    {
+      if (oldKeys[oldSlot] == BaseType(0))
+      {
+        continue;
+      }
+      std::size_t slot = GetHomeSlot(oldKeys[oldSlot]);
+      while (Keys[slot] != BaseType(0))
+      {
+        slot = (slot + 1) & mask;
+      }
+      Keys[slot] = oldKeys[oldSlot];
+      Values[slot] = std::move(oldValues[oldSlot]);
+    }
+  }
+
+  std::vector<BaseType> Keys;
+  std::vector<V> Values;
+  std::size_t Count = 0;
+  std::size_t DepthCounts[QTag::GetNumFields() + 1] = {};
+};
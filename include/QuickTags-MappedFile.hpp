@@ -0,0 +1,39 @@
+#pragma once
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+namespace QTagUtil
+{
+  // Read-only memory mapping of a whole file, unmapped on destruction
+  class MappedFile
+  {
+  public:
+    MappedFile() = default;
+    explicit MappedFile(const std::string& path) { Open(path); }
+    ~MappedFile() { Close(); }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+
+    // Returns false if the file couldn't be opened or mapped, an empty file opens successfully with no data
+    bool Open(const std::string& path);
+    void Close();
+
+    bool IsOpen() const { return bOpen; }
+    const char* GetData() const { return Data; }
+    std::size_t GetSize() const { return Size; }
+    std::string_view GetView() const { return std::string_view(Data, Size); }
+
+  private:
+    const char* Data = nullptr;
+    std::size_t Size = 0;
+    bool bOpen = false;
+#ifdef _WIN32
+    void* FileHandle = nullptr;
+    void* MappingHandle = nullptr;
+#endif
+  };
+}
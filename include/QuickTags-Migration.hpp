@@ -0,0 +1,589 @@
+#pragma once
+#include "QuickTags.hpp"
+#include "QuickTags-Loader.hpp"
+#include "QuickTags-Registry.hpp"
+#include "QuickTags-Simd.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <map>
+#include <span>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Migrating stored tags from one revision of the tag files to the next.
+//
+// EnumerateTags numbers siblings by sorted position, so any edit to the tag files can change the
+// packed values of unrelated tags. QuickTagRemap diffs an old and a new registry by name and
+// builds an old value -> new value table, RemapInPlace then rewrites tag arrays with no strings
+// involved. Names are matched in this order:
+//   - Redirects declared in the tag files. "redirect A.2 A.Two" moves A.2 and, unless they have
+//     redirects of their own, all of A.2's descendants ("A.2.1" becomes "A.Two.1"). Redirects
+//     chain, so files can keep the redirects from every earlier revision.
+//   - The same name in the new registry.
+//   - ERemovedTagPolicy, for tags with nowhere to go.
+//
+// Redirect lines contain a space, so the tag loaders already skip them and they can live in the
+// tag files alongside the tags:
+//   A.Two
+//   A.Two.1
+//   redirect A.2 A.Two
+//
+// The table is a hash table of 8-slot buckets, keys and values of a bucket sharing a cache line
+// for 32-bit tags. A lookup compares the whole bucket at once (with AVX2 for 32 and 64-bit base
+// types) rather than probing slot by slot, and RemapInPlace hashes and prefetches a group of tags
+// before resolving any of them. 8 and 16-bit base types use a dense table indexed by raw value.
+
+namespace QTagUtil
+{
+  struct TagRedirect
+  {
+    std::string From;
+    std::string To;
+  };
+
+  // Reads "redirect Old.Name New.Name" lines, ignoring everything else, so tag files can be passed
+  // as is. flags should match the ones the tags were loaded with, CaseInsensitive folds the names
+  // Returns false if a redirect line doesn't have exactly two names
+  bool ReadTagRedirects(std::istream& inStream, std::vector<TagRedirect>& outRedirects, ETagSetFlags flags=ETagSetFlags::None);
+  // Returns false if any file can't be opened or is malformed
+  bool ReadTagRedirectsFromFiles(const std::vector<std::string>& inPaths, std::vector<TagRedirect>& outRedirects, ETagSetFlags flags=ETagSetFlags::None);
+
+  // What happens to an old tag whose name (after redirects) isn't in the new registry
+  enum class ERemovedTagPolicy
+  {
+    Clear,          // Becomes the zero tag
+    NearestAncestor // Becomes its closest ancestor that still exists, the zero tag if none do
+  };
+
+  enum class ETagRemapKind : std::uint8_t
+  {
+    SameName,
+    Redirected,
+    Ancestor,
+    Cleared
+  };
+
+  struct TagRemapStats
+  {
+    std::size_t NumUnchanged = 0;   // Same name, same value
+    std::size_t NumMoved = 0;       // Same name, new value
+    std::size_t NumRedirected = 0;
+    std::size_t NumToAncestor = 0;
+    std::size_t NumCleared = 0;
+    std::vector<std::string> ClearedTags;
+  };
+
+  // outNewIndices[i] is the index into newNames that oldNames[i] becomes, or InvalidIndex if cleared
+  // Redirects apply in history order: later redirects for the same name replace earlier ones, and a
+  // redirect to a name drops earlier redirects away from it, so a rename that was undone is fine
+  // Returns false if the redirects left form a cycle, including a redirect into the tag's own subtree
+  bool MatchTagNames(std::span<const std::string_view> oldNames, std::span<const std::string_view> newNames, std::span<const TagRedirect> redirects,
+    ERemovedTagPolicy policy, std::vector<std::uint32_t>& outNewIndices, std::vector<ETagRemapKind>& outKinds);
+
+  namespace Migration
+  {
+    static constexpr std::uint32_t InvalidIndex = ~std::uint32_t(0);
+
+    namespace Internal
+    {
+      // Buckets are BucketSlots keys followed by their values
+      static constexpr std::size_t BucketSlots = 8;
+      static constexpr std::size_t BucketStride = BucketSlots * 2;
+      // Tags hashed and prefetched ahead of resolving them
+      static constexpr std::size_t GroupSize = 16;
+
+      static constexpr std::uint32_t FibonacciMul32 = 0x9E3779B1u;
+      static constexpr std::uint64_t FibonacciMul64 = 0x9E3779B97F4A7C15ull;
+
+      // Fibonacci hashing, the bucket is the top bits of the product
+      // A single multiply, which the AVX2 kernel can do for a whole group at once. Wide types have no
+      // vector path and go through HashRawValue
+      template<class T>
+      inline std::uint32_t HashBucketValue(const T& value)
+      {
+        if constexpr (sizeof(T) <= 4)
+        {
+          return (std::uint32_t)value * FibonacciMul32;
+        }
+        else if constexpr (sizeof(T) == 8)
+        {
+          return (std::uint32_t)(((std::uint64_t)value * FibonacciMul64) >> 32);
+        }
+        else
+        {
+          return (std::uint32_t)(HashRawValue(value) >> 32);
+        }
+      }
+
+      // bucketShift is 32 less log2 of the bucket count, there are always at least two buckets
+      template<class T>
+      inline std::size_t GetBucket(const T& value, const unsigned int bucketShift)
+      {
+        return HashBucketValue(value) >> bucketShift;
+      }
+
+      // Bit s set where keys[s] == value
+      // Unrolled by hand, GCC otherwise keeps the loop and its variable shifts
+      template<class T, std::size_t... Slot>
+      inline unsigned int MatchBucketScalar(const T* keys, const T& value, std::index_sequence<Slot...>)
+      {
+        return (((unsigned int)(keys[Slot] == value) << Slot) | ...);
+      }
+
+      template<class T>
+      inline unsigned int MatchBucketScalar(const T* keys, const T& value)
+      {
+        return MatchBucketScalar(keys, value, std::make_index_sequence<BucketSlots>());
+      }
+
+      // A hit gives the slot's value. A miss in a bucket with an empty slot means the value isn't in
+      // the table, the zero tag always "hits" an empty slot and gets its zero value
+      template<class T>
+      inline bool FindInBucketsScalar(const T* buckets, const std::size_t bucketMask, std::size_t bucket, T& ioValue)
+      {
+        while (true)
+        {
+          const T* const keys = buckets + bucket * BucketStride;
+          const unsigned int hits = MatchBucketScalar(keys, ioValue);
+          if (hits != 0)
+          {
+            ioValue = keys[BucketSlots + std::countr_zero(hits)];
+            return true;
+          }
+          if (MatchBucketScalar(keys, T(0)) != 0)
+          {
+            return false;
+          }
+          bucket = (bucket + 1) & bucketMask;
+        }
+      }
+
+      // Returns the number of values not found, which are left as they were
+      template<class QTag, class T>
+      inline std::size_t RemapBucketsScalar(QTag* tags, const std::size_t numTags, const T* buckets, const std::size_t bucketMask, const unsigned int bucketShift)
+      {
+        std::size_t numUnknown = 0;
+        std::size_t groupBuckets[GroupSize];
+        for (std::size_t groupBegin = 0; groupBegin < numTags; groupBegin += GroupSize)
+        {
+          const std::size_t groupSize = std::min(GroupSize, numTags - groupBegin);
+          for (std::size_t i = 0; i < groupSize; ++i)
+          {
+            groupBuckets[i] = GetBucket(tags[groupBegin + i].GetRaw(), bucketShift);
+            QTAG_PREFETCH(buckets + groupBuckets[i] * BucketStride);
+          }
+          for (std::size_t i = 0; i < groupSize; ++i)
+          {
+            T value = tags[groupBegin + i].GetRaw();
+            numUnknown += !FindInBucketsScalar(buckets, bucketMask, groupBuckets[i], value);
+            tags[groupBegin + i] = QTag(value);
+          }
+        }
+        return numUnknown;
+      }
+
+#if QTAG_SIMD_X86
+      // GetBucket for the 32 bytes of values at values
+      template<class T>
+      QTAG_TARGET("avx2") inline void GetBucketsAVX2(const T* values, const unsigned int bucketShift, std::uint32_t* outBuckets)
+      {
+        const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(values));
+        if constexpr (sizeof(T) == 4)
+        {
+          const __m256i hash = _mm256_mullo_epi32(v, _mm256_set1_epi32((int)FibonacciMul32));
+          _mm256_storeu_si256(reinterpret_cast<__m256i*>(outBuckets), _mm256_srl_epi32(hash, _mm_cvtsi32_si128((int)bucketShift)));
+        }
+        else
+        {
+          // No 64-bit multiply, only the top half of the product is needed:
+          // hi32(lo * mulLo) + lo * mulHi + hi * mulLo
+          const __m256i mulLo = _mm256_set1_epi64x((long long)(FibonacciMul64 & 0xFFFFFFFFu));
+          const __m256i mulHi = _mm256_set1_epi64x((long long)(FibonacciMul64 >> 32));
+          const __m256i lowProduct = _mm256_mul_epu32(v, mulLo);
+          const __m256i cross = _mm256_add_epi64(_mm256_mul_epu32(v, mulHi), _mm256_mul_epu32(_mm256_srli_epi64(v, 32), mulLo));
+          const __m256i hash = _mm256_add_epi64(_mm256_srli_epi64(lowProduct, 32), cross);
+          // Bring the low 32 bits of each lane to the top, then shift them down to the bucket
+          const __m256i buckets = _mm256_srl_epi64(_mm256_slli_epi64(hash, 32), _mm_cvtsi32_si128((int)bucketShift + 32));
+          // Gather the even 32-bit words into the low 128 bits
+          const __m256i packed = _mm256_permutevar8x32_epi32(buckets, _mm256_setr_epi32(0, 2, 4, 6, 1, 3, 5, 7));
+          _mm_storeu_si128(reinterpret_cast<__m128i*>(outBuckets), _mm256_castsi256_si128(packed));
+        }
+      }
+
+      // Buckets for the group starting at groupBegin, prefetched
+      template<class T>
+      QTAG_TARGET("avx2") inline void HashGroupAVX2(const T* values, const std::size_t numValues, const std::size_t groupBegin, const T* buckets, const unsigned int bucketShift, std::uint32_t* outBuckets)
+      {
+        constexpr std::size_t ValuesPerVector = 32 / sizeof(T);
+        const std::size_t groupSize = std::min(GroupSize, numValues - groupBegin);
+        if (groupSize == GroupSize)
+        {
+          for (std::size_t i = 0; i < GroupSize; i += ValuesPerVector)
+          {
+            GetBucketsAVX2(values + groupBegin + i, bucketShift, outBuckets + i);
+          }
+        }
+        else
+        {
+          for (std::size_t i = 0; i < groupSize; ++i)
+          {
+            outBuckets[i] = (std::uint32_t)GetBucket(values[groupBegin + i], bucketShift);
+          }
+        }
+        for (std::size_t i = 0; i < groupSize; ++i)
+        {
+          QTAG_PREFETCH(buckets + outBuckets[i] * BucketStride);
+        }
+      }
+
+      // Hashes groups with vector multiplies, then compares each tag against its whole bucket at once,
+      // one compare per 32-bit bucket and two per 64-bit bucket
+      template<class T>
+      QTAG_TARGET("avx2") inline std::size_t RemapBucketsAVX2Impl(T* values, const std::size_t numValues, const T* buckets, const std::size_t bucketMask, const unsigned int bucketShift)
+      {
+        static_assert(sizeof(T) == 4 || sizeof(T) == 8);
+        // Hashing and prefetching run a group ahead, so the lines are in flight for a whole group
+        std::size_t numUnknown = 0;
+        std::uint32_t groupBuckets[2][GroupSize];
+        if (numValues > 0)
+        {
+          HashGroupAVX2(values, numValues, 0, buckets, bucketShift, groupBuckets[0]);
+        }
+        for (std::size_t groupBegin = 0, g = 0; groupBegin < numValues; groupBegin += GroupSize, g ^= 1)
+        {
+          const std::size_t groupSize = std::min(GroupSize, numValues - groupBegin);
+          if (groupBegin + GroupSize < numValues)
+          {
+            HashGroupAVX2(values, numValues, groupBegin + GroupSize, buckets, bucketShift, groupBuckets[g ^ 1]);
+          }
+
+          for (std::size_t i = 0; i < groupSize; ++i)
+          {
+            T& value = values[groupBegin + i];
+            std::size_t bucket = groupBuckets[g][i];
+            while (true)
+            {
+              const T* const keys = buckets + bucket * BucketStride;
+              const __m256i* const ptr = reinterpret_cast<const __m256i*>(keys);
+              const __m256i zero = _mm256_setzero_si256();
+              __m256i k0;
+              __m256i k1;
+              unsigned int hits;
+              if constexpr (sizeof(T) == 4)
+              {
+                k0 = _mm256_loadu_si256(ptr);
+                hits = (unsigned int)_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(k0, _mm256_set1_epi32((int)value))));
+              }
+              else
+              {
+                k0 = _mm256_loadu_si256(ptr + 0);
+                k1 = _mm256_loadu_si256(ptr + 1);
+                const __m256i v = _mm256_set1_epi64x((long long)value);
+                hits = (unsigned int)_mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(k0, v)))
+                  | ((unsigned int)_mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(k1, v))) << 4);
+              }
+              if (hits != 0)
+              {
+                value = keys[BucketSlots + std::countr_zero(hits)];
+                break;
+              }
+
+              // Only a full bucket sends the probe on to the next one
+              bool bHasEmpty;
+              if constexpr (sizeof(T) == 4)
+              {
+                bHasEmpty = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(k0, zero))) != 0;
+              }
+              else
+              {
+                bHasEmpty = (_mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(k0, zero)))
+                  | _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(k1, zero)))) != 0;
+              }
+              if (bHasEmpty)
+              {
+                ++numUnknown;
+                break;
+              }
+              bucket = (bucket + 1) & bucketMask;
+            }
+          }
+        }
+        return numUnknown;
+      }
+
+      // QTag is a plain wrapper around its value (the registry relies on the same), so the kernel
+      // works on the values directly
+      template<class QTag, class T>
+      inline std::size_t RemapBucketsAVX2(QTag* tags, const std::size_t numTags, const T* buckets, const std::size_t bucketMask, const unsigned int bucketShift)
+      {
+        static_assert(sizeof(QTag) == sizeof(T) && std::is_standard_layout_v<QTag>);
+        return RemapBucketsAVX2Impl(reinterpret_cast<T*>(tags), numTags, buckets, bucketMask, bucketShift);
+      }
+#endif
+    }
+  }
+}
+
+template<class QTag>
+class QuickTagRemap
+{
+public:
+  using BaseType = typename QTag::TagBaseType;
+
+  // Tags loaded from the old and new tag files, as from LoadQuickTagsFromFile
+  // Returns false if the redirects left form a cycle (see MatchTagNames), the remap is left empty
+  bool Build(const std::map<QTag, std::string>& oldTags, const std::map<QTag, std::string>& newTags, std::span<const QTagUtil::TagRedirect> redirects={},
+    QTagUtil::ERemovedTagPolicy policy=QTagUtil::ERemovedTagPolicy::Clear, QTagUtil::TagRemapStats* outStats=nullptr)
+  {
+    std::vector<std::string_view> oldNames;
+    std::vector<QTag> oldValues;
+    for (const std::pair<const QTag, std::string>& tag : oldTags)
+    {
+      oldValues.push_back(tag.first);
+      oldNames.push_back(tag.second);
+    }
+    std::vector<std::string_view> newNames;
+    std::vector<QTag> newValues;
+    for (const std::pair<const QTag, std::string>& tag : newTags)
+    {
+      newValues.push_back(tag.first);
+      newNames.push_back(tag.second);
+    }
+    return BuildFromNames(oldNames, oldValues, newNames, newValues, redirects, policy, outStats);
+  }
+
+  // Both registries must match QTag's layout
+  bool Build(const QTagUtil::TagRegistry& oldRegistry, const QTagUtil::TagRegistry& newRegistry, std::span<const QTagUtil::TagRedirect> redirects={},
+    QTagUtil::ERemovedTagPolicy policy=QTagUtil::ERemovedTagPolicy::Clear, QTagUtil::TagRemapStats* outStats=nullptr)
+  {
+    if (!oldRegistry.MatchesLayout<QTag>() || !newRegistry.MatchesLayout<QTag>())
+    {
+      Reset();
+      return false;
+    }
+    std::vector<std::string> oldNameStore;
+    std::vector<std::string> newNameStore;
+    GetRegistryNames(oldRegistry, oldNameStore);
+    GetRegistryNames(newRegistry, newNameStore);
+    const std::vector<std::string_view> oldNames(oldNameStore.begin(), oldNameStore.end());
+    const std::vector<std::string_view> newNames(newNameStore.begin(), newNameStore.end());
+    return BuildFromNames(oldNames, oldRegistry.GetTags<QTag>(), newNames, newRegistry.GetTags<QTag>(), redirects, policy, outStats);
+  }
+
+  // New value for tag. Values that weren't in the old registry come back unchanged with
+  // bOutKnown false, the zero tag is known and stays zero
+  QTag Remap(const QTag tag, bool* bOutKnown=nullptr) const
+  {
+    BaseType raw = tag.GetRaw();
+    const bool bKnown = RemapValue(raw);
+    if (bOutKnown)
+    {
+      *bOutKnown = bKnown;
+    }
+    return QTag(raw);
+  }
+
+  // Rewrites every tag, returns the number of values that weren't in the old registry (left as they were)
+  std::size_t RemapInPlace(std::span<QTag> tags) const
+  {
+    if (NumTags == 0)
+    {
+      return tags.size() - (std::size_t)std::count(tags.begin(), tags.end(), QTag());
+    }
+    if constexpr (bDense)
+    {
+      std::size_t numUnknown = 0;
+      const std::uint32_t* const dense = Dense.data();
+      for (QTag& tag : tags)
+      {
+        const std::uint32_t entry = dense[(std::size_t)tag.GetRaw()];
+        tag = QTag(BaseType(entry));
+        numUnknown += entry >> 31;
+      }
+      return numUnknown;
+    }
+    else
+    {
+#if QTAG_SIMD_X86
+      if constexpr (std::is_integral_v<BaseType> && (sizeof(BaseType) == 4 || sizeof(BaseType) == 8))
+      {
+        if (QTagUtil::Simd::GetLevel() >= QTagUtil::Simd::ELevel::AVX2)
+        {
+          return QTagUtil::Migration::Internal::RemapBucketsAVX2(tags.data(), tags.size(), GetBuckets(), BucketMask, BucketShift);
+        }
+      }
+#endif
+      return QTagUtil::Migration::Internal::RemapBucketsScalar(tags.data(), tags.size(), GetBuckets(), BucketMask, BucketShift);
+    }
+  }
+
+  // Every old tag keeps its value, RemapInPlace would only count unknown values
+  bool IsIdentity() const { return bIdentity; }
+  std::size_t Num() const { return NumTags; }
+
+  void Reset()
+  {
+    Dense.clear();
+    Storage.clear();
+    BucketOffset = 0;
+    BucketMask = 0;
+    BucketShift = 31;
+    NumTags = 0;
+    bIdentity = true;
+  }
+
+  std::size_t GetMemoryUsage() const
+  {
+    return Dense.capacity() * sizeof(std::uint32_t) + Storage.capacity() * sizeof(BaseType);
+  }
+
+private:
+  // 8 and 16-bit values index a table of every possible value directly
+  static constexpr bool bDense = sizeof(BaseType) <= 2;
+  // Dense entries are the new value, with the top bit set for values not in the old registry
+  static constexpr std::uint32_t UnknownBit = 0x80000000u;
+  static constexpr std::size_t BucketSlots = QTagUtil::Migration::Internal::BucketSlots;
+  static constexpr std::size_t BucketStride = QTagUtil::Migration::Internal::BucketStride;
+
+  static void GetRegistryNames(const QTagUtil::TagRegistry& registry, std::vector<std::string>& outNames)
+  {
+    std::vector<char> buffer;
+    for (std::uint32_t idx = 0; idx < registry.Num(); ++idx)
+    {
+      buffer.resize(registry.GetNodes()[idx].NameLength + 1);
+      outNames.emplace_back(registry.GetName(idx, buffer));
+    }
+  }
+
+  bool BuildFromNames(std::span<const std::string_view> oldNames, std::span<const QTag> oldValues, std::span<const std::string_view> newNames, std::span<const QTag> newValues,
+    std::span<const QTagUtil::TagRedirect> redirects, QTagUtil::ERemovedTagPolicy policy, QTagUtil::TagRemapStats* outStats)
+  {
+    Reset();
+    std::vector<std::uint32_t> newIndices;
+    std::vector<QTagUtil::ETagRemapKind> kinds;
+    if (!QTagUtil::MatchTagNames(oldNames, newNames, redirects, policy, newIndices, kinds))
+    {
+      return false;
+    }
+
+    std::vector<BaseType> mappedValues(oldValues.size());
+    for (std::size_t i = 0; i < oldValues.size(); ++i)
+    {
+      mappedValues[i] = newIndices[i] == QTagUtil::Migration::InvalidIndex ? BaseType(0) : newValues[newIndices[i]].GetRaw();
+      bIdentity &= mappedValues[i] == oldValues[i].GetRaw();
+
+      if (outStats)
+      {
+        switch (kinds[i])
+        {
+        case QTagUtil::ETagRemapKind::SameName:
+          (mappedValues[i] == oldValues[i].GetRaw() ? outStats->NumUnchanged : outStats->NumMoved) += 1;
+          break;
+        case QTagUtil::ETagRemapKind::Redirected:
+          ++outStats->NumRedirected;
+          break;
+        case QTagUtil::ETagRemapKind::Ancestor:
+          ++outStats->NumToAncestor;
+          break;
+        case QTagUtil::ETagRemapKind::Cleared:
+          ++outStats->NumCleared;
+          outStats->ClearedTags.emplace_back(oldNames[i]);
+          break;
+        }
+      }
+    }
+    NumTags = oldValues.size();
+
+    if constexpr (bDense)
+    {
+      Dense.resize(std::size_t(1) << (sizeof(BaseType) * 8));
+      for (std::size_t value = 0; value < Dense.size(); ++value)
+      {
+        Dense[value] = (std::uint32_t)value | UnknownBit;
+      }
+      Dense[0] = 0;
+      for (std::size_t i = 0; i < oldValues.size(); ++i)
+      {
+        Dense[(std::size_t)oldValues[i].GetRaw()] = (std::uint32_t)mappedValues[i];
+      }
+    }
+    else
+    {
+      BuildBuckets(oldValues, mappedValues);
+    }
+    return true;
+  }
+
+  // At most half full, so full buckets are rare and a run of them always ends
+  void BuildBuckets(std::span<const QTag> oldValues, const std::vector<BaseType>& mappedValues)
+  {
+    std::size_t numBuckets = 2;
+    BucketShift = 31;
+    while (numBuckets * BucketSlots < oldValues.size() * 2)
+    {
+      numBuckets *= 2;
+      --BucketShift;
+    }
+    BucketMask = numBuckets - 1;
+
+    // Offset so bucket 0 starts a cache line, as QuickTagSortedSearch does for its tree
+    constexpr std::size_t ElementsPerLine = std::max<std::size_t>(1, 64 / sizeof(BaseType));
+    Storage.assign(numBuckets * BucketStride + ElementsPerLine, BaseType(0));
+    const std::size_t misalignment = (reinterpret_cast<std::uintptr_t>(Storage.data()) % 64) / sizeof(BaseType);
+    BucketOffset = misalignment == 0 ? 0 : ElementsPerLine - misalignment;
+
+    for (std::size_t i = 0; i < oldValues.size(); ++i)
+    {
+      const BaseType key = oldValues[i].GetRaw();
+      std::size_t bucket = QTagUtil::Migration::Internal::GetBucket(key, BucketShift);
+      while (true)
+      {
+        BaseType* const keys = GetBucketKeys(bucket);
+        BaseType* const slot = std::find(keys, keys + BucketSlots, BaseType(0));
+        if (slot != keys + BucketSlots)
+        {
+          *slot = key;
+          keys[BucketSlots + (slot - keys)] = mappedValues[i];
+          break;
+        }
+        bucket = (bucket + 1) & BucketMask;
+      }
+    }
+  }
+
+  const BaseType* GetBuckets() const { return Storage.data() + BucketOffset; }
+  BaseType* GetBucketKeys(const std::size_t bucket) { return Storage.data() + BucketOffset + bucket * BucketStride; }
+
+  bool RemapValue(BaseType& ioValue) const
+  {
+    if (NumTags == 0)
+    {
+      return ioValue == BaseType(0);
+    }
+    if constexpr (bDense)
+    {
+      const std::uint32_t entry = Dense[(std::size_t)ioValue];
+      ioValue = BaseType(entry);
+      return (entry & UnknownBit) == 0;
+    }
+    else
+    {
+      return QTagUtil::Migration::Internal::FindInBucketsScalar(GetBuckets(), BucketMask, QTagUtil::Migration::Internal::GetBucket(ioValue, BucketShift), ioValue);
+    }
+  }
+
+  std::vector<std::uint32_t> Dense;
+  std::vector<BaseType> Storage;
+  std::size_t BucketOffset = 0; // Bucket b's keys start at Storage[BucketOffset + b * BucketStride]
+  std::size_t BucketMask = 0;
+  unsigned int BucketShift = 31;
+  std::size_t NumTags = 0;
+  bool bIdentity = true;
+};
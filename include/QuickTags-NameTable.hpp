@@ -0,0 +1,280 @@
+#pragma once
+#include "QuickTags.hpp"
+#include "QuickTags-Loader.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Tag to name lookup without a heap node and full path string per tag.
+//
+// Each unique path segment ("A", "2", "1") is stored once in a contiguous pool, and each tag
+// stores its segment plus the index of its parent. Tags are held in a flat sorted array, so
+// a lookup is a binary search, and full names ("A.2.1") are rebuilt into a caller's buffer.
+template<class QTag>
+class QuickTagNameTable
+{
+public:
+  static constexpr std::uint32_t InvalidIndex = ~std::uint32_t(0);
+
+  // Build from trees that have been through TreeifyTags and EnumerateTags, siblings may be in any order
+  void Build(const std::list<QTagUtil::TagTreeNode>& tagTrees)
+  {
+    Tags.clear();
+    Entries.clear();
+    SegmentPool.clear();
+
+    std::unordered_map<std::string_view, std::uint32_t> segmentOffsets;
+    for (const QTagUtil::TagTreeNode& tree : tagTrees)
+    {
+      AddNode(tree, QTag(), 0, InvalidIndex, segmentOffsets);
+    }
+
+    // Pre-order walk of an enumerated tree is already in raw value order (parents before children,
+    // siblings ascending), only trees whose siblings aren't in TagAsInt order need sorting
+    if (!std::is_sorted(Tags.begin(), Tags.end()))
+    {
+      SortByTag();
+    }
+
+    Tags.shrink_to_fit();
+    Entries.shrink_to_fit();
+    SegmentPool.shrink_to_fit();
+  }
+
+  // Build from a FlatTagTree, which is already enumerated
+  void Build(const QTagUtil::FlatTagTree& tagTree)
+  {
+    Tags.clear();
+    Entries.clear();
+    SegmentPool.clear();
+
+    // Pre-order, so tags come out sorted as with the list version. Tree indices differ from table
+    // indices, so track the table index of each tree node for its children's Parent
+    const std::span<const QTagUtil::FlatTagNode> nodes = tagTree.GetNodes();
+    std::vector<std::uint32_t> tableIndices(nodes.size(), InvalidIndex);
+    std::unordered_map<std::string_view, std::uint32_t> segmentOffsets;
+    tagTree.VisitPreOrder([&](const QTagUtil::FlatTagNode& node)
+      {
+        const bool bRoot = node.Parent == QTagUtil::FlatTagNode::InvalidIndex;
+        const std::uint32_t parentIdx = bRoot ? InvalidIndex : tableIndices[node.Parent];
+        if (node.Depth >= QTag::GetNumFields() || (!bRoot && parentIdx == InvalidIndex))
+        {
+          return;
+        }
+
+        QTag tag = bRoot ? QTag() : Tags[parentIdx];
+        tag.SetField((unsigned char)node.Depth, (typename QTag::TagBaseType)node.TagAsInt);
+        tableIndices[tagTree.GetIndex(node)] = (std::uint32_t)Tags.size();
+        AddEntry(tag, tagTree.GetSegment(node), parentIdx, segmentOffsets);
+      });
+
+    Tags.shrink_to_fit();
+    Entries.shrink_to_fit();
+    SegmentPool.shrink_to_fit();
+  }
+
+  std::uint32_t FindIndex(const QTag tag) const
+  {
+    typename std::vector<QTag>::const_iterator it = std::lower_bound(Tags.begin(), Tags.end(), tag);
+    if (it == Tags.end() || *it != tag)
+    {
+      return InvalidIndex;
+    }
+    return std::uint32_t(it - Tags.begin());
+  }
+
+  bool Contains(const QTag tag) const
+  {
+    return FindIndex(tag) != InvalidIndex;
+  }
+
+  // Last segment of the tag's name, e.g. "1" for "A.2.1", empty if the tag isn't in the table
+  std::string_view GetSegment(const QTag tag) const
+  {
+    const std::uint32_t idx = FindIndex(tag);
+    return idx == InvalidIndex ? std::string_view() : GetSegmentByIndex(idx);
+  }
+
+  // Length of the full name, excluding null terminator, 0 if the tag isn't in the table
+  std::size_t GetNameLength(const QTag tag) const
+  {
+    const std::uint32_t idx = FindIndex(tag);
+    return idx == InvalidIndex ? 0 : Entries[idx].NameLength;
+  }
+
+  // Writes the full name, null terminated, into buffer and returns a view of it
+  // Returns an empty view if the tag isn't in the table or the buffer is too small
+  std::string_view GetName(const QTag tag, std::span<char> buffer) const
+  {
+    const std::uint32_t idx = FindIndex(tag);
+    if (idx == InvalidIndex || Entries[idx].NameLength + 1 > buffer.size())
+    {
+      return std::string_view();
+    }
+
+    // Name length is known up front, so write segments backwards from the leaf without a stack
+    const std::uint32_t nameLength = Entries[idx].NameLength;
+    buffer[nameLength] = '\0';
+    std::size_t writePos = nameLength;
+    for (std::uint32_t nodeIdx = idx; nodeIdx != InvalidIndex; nodeIdx = Entries[nodeIdx].Parent)
+    {
+      const std::string_view segment = GetSegmentByIndex(nodeIdx);
+      writePos -= segment.size();
+      std::copy(segment.begin(), segment.end(), buffer.begin() + writePos);
+      if (writePos > 0)
+      {
+        buffer[--writePos] = '.';
+      }
+    }
+    return std::string_view(buffer.data(), nameLength);
+  }
+
+  // Allocating convenience version of GetName
+  std::string GetName(const QTag tag) const
+  {
+    std::string name(GetNameLength(tag) + 1, '\0');
+    name.resize(GetName(tag, std::span<char>(name.data(), name.size())).size());
+    return name;
+  }
+
+  // All tags, sorted
+  std::span<const QTag> GetTags() const { return Tags; }
+  std::size_t Num() const { return Tags.size(); }
+
+  // Parent tag or an invalid tag for top-level tags/unknown tags
+  QTag GetParent(const QTag tag) const
+  {
+    const std::uint32_t idx = FindIndex(tag);
+    if (idx == InvalidIndex || Entries[idx].Parent == InvalidIndex)
+    {
+      return QTag();
+    }
+    return Tags[Entries[idx].Parent];
+  }
+
+  std::size_t GetMemoryUsage() const
+  {
+    return Tags.capacity() * sizeof(QTag) + Entries.capacity() * sizeof(Entry) + SegmentPool.capacity();
+  }
+
+private:
+  struct Entry
+  {
+    std::uint32_t Parent;
+    std::uint32_t SegmentOffset;
+    std::uint32_t SegmentLength;
+    std::uint32_t NameLength;
+  };
+
+  // Sorts Tags and Entries together, remapping each entry's Parent to its parent's new index
+  void SortByTag()
+  {
+    std::vector<std::uint32_t> order(Tags.size());
+    for (std::uint32_t i = 0; i < (std::uint32_t)order.size(); ++i)
+    {
+      order[i] = i;
+    }
+    std::stable_sort(order.begin(), order.end(), [this](const std::uint32_t a, const std::uint32_t b)
+      {
+        return Tags[a] < Tags[b];
+      });
+
+    std::vector<std::uint32_t> newIndices(order.size());
+    for (std::uint32_t i = 0; i < (std::uint32_t)order.size(); ++i)
+    {
+      newIndices[order[i]] = i;
+    }
+
+    std::vector<QTag> sortedTags;
+    std::vector<Entry> sortedEntries;
+    sortedTags.reserve(Tags.size());
+    sortedEntries.reserve(Entries.size());
+    for (const std::uint32_t oldIdx : order)
+    {
+      Entry entry = Entries[oldIdx];
+      entry.Parent = entry.Parent == InvalidIndex ? InvalidIndex : newIndices[entry.Parent];
+      sortedTags.push_back(Tags[oldIdx]);
+      sortedEntries.push_back(entry);
+    }
+    Tags.swap(sortedTags);
+    Entries.swap(sortedEntries);
+  }
+
+  std::string_view GetSegmentByIndex(const std::uint32_t idx) const
+  {
+    const Entry& entry = Entries[idx];
+    return std::string_view(SegmentPool.data() + entry.SegmentOffset, entry.SegmentLength);
+  }
+
+  void AddNode(const QTagUtil::TagTreeNode& node, QTag tag, const int depth, const std::uint32_t parentIdx, std::unordered_map<std::string_view, std::uint32_t>& segmentOffsets)
+  {
+    // Tree is deeper than the tag type, nothing below here can be represented
+    if (depth >= (int)QTag::GetNumFields())
+    {
+      return;
+    }
+
+    tag.SetField((unsigned char)depth, (typename QTag::TagBaseType)node.TagAsInt);
+
+    const std::uint32_t idx = (std::uint32_t)Tags.size();
+    AddEntry(tag, node.Tag, parentIdx, segmentOffsets);
+
+    for (const QTagUtil::TagTreeNode& subTag : node.SubTags)
+    {
+      AddNode(subTag, tag, depth + 1, idx, segmentOffsets);
+    }
+  }
+
+  // Keys view the tree's own strings, which outlive the build
+  void AddEntry(const QTag tag, const std::string_view segment, const std::uint32_t parentIdx, std::unordered_map<std::string_view, std::uint32_t>& segmentOffsets)
+  {
+    std::uint32_t segmentOffset;
+    typename std::unordered_map<std::string_view, std::uint32_t>::const_iterator it = segmentOffsets.find(segment);
+    if (it != segmentOffsets.end())
+    {
+      segmentOffset = it->second;
+    }
+    else
+    {
+      segmentOffset = (std::uint32_t)SegmentPool.size();
+      SegmentPool.append(segment);
+      segmentOffsets.emplace(segment, segmentOffset);
+    }
+
+    Entry entry;
+    entry.Parent = parentIdx;
+    entry.SegmentOffset = segmentOffset;
+    entry.SegmentLength = (std::uint32_t)segment.size();
+    entry.NameLength = entry.SegmentLength + (parentIdx == InvalidIndex ? 0 : Entries[parentIdx].NameLength + 1);
+
+    Tags.push_back(tag);
+    Entries.push_back(entry);
+  }
+
+  std::vector<QTag> Tags;
+  std::vector<Entry> Entries; // Parallel to Tags
+  std::string SegmentPool;
+};
+
+namespace QTagUtil
+{
+  // As LoadQuickTagsFromFile, but producing a QuickTagNameTable rather than a std::map<QTag, std::string>
+  template<class QTag>
+  void LoadQuickTagsFromFile(std::fstream& inFile, QuickTagNameTable<QTag>& outNameTable, std::vector<QTag>& outTags)
+  {
+    std::set<std::string> stringSet;
+    BuildTagStringSetFromFile(inFile, stringSet);
+
+    FlatTagTree tagTree;
+    tagTree.Build(stringSet);
+
+    outNameTable.Build(tagTree);
+    std::span<const QTag> tags = outNameTable.GetTags();
+    outTags.insert(outTags.end(), tags.begin(), tags.end());
+  }
+}
@@ -0,0 +1,368 @@
+#pragma once
+#include "QuickTags.hpp"
+#include "QuickTags-Batch.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <span>
+#include <utility>
+#include <vector>
+
+// Tag queries built as nested expressions, in the style of FGameplayTagQuery, then compiled into a
+// flat program so evaluating one is a couple of linear passes with no tree walking.
+//
+// Compiling turns every query tag into a test instruction, a (mask, value) pair where the mask is
+// the tag's prefix mask (or all bits for the exact variants), so a container tag passes when
+// (tag & mask) == value. Small containers test every tag without branching, larger ones are
+// searched with the tests sorted by value, so the search range only ever shrinks.
+//
+// Each expression becomes a node instruction, an op applied to a run of operand slots. Nodes come
+// out in post-order, so evaluation fills in every test result and then every node result in array
+// order, with no recursion. Identical tests and identical subexpressions are only emitted once.
+//
+// Matching follows QuickTagContainer: AnyTagsMatch({"A"}) passes for a container holding "A.1",
+// empty tag lists give False for Any and True for All/None, and invalid query tags never match.
+
+template<class QTag>
+struct QuickTagQueryExpr
+{
+  enum class EType : std::uint8_t
+  {
+    AnyTagsMatch,
+    AllTagsMatch,
+    NoTagsMatch,
+    AnyTagsExact,
+    AllTagsExact,
+    NoTagsExact,
+    AnyExprMatch,
+    AllExprMatch,
+    NoExprMatch,
+  };
+
+  EType Type;
+  std::vector<QTag> Tags;                 // Tag expressions
+  std::vector<QuickTagQueryExpr> SubExprs; // Expression expressions
+
+  static QuickTagQueryExpr AnyTagsMatch(std::vector<QTag> tags) { return { EType::AnyTagsMatch, std::move(tags), {} }; }
+  static QuickTagQueryExpr AllTagsMatch(std::vector<QTag> tags) { return { EType::AllTagsMatch, std::move(tags), {} }; }
+  static QuickTagQueryExpr NoTagsMatch(std::vector<QTag> tags) { return { EType::NoTagsMatch, std::move(tags), {} }; }
+  static QuickTagQueryExpr AnyTagsExact(std::vector<QTag> tags) { return { EType::AnyTagsExact, std::move(tags), {} }; }
+  static QuickTagQueryExpr AllTagsExact(std::vector<QTag> tags) { return { EType::AllTagsExact, std::move(tags), {} }; }
+  static QuickTagQueryExpr NoTagsExact(std::vector<QTag> tags) { return { EType::NoTagsExact, std::move(tags), {} }; }
+  static QuickTagQueryExpr AnyExprMatch(std::vector<QuickTagQueryExpr> exprs) { return { EType::AnyExprMatch, {}, std::move(exprs) }; }
+  static QuickTagQueryExpr AllExprMatch(std::vector<QuickTagQueryExpr> exprs) { return { EType::AllExprMatch, {}, std::move(exprs) }; }
+  static QuickTagQueryExpr NoExprMatch(std::vector<QuickTagQueryExpr> exprs) { return { EType::NoExprMatch, {}, std::move(exprs) }; }
+};
+
+template<class QTag>
+class QuickTagQuery
+{
+public:
+  using BaseType = typename QTag::TagBaseType;
+  using Expr = QuickTagQueryExpr<QTag>;
+
+  enum class EOp : std::uint8_t
+  {
+    Any,  // OR of operands, False with none
+    All,  // AND of operands, True with none
+    None, // NOR of operands, True with none
+  };
+
+  struct NodeInstruction
+  {
+    EOp Op;
+    std::uint32_t FirstOperand;
+    std::uint32_t NumOperands;
+  };
+
+  // Containers holding more tags than this are searched with lower_bound rather than scanned
+  static constexpr std::size_t LinearScanMaxTags = 16;
+
+  QuickTagQuery() = default;
+  explicit QuickTagQuery(const Expr& expr) { Compile(expr); }
+
+  void Compile(const Expr& expr)
+  {
+    Reset();
+
+    Compiler compiler{ *this, {}, {}, {} };
+    const std::uint32_t rootSlot = compiler.CompileExpr(expr);
+    const std::vector<std::pair<BaseType, BaseType>>& tests = compiler.Tests;
+
+    // Sort tests by value so evaluation can search a sorted container front to back, then turn the
+    // recorded test indices and tagged node indices into slots: tests first, then nodes
+    const std::uint32_t numTests = (std::uint32_t)tests.size();
+    std::vector<std::uint32_t> testOrder(numTests);
+    for (std::uint32_t t = 0; t < numTests; ++t)
+    {
+      testOrder[t] = t;
+    }
+    std::sort(testOrder.begin(), testOrder.end(), [&tests](const std::uint32_t a, const std::uint32_t b)
+      {
+        return tests[a].second < tests[b].second;
+      });
+    std::vector<std::uint32_t> testSlots(numTests);
+    for (std::uint32_t t = 0; t < numTests; ++t)
+    {
+      TestMasks.push_back(tests[testOrder[t]].first);
+      TestValues.push_back(tests[testOrder[t]].second);
+      testSlots[testOrder[t]] = t;
+    }
+
+    for (std::uint32_t& operand : Operands)
+    {
+      operand = ToSlot(operand, testSlots, numTests);
+    }
+
+    // A root that folded down to a single test still gets a node, IsEmpty checks for nodes
+    RootSlot = ToSlot(rootSlot, testSlots, numTests);
+    if (!(rootSlot & NodeBit))
+    {
+      Nodes.push_back({ EOp::Any, (std::uint32_t)Operands.size(), 1 });
+      Operands.push_back(RootSlot);
+      RootSlot = numTests + (std::uint32_t)Nodes.size() - 1;
+    }
+  }
+
+  void Reset()
+  {
+    TestMasks.clear();
+    TestValues.clear();
+    Nodes.clear();
+    Operands.clear();
+    RootSlot = 0;
+  }
+
+  bool IsEmpty() const { return Nodes.empty(); }
+
+  // tags must be sorted, as a QuickTagContainer is. An empty query returns False
+  bool Evaluate(std::span<const QTag> tags) const
+  {
+    if (IsEmpty())
+    {
+      return false;
+    }
+
+    // Programs are small, so keep the slot values on the stack when they fit
+    constexpr std::size_t StackSlots = 256;
+    const std::size_t numSlots = TestValues.size() + Nodes.size();
+    if (numSlots <= StackSlots)
+    {
+      std::uint8_t slotValues[StackSlots];
+      return Run(tags, slotValues);
+    }
+    std::vector<std::uint8_t> slotValues(numSlots);
+    return Run(tags, slotValues.data());
+  }
+
+  // Any container with contiguous sorted tags, e.g. QuickTagContainer or a sorted std::vector<QTag>
+  template<class Container>
+  bool Evaluate(const Container& container) const
+  {
+    return Evaluate(std::span<const QTag>(container.begin(), container.end()));
+  }
+
+  // Bit i of outBits is Evaluate(containers[i]), outBits must hold Batch::GetNumResultWords(containers.size()) words
+  template<class Container>
+  void EvaluateMany(std::span<const Container> containers, std::span<std::uint64_t> outBits) const
+  {
+    std::fill_n(outBits.data(), QTagUtil::Batch::GetNumResultWords(containers.size()), std::uint64_t(0));
+    if (IsEmpty())
+    {
+      return;
+    }
+
+    std::vector<std::uint8_t> slotValues(TestValues.size() + Nodes.size());
+    for (std::size_t i = 0; i < containers.size(); ++i)
+    {
+      const bool bResult = Run(std::span<const QTag>(containers[i].begin(), containers[i].end()), slotValues.data());
+      outBits[i / QTagUtil::Batch::BlockSize] |= std::uint64_t(bResult) << (i % QTagUtil::Batch::BlockSize);
+    }
+  }
+
+  // Test t passes when a tag has (tag & GetTestMasks()[t]) == GetTestValues()[t]
+  std::span<const BaseType> GetTestMasks() const { return TestMasks; }
+  std::span<const BaseType> GetTestValues() const { return TestValues; }
+  std::span<const NodeInstruction> GetNodes() const { return Nodes; }
+  // Operand slots index tests, then nodes (slot GetTestValues().size() + n is node n)
+  std::span<const std::uint32_t> GetOperands() const { return Operands; }
+
+private:
+  static constexpr std::uint32_t NodeBit = std::uint32_t(1) << 31;
+
+  static std::uint32_t ToSlot(const std::uint32_t operand, const std::vector<std::uint32_t>& testSlots, const std::uint32_t numTests)
+  {
+    return (operand & NodeBit) ? numTests + (operand & ~NodeBit) : testSlots[operand];
+  }
+
+  struct Compiler
+  {
+    QuickTagQuery& Query;
+    std::vector<std::pair<BaseType, BaseType>> Tests; // (mask, value) in the order first seen
+    std::map<std::pair<BaseType, BaseType>, std::uint32_t> TestIndices;
+    std::map<std::vector<std::uint32_t>, std::uint32_t> NodeIndices; // Keyed by op then operands
+
+    std::uint32_t AddTest(const BaseType mask, const BaseType value)
+    {
+      const std::pair<typename std::map<std::pair<BaseType, BaseType>, std::uint32_t>::iterator, bool> inserted =
+        TestIndices.try_emplace(std::make_pair(mask, value), (std::uint32_t)Tests.size());
+      if (inserted.second)
+      {
+        Tests.emplace_back(mask, value);
+      }
+      return inserted.first->second;
+    }
+
+    // Returns a test index or NodeBit | node index
+    std::uint32_t AddNode(const EOp op, std::vector<std::uint32_t>& operands)
+    {
+      // Ops don't care about order or repeats, so sort for a canonical key
+      std::sort(operands.begin(), operands.end());
+      operands.erase(std::unique(operands.begin(), operands.end()), operands.end());
+      if (operands.size() == 1 && op != EOp::None)
+      {
+        return operands[0];
+      }
+
+      std::vector<std::uint32_t> key;
+      key.reserve(operands.size() + 1);
+      key.push_back((std::uint32_t)op);
+      key.insert(key.end(), operands.begin(), operands.end());
+
+      const std::pair<typename std::map<std::vector<std::uint32_t>, std::uint32_t>::iterator, bool> inserted =
+        NodeIndices.try_emplace(std::move(key), (std::uint32_t)Query.Nodes.size());
+      if (inserted.second)
+      {
+        Query.Nodes.push_back({ op, (std::uint32_t)Query.Operands.size(), (std::uint32_t)operands.size() });
+        Query.Operands.insert(Query.Operands.end(), operands.begin(), operands.end());
+      }
+      return NodeBit | inserted.first->second;
+    }
+
+    std::uint32_t CompileExpr(const Expr& expr)
+    {
+      using EType = typename Expr::EType;
+
+      std::vector<std::uint32_t> operands;
+      EOp op;
+      switch (expr.Type)
+      {
+      case EType::AnyTagsMatch:
+      case EType::AllTagsMatch:
+      case EType::NoTagsMatch:
+      case EType::AnyTagsExact:
+      case EType::AllTagsExact:
+      case EType::NoTagsExact:
+      {
+        const bool bExact = expr.Type == EType::AnyTagsExact || expr.Type == EType::AllTagsExact || expr.Type == EType::NoTagsExact;
+        op = (expr.Type == EType::AnyTagsMatch || expr.Type == EType::AnyTagsExact) ? EOp::Any
+          : (expr.Type == EType::AllTagsMatch || expr.Type == EType::AllTagsExact) ? EOp::All
+          : EOp::None;
+
+        bool bHasInvalid = false;
+        for (const QTag& tag : expr.Tags)
+        {
+          if (!tag.IsValid())
+          {
+            bHasInvalid = true;
+            continue;
+          }
+          const BaseType mask = bExact ? BaseType(~BaseType(0)) : QTag::GetPrefixMask(tag.GetDepth());
+          operands.push_back(AddTest(mask, tag.GetRaw()));
+        }
+
+        // An invalid tag never matches, so it drops out of Any/None but makes All always False
+        if (bHasInvalid && op == EOp::All)
+        {
+          operands.clear();
+          op = EOp::Any;
+        }
+        break;
+      }
+      case EType::AnyExprMatch:
+      case EType::AllExprMatch:
+      case EType::NoExprMatch:
+      default:
+        op = expr.Type == EType::AnyExprMatch ? EOp::Any : expr.Type == EType::AllExprMatch ? EOp::All : EOp::None;
+        for (const Expr& subExpr : expr.SubExprs)
+        {
+          operands.push_back(CompileExpr(subExpr));
+        }
+        break;
+      }
+      return AddNode(op, operands);
+    }
+  };
+
+  bool Run(std::span<const QTag> tags, std::uint8_t* slotValues) const
+  {
+    const QTag* const tagsBegin = tags.data();
+    const QTag* const tagsEnd = tags.data() + tags.size();
+    const std::size_t numTests = TestValues.size();
+
+    const BaseType* const masks = TestMasks.data();
+    const BaseType* const values = TestValues.data();
+    if (tags.size() <= LinearScanMaxTags)
+    {
+      // Containers are usually a handful of tags, check each test against all of them without branching
+      for (std::size_t t = 0; t < numTests; ++t)
+      {
+        const BaseType mask = masks[t];
+        const BaseType value = values[t];
+        bool bPass = false;
+        for (const QTag* tag = tagsBegin; tag != tagsEnd; ++tag)
+        {
+          bPass |= BaseType(tag->GetRaw() & mask) == value;
+        }
+        slotValues[t] = std::uint8_t(bPass);
+      }
+    }
+    else
+    {
+      // A tag's descendants sort directly after it, so the first tag >= the test value is the only
+      // candidate, and with tests in value order it only moves forwards
+      const QTag* candidate = tagsBegin;
+      for (std::size_t t = 0; t < numTests; ++t)
+      {
+        candidate = std::lower_bound(candidate, tagsEnd, QTag(values[t]));
+        slotValues[t] = std::uint8_t(candidate != tagsEnd && BaseType(candidate->GetRaw() & masks[t]) == values[t]);
+      }
+    }
+
+    for (std::size_t n = 0; n < Nodes.size(); ++n)
+    {
+      const NodeInstruction& node = Nodes[n];
+      const std::uint32_t* operand = Operands.data() + node.FirstOperand;
+      const std::uint32_t* const operandEnd = operand + node.NumOperands;
+      std::uint8_t result;
+      if (node.Op == EOp::All)
+      {
+        result = 1;
+        for (; operand != operandEnd; ++operand)
+        {
+          result &= slotValues[*operand];
+        }
+      }
+      else
+      {
+        result = 0;
+        for (; operand != operandEnd; ++operand)
+        {
+          result |= slotValues[*operand];
+        }
+        result ^= std::uint8_t(node.Op == EOp::None);
+      }
+      slotValues[numTests + n] = result;
+    }
+    return slotValues[RootSlot] != 0;
+  }
+
+  // Tests as two parallel arrays, sorted by value
+  std::vector<BaseType> TestMasks;
+  std::vector<BaseType> TestValues;
+  std::vector<NodeInstruction> Nodes;
+  std::vector<std::uint32_t> Operands;
+  std::uint32_t RootSlot = 0;
+};
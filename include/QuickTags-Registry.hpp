@@ -0,0 +1,141 @@
+#pragma once
+#include "QuickTags.hpp"
+#include "QuickTags-Loader.hpp"
+#include "QuickTags-MappedFile.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+// Precompiled binary tag registry.
+//
+// Holds everything the text pipeline (BuildTagStringSetFromFile -> TreeifyTags -> EnumerateTags
+// -> GetEachTagAsQTag) produces: the field bit layout, the sorted packed tag values, the tree
+// structure and an interned segment name pool. Loading is a single read-only mmap plus a check of
+// the header and one pass over the nodes, the tag array can be used in place as a
+// span<const QTag>, and processes mapping the same file share its pages.
+//
+// The header records a checksum of the source tag files, so LoadOrBuildTagRegistry can tell when
+// a cached registry is stale and rebuild it.
+//
+// All values are stored in the host's byte order, sections are 8-byte aligned.
+
+namespace QTagUtil
+{
+  static constexpr std::uint32_t TagRegistryVersion = 1;
+
+  struct TagRegistryHeader
+  {
+    char Magic[4];              // "QTRG"
+    std::uint32_t Version;
+    std::uint64_t SourceChecksum;
+    std::uint32_t Flags;        // ETagSetFlags used when loading the source files
+    std::uint32_t BaseTypeBytes;
+    std::uint32_t NumFields;
+    std::uint32_t NumTags;
+    std::uint64_t FieldBitsOffset;  // NumFields x uint8
+    std::uint64_t TagsOffset;       // NumTags x BaseTypeBytes, sorted packed values
+    std::uint64_t NodesOffset;      // NumTags x TagRegistryNode, parallel to the tags
+    std::uint64_t StringPoolOffset;
+    std::uint64_t StringPoolSize;
+    std::uint64_t FileSize;
+  };
+
+  struct TagRegistryNode
+  {
+    static constexpr std::uint32_t InvalidIndex = ~std::uint32_t(0);
+
+    std::uint32_t Parent;
+    std::uint32_t FirstChild;
+    std::uint32_t NextSibling;
+    std::uint32_t SegmentOffset;
+    std::uint32_t SegmentLength;
+    std::uint32_t NameLength; // Length of the full "A.2.1" name
+  };
+
+  // Checksum over the contents of the given files, in order, returns false if any can't be read
+  bool ComputeTagFilesChecksum(const std::vector<std::string>& inPaths, std::uint64_t& outChecksum);
+
+  // Writes a registry for already enumerated trees, using layoutFieldBits if given (fails if the
+  // trees don't fit it), otherwise the smallest layout that fits them
+  // The file is written next to outPath and then renamed over it, so readers never see a partial file
+  bool WriteTagRegistry(const std::string& outPath, const std::list<TagTreeNode>& inTagTrees, std::uint64_t sourceChecksum, ETagSetFlags flags=ETagSetFlags::None, std::span<const std::uint32_t> layoutFieldBits={});
+
+  class TagRegistry
+  {
+  public:
+    bool Open(const std::string& path);
+    void Close();
+    bool IsOpen() const { return Header != nullptr; }
+
+    std::uint64_t GetSourceChecksum() const { return Header->SourceChecksum; }
+    ETagSetFlags GetFlags() const { return (ETagSetFlags)Header->Flags; }
+    EQTagIntBase GetIntBase() const;
+    std::span<const std::uint8_t> GetFieldBits() const;
+    std::uint32_t Num() const { return Header->NumTags; }
+
+    std::span<const TagRegistryNode> GetNodes() const;
+    std::string_view GetSegment(const std::uint32_t idx) const;
+    // Writes the full name of the tag at idx into buffer (null terminated), empty view if it doesn't fit
+    std::string_view GetName(const std::uint32_t idx, std::span<char> buffer) const;
+
+    // Raw packed value of the tag at idx, widened to 64 bits
+    std::uint64_t GetRawValue(const std::uint32_t idx) const;
+
+    // True if QTag's base type and fields are exactly the registry's layout
+    template<class QTag>
+    bool MatchesLayout() const
+    {
+      const std::span<const std::uint8_t> fieldBits = GetFieldBits();
+      if (!IsOpen() || sizeof(typename QTag::TagBaseType) != Header->BaseTypeBytes || QTag::GetNumFields() != fieldBits.size())
+      {
+        return false;
+      }
+      for (std::size_t f = 0; f < fieldBits.size(); ++f)
+      {
+        if (QTag::GetFieldBitWidth((unsigned char)f) != fieldBits[f])
+        {
+          return false;
+        }
+      }
+      return true;
+    }
+
+    // Sorted tags, used in place from the mapping, empty if QTag doesn't match the layout
+    template<class QTag>
+    std::span<const QTag> GetTags() const
+    {
+      static_assert(sizeof(QTag) == sizeof(typename QTag::TagBaseType) && std::is_standard_layout_v<QTag>);
+      if (!MatchesLayout<QTag>())
+      {
+        return {};
+      }
+      return std::span<const QTag>(reinterpret_cast<const QTag*>(File.GetData() + Header->TagsOffset), Header->NumTags);
+    }
+
+    // Index of tag in the registry, or TagRegistryNode::InvalidIndex
+    template<class QTag>
+    std::uint32_t FindIndex(const QTag tag) const
+    {
+      const std::span<const QTag> tags = GetTags<QTag>();
+      const QTag* it = std::lower_bound(tags.data(), tags.data() + tags.size(), tag);
+      if (it == tags.data() + tags.size() || *it != tag)
+      {
+        return TagRegistryNode::InvalidIndex;
+      }
+      return std::uint32_t(it - tags.data());
+    }
+
+  private:
+    MappedFile File;
+    const TagRegistryHeader* Header = nullptr;
+  };
+
+  // Opens registryPath if it was built from exactly these tag files with these flags, otherwise
+  // rebuilds it from the tag files (through the mapped file loader) and opens the result
+  bool LoadOrBuildTagRegistry(const std::string& registryPath, const std::vector<std::string>& tagFiles, TagRegistry& outRegistry, ETagSetFlags flags=ETagSetFlags::None);
+}
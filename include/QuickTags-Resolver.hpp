@@ -0,0 +1,309 @@
+#pragma once
+#include "QuickTags.hpp"
+#include "QuickTags-Loader.hpp"
+#include "QuickTags-FlatTree.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Tag name to QTag resolution, the reverse of QuickTagNameTable.
+//
+// Every tree node is a slot in one open-addressed hash table keyed by (parent node, segment), so
+// resolving "A.2.1" is one probe per '.'-separated segment, hashing and comparing straight from the
+// caller's string_view. Built with ETagSetFlags::CaseInsensitive, segments are stored upper case
+// and the input is folded a character at a time during the walk, never copied.
+
+template<class QTag>
+class QuickTagResolver
+{
+public:
+  static constexpr std::uint32_t InvalidIndex = ~std::uint32_t(0);
+
+  // Build from trees that have been through TreeifyTags and EnumerateTags
+  void Build(const std::list<QTagUtil::TagTreeNode>& tagTrees, QTagUtil::ETagSetFlags flags=QTagUtil::ETagSetFlags::None)
+  {
+    Reset(flags);
+    for (const QTagUtil::TagTreeNode& tree : tagTrees)
+    {
+      AddNode(tree, QTag(), 0, InvalidIndex);
+    }
+    FinishBuild();
+  }
+
+  // Build from a FlatTagTree, which is already enumerated
+  void Build(const QTagUtil::FlatTagTree& tagTree, QTagUtil::ETagSetFlags flags=QTagUtil::ETagSetFlags::None)
+  {
+    Reset(flags);
+
+    // Tree indices differ from ours where nodes are skipped, so track ours for each tree node
+    const std::span<const QTagUtil::FlatTagNode> nodes = tagTree.GetNodes();
+    std::vector<std::uint32_t> nodeIndices(nodes.size(), InvalidIndex);
+    tagTree.VisitPreOrder([&](const QTagUtil::FlatTagNode& node)
+      {
+        const bool bRoot = node.Parent == QTagUtil::FlatTagNode::InvalidIndex;
+        const std::uint32_t parentIdx = bRoot ? InvalidIndex : nodeIndices[node.Parent];
+        if (node.Depth >= QTag::GetNumFields() || (!bRoot && parentIdx == InvalidIndex))
+        {
+          return;
+        }
+
+        QTag tag = bRoot ? QTag() : Nodes[parentIdx].Tag;
+        tag.SetField((unsigned char)node.Depth, (typename QTag::TagBaseType)node.TagAsInt);
+        nodeIndices[tagTree.GetIndex(node)] = AddEntry(tag, tagTree.GetSegment(node), parentIdx);
+      });
+    FinishBuild();
+  }
+
+  // Tag for a full name such as "A.2.1", or an invalid (zero) tag if the name isn't known
+  QTag Resolve(const std::string_view name) const
+  {
+    const std::uint32_t idx = Walk(name, 0, InvalidIndex);
+    return idx == InvalidIndex ? QTag() : Nodes[idx].Tag;
+  }
+
+  bool Contains(const std::string_view name) const
+  {
+    return Walk(name, 0, InvalidIndex) != InvalidIndex;
+  }
+
+  // Resolves names[i] into outTags[i], outTags must be at least as long as names
+  // Unknown names give an invalid tag. Returns the number of names that resolved
+  // Names sharing leading segments with the one before (as sorted config and message dumps tend
+  // to) resume the walk from the shared parent rather than the root
+  std::size_t ResolveMany(std::span<const std::string_view> names, std::span<QTag> outTags) const
+  {
+    std::size_t numResolved = 0;
+    std::string_view prevName;
+    std::uint32_t prevIdx = InvalidIndex;
+    for (std::size_t i = 0; i < names.size(); ++i)
+    {
+      const std::string_view name = names[i];
+
+      // Longest run of whole segments the two names share, then step back up from the previous
+      // node by however many segments it had past that
+      std::size_t sharedEnd = 0;
+      std::uint32_t resumeIdx = InvalidIndex;
+      if (prevIdx != InvalidIndex)
+      {
+        const std::size_t maxShared = std::min(name.size(), prevName.size());
+        std::size_t lastDot = std::string_view::npos;
+        for (std::size_t c = 0; c < maxShared && name[c] == prevName[c]; ++c)
+        {
+          if (name[c] == '.')
+          {
+            lastDot = c;
+          }
+        }
+        if (lastDot != std::string_view::npos)
+        {
+          sharedEnd = lastDot + 1;
+          resumeIdx = prevIdx;
+          for (std::size_t c = sharedEnd; c < prevName.size(); ++c)
+          {
+            if (prevName[c] == '.')
+            {
+              resumeIdx = Nodes[resumeIdx].Parent;
+            }
+          }
+          resumeIdx = Nodes[resumeIdx].Parent;
+        }
+      }
+
+      const std::uint32_t idx = Walk(name, sharedEnd, resumeIdx);
+      outTags[i] = idx == InvalidIndex ? QTag() : Nodes[idx].Tag;
+      numResolved += idx != InvalidIndex;
+
+      // Only a name that resolved has a node to resume from
+      prevName = name;
+      prevIdx = idx;
+    }
+    return numResolved;
+  }
+
+  std::size_t Num() const { return Nodes.size(); }
+  bool IsCaseInsensitive() const { return bCaseInsensitive; }
+
+  std::size_t GetMemoryUsage() const
+  {
+    return Nodes.capacity() * sizeof(Node) + Slots.capacity() * sizeof(Slot) + SegmentPool.capacity();
+  }
+
+private:
+  struct Node
+  {
+    QTag Tag;
+    std::uint32_t Parent;
+    std::uint32_t SegmentOffset;
+    std::uint32_t SegmentLength;
+  };
+
+  // High half of the hash kept alongside the index (the low half picks the slot), so most
+  // mismatched probes never touch the node or the pool
+  struct Slot
+  {
+    std::uint32_t Hash;
+    std::uint32_t NodeIdx;
+  };
+
+  static constexpr char FoldCase(const char c)
+  {
+    // Basic ascii only, as BuildTagStringSetFromFile's toupper
+    return (c >= 'a' && c <= 'z') ? char(c - ('a' - 'A')) : c;
+  }
+
+  // FNV-1a over the segment, seeded with the parent so equal segments under different parents differ
+  static std::uint64_t HashSegment(const std::string_view segment, const std::uint32_t parentIdx, const bool bFold)
+  {
+    std::uint64_t hash = 14695981039346656037ull ^ ((std::uint64_t(parentIdx) + 1) * 0x9E3779B97F4A7C15ull);
+    for (const char c : segment)
+    {
+      hash ^= (unsigned char)(bFold ? FoldCase(c) : c);
+      hash *= 1099511628211ull;
+    }
+    hash ^= hash >> 33;
+    return hash;
+  }
+
+  // Resolves name[start, end) segment by segment below parentIdx, InvalidIndex if any segment misses
+  std::uint32_t Walk(const std::string_view name, std::size_t start, std::uint32_t parentIdx) const
+  {
+    if (Slots.empty() || start >= name.size())
+    {
+      return InvalidIndex;
+    }
+
+    std::uint32_t nodeIdx = InvalidIndex;
+    while (true)
+    {
+      std::size_t dot = name.find('.', start);
+      if (dot == std::string_view::npos)
+      {
+        dot = name.size();
+      }
+      nodeIdx = FindChild(parentIdx, name.substr(start, dot - start));
+      if (nodeIdx == InvalidIndex || dot == name.size())
+      {
+        return nodeIdx;
+      }
+      parentIdx = nodeIdx;
+      start = dot + 1;
+    }
+  }
+
+  std::uint32_t FindChild(const std::uint32_t parentIdx, const std::string_view segment) const
+  {
+    const std::uint64_t hash = HashSegment(segment, parentIdx, bCaseInsensitive);
+    const std::uint32_t shortHash = std::uint32_t(hash >> 32);
+    for (std::size_t slotIdx = std::size_t(hash) & SlotMask; ; slotIdx = (slotIdx + 1) & SlotMask)
+    {
+      const Slot& slot = Slots[slotIdx];
+      if (slot.NodeIdx == InvalidIndex)
+      {
+        return InvalidIndex;
+      }
+      if (slot.Hash == shortHash && IsSameSegment(Nodes[slot.NodeIdx], parentIdx, segment))
+      {
+        return slot.NodeIdx;
+      }
+    }
+  }
+
+  bool IsSameSegment(const Node& node, const std::uint32_t parentIdx, const std::string_view segment) const
+  {
+    if (node.Parent != parentIdx || node.SegmentLength != segment.size())
+    {
+      return false;
+    }
+    const char* const stored = SegmentPool.data() + node.SegmentOffset;
+    for (std::size_t c = 0; c < segment.size(); ++c)
+    {
+      // Stored segments are already folded
+      if (stored[c] != (bCaseInsensitive ? FoldCase(segment[c]) : segment[c]))
+      {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  void Reset(const QTagUtil::ETagSetFlags flags)
+  {
+    bCaseInsensitive = (unsigned int)flags & (unsigned int)QTagUtil::ETagSetFlags::CaseInsensitive;
+    Nodes.clear();
+    Slots.clear();
+    SegmentPool.clear();
+    SlotMask = 0;
+  }
+
+  void AddNode(const QTagUtil::TagTreeNode& node, QTag tag, const int depth, const std::uint32_t parentIdx)
+  {
+    // Tree is deeper than the tag type, nothing below here can be represented
+    if (depth >= (int)QTag::GetNumFields())
+    {
+      return;
+    }
+
+    tag.SetField((unsigned char)depth, (typename QTag::TagBaseType)node.TagAsInt);
+    const std::uint32_t idx = AddEntry(tag, node.Tag, parentIdx);
+    for (const QTagUtil::TagTreeNode& subTag : node.SubTags)
+    {
+      AddNode(subTag, tag, depth + 1, idx);
+    }
+  }
+
+  std::uint32_t AddEntry(const QTag tag, const std::string_view segment, const std::uint32_t parentIdx)
+  {
+    Node node;
+    node.Tag = tag;
+    node.Parent = parentIdx;
+    node.SegmentOffset = (std::uint32_t)SegmentPool.size();
+    node.SegmentLength = (std::uint32_t)segment.size();
+    for (const char c : segment)
+    {
+      SegmentPool.push_back(bCaseInsensitive ? FoldCase(c) : c);
+    }
+    Nodes.push_back(node);
+    return std::uint32_t(Nodes.size() - 1);
+  }
+
+  // Table is filled once every node is in, at no more than half load
+  void FinishBuild()
+  {
+    if (Nodes.empty())
+    {
+      return;
+    }
+
+    const std::size_t numSlots = std::bit_ceil(Nodes.size() * 2);
+    SlotMask = numSlots - 1;
+    Slots.assign(numSlots, Slot{ 0, InvalidIndex });
+    for (std::uint32_t idx = 0; idx < (std::uint32_t)Nodes.size(); ++idx)
+    {
+      const Node& node = Nodes[idx];
+      const std::string_view segment(SegmentPool.data() + node.SegmentOffset, node.SegmentLength);
+      const std::uint64_t hash = HashSegment(segment, node.Parent, false);
+      std::size_t slotIdx = std::size_t(hash) & SlotMask;
+      while (Slots[slotIdx].NodeIdx != InvalidIndex)
+      {
+        slotIdx = (slotIdx + 1) & SlotMask;
+      }
+      Slots[slotIdx] = Slot{ std::uint32_t(hash >> 32), idx };
+    }
+
+    Nodes.shrink_to_fit();
+    SegmentPool.shrink_to_fit();
+  }
+
+  std::vector<Node> Nodes;
+  std::vector<Slot> Slots;
+  std::string SegmentPool;
+  std::size_t SlotMask = 0;
+  bool bCaseInsensitive = false;
+};
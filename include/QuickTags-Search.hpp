@@ -0,0 +1,204 @@
+#pragma once
+#include "QuickTags.hpp"
+#include "QuickTags-Simd.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+// Search over a large sorted tag array, finding the run of tags each query matches.
+//
+// A tag's descendants sort directly after it, so the tags matching a query are the index range
+// [lower_bound(query), upper_bound(GetDescendantRange().High)), two searches and no Matches scan.
+//
+// The searches run over a copy of the values in Eytzinger (breadth-first binary tree) order: the
+// root is at 1 and node k's children are at 2k and 2k+1. The descent is branch-free, and the
+// nodes four or so levels down are contiguous, so one prefetch per step pulls in a whole cache
+// line of future candidates. FindRanges walks a group of queries down the tree in lockstep, so
+// their cache misses overlap instead of being paid one after another.
+
+template<class QTag>
+class QuickTagSortedSearch
+{
+public:
+  using BaseType = typename QTag::TagBaseType;
+
+  // Indices into the sorted array the search was built from, [Begin, End)
+  struct Range
+  {
+    std::uint32_t Begin;
+    std::uint32_t End;
+
+    std::uint32_t Num() const { return End - Begin; }
+    bool IsEmpty() const { return Begin == End; }
+  };
+
+  // Queries per lockstep group in FindRanges
+  static constexpr std::size_t GroupSize = 8;
+
+  // sortedTags must be sorted (duplicates are fine), the search keeps its own copy of the values
+  void Build(std::span<const QTag> sortedTags)
+  {
+    NumTags = sortedTags.size();
+
+    // Offset the tree so node 1 starts a cache line, then each node's 64 / sizeof(BaseType)
+    // descendants a few levels down share a line
+    constexpr std::size_t ElementsPerLine = std::max<std::size_t>(1, 64 / sizeof(BaseType));
+    Storage.assign(NumTags + 1 + ElementsPerLine, BaseType(0));
+    const std::size_t misalignment = (reinterpret_cast<std::uintptr_t>(Storage.data() + 1) % 64) / sizeof(BaseType);
+    TreeOffset = misalignment == 0 ? 0 : ElementsPerLine - misalignment;
+    BaseType* const tree = Storage.data() + TreeOffset;
+
+    SortedIndices.assign(NumTags + 1, 0);
+    SortedIndices[0] = (std::uint32_t)NumTags; // Descents that run off the right end
+    FillInOrder(sortedTags, tree, 1, 0);
+
+    NumLevels = 0;
+    for (std::size_t n = NumTags; n > 0; n >>= 1)
+    {
+      ++NumLevels;
+    }
+  }
+
+  std::size_t Num() const { return NumTags; }
+
+  // Index of the first tag with a raw value >= value, Num() if there isn't one
+  std::uint32_t LowerBound(const BaseType value) const
+  {
+    const BaseType* const tree = GetTree();
+    std::size_t k = 1;
+    while (k <= NumTags)
+    {
+      Prefetch(tree, k, NumTags);
+      k = 2 * k + std::size_t(tree[k] < value);
+    }
+    return SortedIndices[ResolveDescent(k)];
+  }
+
+  // Index of the first tag with a raw value > value, Num() if there isn't one
+  std::uint32_t UpperBound(const BaseType value) const
+  {
+    const BaseType* const tree = GetTree();
+    std::size_t k = 1;
+    while (k <= NumTags)
+    {
+      Prefetch(tree, k, NumTags);
+      k = 2 * k + std::size_t(!(value < tree[k]));
+    }
+    return SortedIndices[ResolveDescent(k)];
+  }
+
+  // Tags matching query (query itself and its descendants), empty for an invalid query
+  Range FindRange(const QTag query) const
+  {
+    if (!query.IsValid())
+    {
+      return { 0, 0 };
+    }
+    const typename QTag::DescendantRange range = query.GetDescendantRange();
+    return { LowerBound(range.Low), UpperBound(range.High) };
+  }
+
+  // outRanges[i] = FindRange(queries[i]), outRanges must hold queries.size() ranges
+  void FindRanges(std::span<const QTag> queries, std::span<Range> outRanges) const
+  {
+    std::size_t q = 0;
+    for (; q + GroupSize <= queries.size(); q += GroupSize)
+    {
+      FindRangesGroup(queries.data() + q, outRanges.data() + q);
+    }
+    for (; q < queries.size(); ++q)
+    {
+      outRanges[q] = FindRange(queries[q]);
+    }
+  }
+
+  std::size_t GetMemoryUsage() const
+  {
+    return Storage.capacity() * sizeof(BaseType) + SortedIndices.capacity() * sizeof(std::uint32_t);
+  }
+
+private:
+  std::size_t FillInOrder(std::span<const QTag> sortedTags, BaseType* const tree, const std::size_t k, std::size_t sortedIdx)
+  {
+    if (k <= NumTags)
+    {
+      sortedIdx = FillInOrder(sortedTags, tree, 2 * k, sortedIdx);
+      tree[k] = sortedTags[sortedIdx].GetRaw();
+      SortedIndices[k] = (std::uint32_t)sortedIdx;
+      sortedIdx = FillInOrder(sortedTags, tree, 2 * k + 1, sortedIdx + 1);
+    }
+    return sortedIdx;
+  }
+
+  const BaseType* GetTree() const { return Storage.data() + TreeOffset; }
+
+  static void Prefetch(const BaseType* const tree, const std::size_t k, const std::size_t numTags)
+  {
+    constexpr std::size_t ElementsPerLine = std::max<std::size_t>(1, 64 / sizeof(BaseType));
+    // Clamped rather than branched on, prefetching the last node again is harmless
+    QTAG_PREFETCH(tree + std::min(k * ElementsPerLine, numTags));
+  }
+
+  // The descent went right at every node smaller than the target, the answer is where it last
+  // went left: strip the trailing right turns and that left turn, 0 if it never went left
+  static std::size_t ResolveDescent(const std::size_t k)
+  {
+    return k >> (std::countr_one(k) + 1);
+  }
+
+  void FindRangesGroup(const QTag* queries, Range* outRanges) const
+  {
+    BaseType lows[GroupSize];
+    BaseType highs[GroupSize];
+    bool bValid[GroupSize];
+    for (std::size_t lane = 0; lane < GroupSize; ++lane)
+    {
+      bValid[lane] = queries[lane].IsValid();
+      const typename QTag::DescendantRange range = bValid[lane] ? queries[lane].GetDescendantRange() : typename QTag::DescendantRange{ 0, 0 };
+      lows[lane] = range.Low;
+      highs[lane] = range.High;
+    }
+
+    // Every descent takes NumLevels steps, except on a partial last level where some lanes have
+    // already dropped out of the tree and stay put
+    const BaseType* const tree = GetTree();
+    std::size_t lowK[GroupSize];
+    std::size_t highK[GroupSize];
+    std::fill_n(lowK, GroupSize, std::size_t(1));
+    std::fill_n(highK, GroupSize, std::size_t(1));
+    for (std::size_t level = 0; level < NumLevels; ++level)
+    {
+      for (std::size_t lane = 0; lane < GroupSize; ++lane)
+      {
+        if (lowK[lane] <= NumTags)
+        {
+          Prefetch(tree, lowK[lane], NumTags);
+          lowK[lane] = 2 * lowK[lane] + std::size_t(tree[lowK[lane]] < lows[lane]);
+        }
+        if (highK[lane] <= NumTags)
+        {
+          Prefetch(tree, highK[lane], NumTags);
+          highK[lane] = 2 * highK[lane] + std::size_t(!(highs[lane] < tree[highK[lane]]));
+        }
+      }
+    }
+
+    for (std::size_t lane = 0; lane < GroupSize; ++lane)
+    {
+      outRanges[lane] = bValid[lane]
+        ? Range{ SortedIndices[ResolveDescent(lowK[lane])], SortedIndices[ResolveDescent(highK[lane])] }
+        : Range{ 0, 0 };
+    }
+  }
+
+  std::vector<BaseType> Storage;
+  std::size_t TreeOffset = 0; // Node k is Storage[TreeOffset + k]
+  // Sorted array index of each node, [0] is the not-found sentinel (seeded so an unbuilt search finds nothing)
+  std::vector<std::uint32_t> SortedIndices = { 0 };
+  std::size_t NumTags = 0;
+  std::size_t NumLevels = 0;
+};
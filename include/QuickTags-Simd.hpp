@@ -0,0 +1,131 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+
+// Shared helpers for the SIMD code paths: ISA detection at runtime, a per-function target
+// attribute so AVX2/AVX-512 kernels can live next to the scalar code without building the whole
+// project with -mavx2 (MSVC allows intrinsics in any function, so it needs no attribute), and a
+// portable prefetch hint.
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define QTAG_SIMD_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#else
+#define QTAG_SIMD_X86 0
+#endif
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#define QTAG_TARGET(isa)
+#else
+#define QTAG_TARGET(isa) __attribute__((target(isa)))
+#endif
+
+// Read prefetch hint, a no-op where there's no way to express it
+#if defined(_MSC_VER) && !defined(__clang__) && QTAG_SIMD_X86
+#define QTAG_PREFETCH(ptr) _mm_prefetch(reinterpret_cast<const char*>(ptr), _MM_HINT_T0)
+#elif defined(__GNUC__) || defined(__clang__)
+#define QTAG_PREFETCH(ptr) __builtin_prefetch(ptr)
+#else
+#define QTAG_PREFETCH(ptr) ((void)(ptr))
+#endif
+
+namespace QTagUtil
+{
+  namespace Simd
+  {
+    enum class ELevel : int
+    {
+      Scalar = 0,
+      SSE2,
+      AVX2,
+      AVX512, // F + BW
+    };
+
+    inline ELevel DetectLevel()
+    {
+#if QTAG_SIMD_X86
+#if defined(_MSC_VER) && !defined(__clang__)
+      int info[4];
+      __cpuid(info, 0);
+      const int maxLeaf = info[0];
+
+      __cpuid(info, 1);
+      const bool bSSE2 = (info[3] & (1 << 26)) != 0;
+      const bool bOSXSave = (info[2] & (1 << 27)) != 0;
+      if (!bSSE2)
+      {
+        return ELevel::Scalar;
+      }
+      if (!bOSXSave || maxLeaf < 7)
+      {
+        return ELevel::SSE2;
+      }
+
+      // Check the OS actually saves the wider registers on context switch
+      const unsigned long long xcr0 = _xgetbv(0);
+      const bool bOSAVX = (xcr0 & 0x6) == 0x6;
+      const bool bOSAVX512 = (xcr0 & 0xE6) == 0xE6;
+
+      __cpuidex(info, 7, 0);
+      const bool bAVX2 = (info[1] & (1 << 5)) != 0;
+      const bool bAVX512F = (info[1] & (1 << 16)) != 0;
+      const bool bAVX512BW = (info[1] & (1 << 30)) != 0;
+
+      if (bOSAVX512 && bAVX512F && bAVX512BW)
+      {
+        return ELevel::AVX512;
+      }
+      if (bOSAVX && bAVX2)
+      {
+        return ELevel::AVX2;
+      }
+      return ELevel::SSE2;
+#else
+      // libgcc also checks for OS support of the extended register state
+      __builtin_cpu_init();
+      if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw"))
+      {
+        return ELevel::AVX512;
+      }
+      if (__builtin_cpu_supports("avx2"))
+      {
+        return ELevel::AVX2;
+      }
+      if (__builtin_cpu_supports("sse2"))
+      {
+        return ELevel::SSE2;
+      }
+      return ELevel::Scalar;
+#endif
+#else
+      return ELevel::Scalar;
+#endif
+    }
+
+    namespace Internal
+    {
+      inline std::atomic<int>& MaxLevelOverride()
+      {
+        static std::atomic<int> maxLevel((int)ELevel::AVX512);
+        return maxLevel;
+      }
+    }
+
+    // Caps the level returned by GetLevel, useful for testing and benchmarking each path
+    inline void SetMaxLevel(const ELevel level)
+    {
+      Internal::MaxLevelOverride().store((int)level, std::memory_order_relaxed);
+    }
+
+    // Highest level supported by this CPU, clamped by SetMaxLevel
+    inline ELevel GetLevel()
+    {
+      static const ELevel detected = DetectLevel();
+      const int maxLevel = Internal::MaxLevelOverride().load(std::memory_order_relaxed);
+      return (int)detected < maxLevel ? detected : (ELevel)maxLevel;
+    }
+  }
+}
@@ -0,0 +1,214 @@
+#pragma once
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+// Base types wider than 64 bits for QuickTag.
+//
+// UIntN<NumWords> is a fixed-width unsigned integer made of 64-bit words, least significant word
+// first, so on little-endian targets it has the same in-memory layout as a native integer of the
+// same size. It only implements the operators QuickTag needs, all constexpr.
+//
+// UInt128 is unsigned __int128 where the compiler has it and UIntN<2> otherwise, UInt256 is UIntN<4>.
+
+#if defined(__SIZEOF_INT128__)
+#define QTAG_HAS_INT128 1
+#else
+#define QTAG_HAS_INT128 0
+#endif
+
+namespace QTagUtil
+{
+  template<std::size_t NumWords>
+  struct UIntN
+  {
+    static_assert(NumWords >= 2, "Use a native integer for 64 bits or less");
+
+    std::uint64_t Words[NumWords];
+
+    constexpr UIntN() : Words{} {}
+    // Implicit, like integer promotion, so QuickTag can compare against and build from plain integers
+    constexpr UIntN(const std::uint64_t value) : Words{ value } {}
+
+    explicit constexpr operator std::uint64_t() const { return Words[0]; }
+
+    friend constexpr bool operator==(const UIntN& lhs, const UIntN& rhs)
+    {
+      for (std::size_t w = 0; w < NumWords; ++w)
+      {
+        if (lhs.Words[w] != rhs.Words[w])
+        {
+          return false;
+        }
+      }
+      return true;
+    }
+    friend constexpr bool operator!=(const UIntN& lhs, const UIntN& rhs) { return !(lhs == rhs); }
+
+    friend constexpr bool operator<(const UIntN& lhs, const UIntN& rhs)
+    {
+      // Most significant word decides
+      for (std::size_t w = NumWords; w-- > 0; )
+      {
+        if (lhs.Words[w] != rhs.Words[w])
+        {
+          return lhs.Words[w] < rhs.Words[w];
+        }
+      }
+      return false;
+    }
+    friend constexpr bool operator>(const UIntN& lhs, const UIntN& rhs) { return rhs < lhs; }
+    friend constexpr bool operator<=(const UIntN& lhs, const UIntN& rhs) { return !(rhs < lhs); }
+    friend constexpr bool operator>=(const UIntN& lhs, const UIntN& rhs) { return !(lhs < rhs); }
+
+    friend constexpr UIntN operator&(const UIntN& lhs, const UIntN& rhs)
+    {
+      UIntN result;
+      for (std::size_t w = 0; w < NumWords; ++w)
+      {
+        result.Words[w] = lhs.Words[w] & rhs.Words[w];
+      }
+      return result;
+    }
+    friend constexpr UIntN operator|(const UIntN& lhs, const UIntN& rhs)
+    {
+      UIntN result;
+      for (std::size_t w = 0; w < NumWords; ++w)
+      {
+        result.Words[w] = lhs.Words[w] | rhs.Words[w];
+      }
+      return result;
+    }
+    friend constexpr UIntN operator^(const UIntN& lhs, const UIntN& rhs)
+    {
+      UIntN result;
+      for (std::size_t w = 0; w < NumWords; ++w)
+      {
+        result.Words[w] = lhs.Words[w] ^ rhs.Words[w];
+      }
+      return result;
+    }
+    constexpr UIntN operator~() const
+    {
+      UIntN result;
+      for (std::size_t w = 0; w < NumWords; ++w)
+      {
+        result.Words[w] = ~Words[w];
+      }
+      return result;
+    }
+
+    friend constexpr UIntN operator+(const UIntN& lhs, const UIntN& rhs)
+    {
+      UIntN result;
+      std::uint64_t carry = 0;
+      for (std::size_t w = 0; w < NumWords; ++w)
+      {
+        const std::uint64_t sum = lhs.Words[w] + rhs.Words[w];
+        result.Words[w] = sum + carry;
+        carry = std::uint64_t(sum < lhs.Words[w]) | std::uint64_t(result.Words[w] < sum);
+      }
+      return result;
+    }
+    friend constexpr UIntN operator-(const UIntN& lhs, const UIntN& rhs)
+    {
+      UIntN result;
+      std::uint64_t borrow = 0;
+      for (std::size_t w = 0; w < NumWords; ++w)
+      {
+        const std::uint64_t diff = lhs.Words[w] - rhs.Words[w];
+        result.Words[w] = diff - borrow;
+        borrow = std::uint64_t(lhs.Words[w] < rhs.Words[w]) | std::uint64_t(diff < borrow);
+      }
+      return result;
+    }
+
+    // Shifts of NumWords * 64 or more give zero
+    constexpr UIntN operator<<(const unsigned int shift) const
+    {
+      UIntN result;
+      const std::size_t wordShift = shift / 64;
+      const unsigned int bitShift = shift % 64;
+      for (std::size_t w = NumWords; w-- > wordShift; )
+      {
+        const std::size_t src = w - wordShift;
+        result.Words[w] = Words[src] << bitShift;
+        if (bitShift != 0 && src > 0)
+        {
+          result.Words[w] |= Words[src - 1] >> (64 - bitShift);
+        }
+      }
+      return result;
+    }
+    constexpr UIntN operator>>(const unsigned int shift) const
+    {
+      UIntN result;
+      const std::size_t wordShift = shift / 64;
+      const unsigned int bitShift = shift % 64;
+      for (std::size_t w = 0; w + wordShift < NumWords; ++w)
+      {
+        const std::size_t src = w + wordShift;
+        result.Words[w] = Words[src] >> bitShift;
+        if (bitShift != 0 && src + 1 < NumWords)
+        {
+          result.Words[w] |= Words[src + 1] << (64 - bitShift);
+        }
+      }
+      return result;
+    }
+
+    constexpr UIntN& operator&=(const UIntN& rhs) { return *this = *this & rhs; }
+    constexpr UIntN& operator|=(const UIntN& rhs) { return *this = *this | rhs; }
+    constexpr UIntN& operator<<=(const unsigned int shift) { return *this = *this << shift; }
+    constexpr UIntN& operator>>=(const unsigned int shift) { return *this = *this >> shift; }
+  };
+
+#if QTAG_HAS_INT128
+  using UInt128 = unsigned __int128;
+#else
+  using UInt128 = UIntN<2>;
+#endif
+  using UInt256 = UIntN<4>;
+
+  template<class T>
+  struct IsWideUInt : std::false_type {};
+  template<std::size_t NumWords>
+  struct IsWideUInt<UIntN<NumWords>> : std::true_type {};
+#if QTAG_HAS_INT128
+  template<>
+  struct IsWideUInt<unsigned __int128> : std::true_type {};
+#endif
+
+  // Unsigned types usable as a QuickTag base, std::is_unsigned doesn't cover __int128 in strict modes
+  template<class T>
+  inline constexpr bool IsQTagBaseType = std::is_unsigned_v<T> || IsWideUInt<T>::value;
+
+  template<class T>
+  constexpr int CountLeadingZeros(const T value)
+  {
+    if constexpr (std::is_unsigned_v<T> && !IsWideUInt<T>::value)
+    {
+      return std::countl_zero(value);
+    }
+#if QTAG_HAS_INT128
+    else if constexpr (std::is_same_v<T, unsigned __int128>)
+    {
+      const std::uint64_t high = std::uint64_t(value >> 64);
+      return high != 0 ? std::countl_zero(high) : 64 + std::countl_zero(std::uint64_t(value));
+    }
+#endif
+    else
+    {
+      constexpr std::size_t NumWords = sizeof(T) / sizeof(std::uint64_t);
+      for (std::size_t w = NumWords; w-- > 0; )
+      {
+        if (value.Words[w] != 0)
+        {
+          return int((NumWords - 1 - w) * 64) + std::countl_zero(value.Words[w]);
+        }
+      }
+      return int(NumWords * 64);
+    }
+  }
+}
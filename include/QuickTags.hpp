@@ -1,8 +1,15 @@
 #pragma once
+#include "QuickTags-WideInt.hpp"
+
+#include <bit>
+#include <charconv>
 #include <cstddef>
 #include <cstdint>
 #include <cstring>
 #include <cstdio>
+#include <functional>
+#include <string_view>
+#include <system_error>
 
 namespace QTagUtil
 {
@@ -10,11 +17,105 @@ namespace QTagUtil
   inline constexpr int64_t ipow(const int64_t base, int64_t exp, const int64_t result = 1) {
     return exp < 1 ? result : ipow(base * base, exp / 2, (exp % 2) ? result * base : result);
   }
+
+  // Seeded FNV-1a with a final avalanche, shared by generated name tables and the tools that build them
+  inline constexpr std::uint64_t HashTagName(const std::string_view name, const std::uint64_t seed = 0)
+  {
+    std::uint64_t hash = 14695981039346656037ull ^ (seed * 0x9E3779B97F4A7C15ull);
+    for (const char c : name)
+    {
+      hash ^= (unsigned char)c;
+      hash *= 1099511628211ull;
+    }
+    // FNV alone mixes the last few characters poorly
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdull;
+    hash ^= hash >> 33;
+    return hash;
+  }
+
+  // Raw tag value to a well mixed 64-bit hash, wide types fold their words in one at a time
+  // Finaliser from MurmurHash3, packed values differ mostly in a few high bits which it spreads
+  template<class T>
+  constexpr std::uint64_t HashRawValue(const T value)
+  {
+    std::uint64_t hash = 0;
+    for (std::size_t w = 0; w < (sizeof(T) + 7) / 8; ++w)
+    {
+      std::uint64_t word;
+      if constexpr (sizeof(T) <= 8)
+      {
+        word = (std::uint64_t)value;
+      }
+      else
+      {
+        word = (std::uint64_t)(value >> (unsigned int)(w * 64));
+      }
+      hash ^= word + 0x9E3779B97F4A7C15ull + (hash << 6) + (hash >> 2);
+    }
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdull;
+    hash ^= hash >> 33;
+    hash *= 0xc4ceb9fe1a85ec53ull;
+    hash ^= hash >> 33;
+    return hash;
+  }
+
+  inline constexpr std::size_t CountDecimalDigits(std::uint64_t value)
+  {
+    std::size_t digits = 1;
+    while (value >= 10)
+    {
+      value /= 10;
+      ++digits;
+    }
+    return digits;
+  }
+
+  namespace Internal
+  {
+    // Writes value in decimal two digits at a time, out must have room for CountDecimalDigits(value)
+    // Tag fields are mostly small, so this is usually one or two steps with no length pre-pass
+    template<class UInt>
+    inline char* WriteDecimal(char* const out, UInt value)
+    {
+      static constexpr char DigitPairs[] =
+        "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+        "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+        "8081828384858687888990919293949596979899";
+
+      char digits[20];
+      char* first = digits + sizeof(digits);
+      while (value >= 100)
+      {
+        first -= 2;
+        std::memcpy(first, DigitPairs + (value % 100) * 2, 2);
+        value /= 100;
+      }
+      if (value >= 10)
+      {
+        first -= 2;
+        std::memcpy(first, DigitPairs + value * 2, 2);
+      }
+      else
+      {
+        *--first = char('0' + value);
+      }
+
+      const std::size_t numDigits = std::size_t(digits + sizeof(digits) - first);
+      std::memcpy(out, first, numDigits);
+      return out + numDigits;
+    }
+  }
 }
 
 template<typename BaseType, unsigned char... Field>
 class QuickTag
 {
+  static_assert(QTagUtil::IsQTagBaseType<BaseType>, "BaseType must be an unsigned integer, QTagUtil::UInt128 or a QTagUtil::UIntN");
+  static_assert(((Field <= 64) && ...), "Fields are limited to 64 bits");
+  static_assert((0 + ... + Field) <= sizeof(BaseType) * 8, "Fields don't fit in BaseType");
+
   static constexpr std::size_t NumFields = sizeof...(Field);
   struct NumFieldsSizeArray
   {
@@ -22,6 +123,24 @@ class QuickTag
     constexpr       BaseType& operator[](std::size_t idx)       { return Data[idx]; }
     constexpr const BaseType& operator[](std::size_t idx) const { return Data[idx]; }
   };
+  struct NumFieldsOffsetArray
+  {
+    unsigned int Data[NumFields];
+    constexpr       unsigned int& operator[](std::size_t idx)       { return Data[idx]; }
+    constexpr const unsigned int& operator[](std::size_t idx) const { return Data[idx]; }
+  };
+  struct DepthSizeArray
+  {
+    BaseType Data[NumFields + 1];
+    constexpr       BaseType& operator[](std::size_t idx)       { return Data[idx]; }
+    constexpr const BaseType& operator[](std::size_t idx) const { return Data[idx]; }
+  };
+  struct LeadingZerosArray
+  {
+    unsigned char Data[sizeof(BaseType) * 8 + 1];
+    constexpr       unsigned char& operator[](std::size_t idx)       { return Data[idx]; }
+    constexpr const unsigned char& operator[](std::size_t idx) const { return Data[idx]; }
+  };
 
 public:
   using TagBaseType = BaseType;
@@ -43,9 +162,14 @@ public:
   template<class... Args>
   static constexpr QuickTag<BaseType, Field...> MakeTag(Args... fieldValues)
   {
-    return QuickTag<BaseType, Field...>({ (BaseType)fieldValues... });
+    // Go through the pointer constructor, a braced single value would pick the raw value constructor
+    const BaseType fields[] = { (BaseType)fieldValues... };
+    return QuickTag<BaseType, Field...>(fields, (int)sizeof...(Args));
   }
 
+  static constexpr std::size_t GetNumFields() { return NumFields; }
+  static constexpr unsigned char GetFieldBitWidth(const unsigned char field) { return Fields[field]; }
+
   // Non-templated GetField when index is not known at compile time
   constexpr BaseType GetField(const unsigned char field) const
   {
@@ -62,9 +186,9 @@ public:
   constexpr void SetField(const unsigned char field, const BaseType fieldValue)
   {
     const BaseType maskedValue = (fieldValue & GetMaskSize(field)) << GetOffset(field);
-    // (Value & ~maskValue) unsets old field
-    // | maskValue sets to new field value
-    Value = (Value & ~maskedValue) | maskedValue;
+    // (Value & ~GetMask) unsets old field
+    // | maskedValue sets to new field value
+    Value = (Value & ~GetMask(field)) | maskedValue;
   }
 
   template<unsigned char field>
@@ -73,173 +197,137 @@ public:
     SetField(field, fieldValue);
   }
 
+  // A valid tag is non-zero, with no empty field before a set one
   constexpr bool IsValid() const
   {
-    // First check if Value is set
-    if (Value == 0)
-    {
-      return false;
-    }
-
-    // Then scan backwards from last field, if we find a null value before a valid value, we've got bad data
-    bool bPrevFieldWasValid = false;
-    for (int f = NumFields-1; f >= 0; --f)
-    {
-      const BaseType field = Value & GetMask(f);
-      if (field != 0)
-      {
-        bPrevFieldWasValid |= true;
-      }
-      else if(bPrevFieldWasValid)
-      {
-        return false;
-      }
-    }
-    return true;
+    const BaseType nonZeroFields = GetNonZeroFields();
+    const int depth = GetDepthFromNonZeroFields(nonZeroFields);
+    // Any set field past depth means there was a gap
+    return (Value != 0) & ((nonZeroFields & ~PrefixMasks[depth]) == 0);
   }
 
+  // Number of leading set fields
   constexpr int GetDepth() const
   {
-    if (Value == 0)
-    {
-      return 0;
-    }
+    return GetDepthFromNonZeroFields(GetNonZeroFields());
+  }
 
-    // Check each field until we find a 0
-    int depth = 0;
-    for (int f = 0; f < NumFields; ++f)
-    {
-      const BaseType fieldMask = GetMask(f);
-      if ((Value & fieldMask) != 0)
-      {
-        depth++;
-      }
-      else
-      {
-        return depth;
-      }
-    }
-    return depth;
+  // Mask covering the first depth fields, (Value & GetPrefixMask(d)) gives the ancestor at depth d
+  static constexpr BaseType GetPrefixMask(const int depth)
+  {
+    return PrefixMasks[depth];
   }
 
-  bool operator==(const QuickTag<BaseType, Field...>& rhs) const { return Value == rhs.Value; }
-  bool operator!=(const QuickTag<BaseType, Field...>& rhs) const { return !(*this == rhs); }
+  // Inclusive raw value bounds of this tag and all of its descendants, which sort as one contiguous run
+  // Assumes this tag is valid
+  struct DescendantRange
+  {
+    BaseType Low;
+    BaseType High;
+  };
+  constexpr DescendantRange GetDescendantRange() const
+  {
+    return { Value, BaseType(Value | (FieldBits & ~PrefixMasks[GetDepth()])) };
+  }
 
-  bool operator<(const QuickTag<BaseType, Field...>& rhs) const { return Value < rhs.Value; }
-  bool operator>(const QuickTag<BaseType, Field...>& rhs) const { return rhs < *this; }
-  bool operator<=(const QuickTag<BaseType, Field...>& rhs) const { return !(*this > rhs); }
-  bool operator>=(const QuickTag<BaseType, Field...>& rhs) const { return !(*this < rhs); }
+  constexpr bool operator==(const QuickTag<BaseType, Field...>& rhs) const { return Value == rhs.Value; }
+  constexpr bool operator!=(const QuickTag<BaseType, Field...>& rhs) const { return !(*this == rhs); }
+
+  constexpr bool operator<(const QuickTag<BaseType, Field...>& rhs) const { return Value < rhs.Value; }
+  constexpr bool operator>(const QuickTag<BaseType, Field...>& rhs) const { return rhs < *this; }
+  constexpr bool operator<=(const QuickTag<BaseType, Field...>& rhs) const { return !(*this > rhs); }
+  constexpr bool operator>=(const QuickTag<BaseType, Field...>& rhs) const { return !(*this < rhs); }
 
   constexpr bool MatchesExact(const QuickTag<BaseType, Field...>& tagToMatch) const
   {
-    if (!tagToMatch.IsValid())
-    {
-      return false;
-    }
-
-    return *this == tagToMatch;
+    return tagToMatch.IsValid() & (*this == tagToMatch);
   }
 
   // In the style of FGameplayTag...
   // "A.1".Matches("A") will return True, "A".Matches("A.1") will return False
+  // Assumes this tag is valid
   constexpr bool Matches(const QuickTag<BaseType, Field...>& tagToMatch) const
   {
-    if (!tagToMatch.IsValid())
-    {
-      return false;
-    }
+    // Same as IsValid/GetDepth, sharing the non-zero field scan
+    const BaseType theirNonZeroFields = tagToMatch.GetNonZeroFields();
+    const int theirDepth = GetDepthFromNonZeroFields(theirNonZeroFields);
+    const BaseType theirPrefixMask = PrefixMasks[theirDepth];
+    const bool bTheirValid = (tagToMatch.Value != 0) & ((theirNonZeroFields & ~theirPrefixMask) == 0);
+
+    // If they're deeper than us, their field at our depth is set while ours is empty, so this fails too
+    return bTheirValid & ((Value & theirPrefixMask) == tagToMatch.Value);
+  }
 
-    // Compare depths
-    const int myDepth = GetDepth();
-    const int theirDepth = tagToMatch.GetDepth();
-    if (theirDepth > myDepth)
+  // Longest string ToChars can write, every field at its maximum plus the separators
+  static constexpr std::size_t MaxStringLength = (NumFields - 1)
+    + (QTagUtil::CountDecimalDigits(Field >= 64 ? ~std::uint64_t(0) : (std::uint64_t(1) << Field) - 1) + ...);
+
+  // std::to_chars style, writes every field as "1.2.0" into [first, last) with no null terminator
+  // Returns { last, std::errc::value_too_large } if it doesn't fit, MaxStringLength chars always do
+  std::to_chars_result ToChars(char* const first, char* const last) const
+  {
+    if (last - first >= std::ptrdiff_t(MaxStringLength))
     {
-      return false;
+      return { WriteFields(first), std::errc() };
     }
-    else if (theirDepth == myDepth)
+
+    // Might not fit, format on the side and copy if it does
+    char buffer[MaxStringLength];
+    const std::size_t strLen = std::size_t(WriteFields(buffer) - buffer);
+    if (std::ptrdiff_t(strLen) > last - first)
     {
-      return *this == tagToMatch;
+      return { last, std::errc::value_too_large };
     }
-    else // theirDepth < myDepth (compare parents)
+    std::memcpy(first, buffer, strLen);
+    return { first + strLen, std::errc() };
+  }
+
+  // Writes a null terminated string into buffer and returns its length, or writes an empty string
+  // and returns 0 if it needs more than bufferSize bytes. MaxStringLength + 1 bytes always fit
+  std::size_t ToChars(char* const buffer, const std::size_t bufferSize) const
+  {
+    if (bufferSize == 0)
     {
-      // Build mask from their depth
-      unsigned int parentMask = 0;
-      for (int f = 0; f < theirDepth; ++f)
-      {
-        parentMask |= GetMask(f);
-      }
-      // Compare our parents with tagToMatch
-      return ((Value & parentMask) == tagToMatch.Value);
+      return 0;
     }
+    const std::to_chars_result result = ToChars(buffer, buffer + bufferSize - 1);
+    const std::size_t strLen = result.ec == std::errc() ? std::size_t(result.ptr - buffer) : 0;
+    buffer[strLen] = '\0';
+    return strLen;
   }
 
   // Allocate a char array with a string containing a textual representation of the Tag's Value
-  // string must be deleted/freed by caller!
+  // string must be deleted/freed by caller! ToChars formats without allocating
   char* ValueAsString() const
   {
-    unsigned int strLen = 0;
-    BaseType fields[NumFields];
-    unsigned int fieldSize[NumFields];
-    // Calculate how long the string needs to be
-    for (int f = 0; f < NumFields; ++f)
-    {
-      BaseType value = GetField(f);
-      fields[f] = value; // Save for string conversion
-      
-      unsigned int len = 0;
-      do
-      {
-        len += 1; // Always at least 1 ('0')
-        value /= 10; // Base 10
-      } while (value);
-
-      fieldSize[f] = len;
-
-      if (f < NumFields - 1)
-      {
-        len += 1; // . separator
-      }
+    char buffer[MaxStringLength + 1];
+    const std::size_t strLen = ToChars(buffer, sizeof(buffer));
+    char* outStr = new char[strLen + 1];
+    std::memcpy(outStr, buffer, strLen + 1);
+    return outStr;
+  }
 
-      strLen += len;
-    }
-    strLen += 1; // null terminator
+  constexpr BaseType GetRaw() const { return Value; }
 
-    // Allocate
-    if (char* outStr = new char[strLen])
-    {
-      char* strPlace = outStr;
-      unsigned int remainingStrLen = strLen;
-      for (int f = 0; f < NumFields; ++f)
-      {
-        const BaseType value = fields[f];
-        char buf[22]; // 2^64 is 20 characters, +1 for null, +1 for possible minus symbol (unlikely)
-        snprintf(buf, 22, "%d", value); // int to string
-
-        // Write buffer to string
-        strncpy_s(strPlace, remainingStrLen, buf, fieldSize[f]);
-        
-        strPlace += fieldSize[f];
-        remainingStrLen -= fieldSize[f];
-
-        // Add deliminator
-        if (f < NumFields - 1)
-        {
-          strncpy_s(strPlace, remainingStrLen, ".", 1);
-          strPlace++;
-          remainingStrLen--;
-        }
-      }
-      // End
-      *strPlace = '\0';
-      return outStr;
-    }
-    return nullptr;
+private:
+  // Top bit of each field that is non-zero, branch-free
+  constexpr BaseType GetNonZeroFields() const
+  {
+    // Adding the low bits of each field to themselves carries into the field's top bit if any were set
+    // Sum never exceeds the field, so there's no carry into the next one
+    const BaseType fieldBits = Value & FieldBits;
+    const BaseType lowCarry = BaseType((fieldBits & FieldLowBits) + FieldLowBits);
+    return (lowCarry | fieldBits) & FieldTopBits;
   }
 
-  BaseType GetRaw() const { return Value; }
+  static constexpr int GetDepthFromNonZeroFields(const BaseType nonZeroFields)
+  {
+    // Highest empty field is the first one from the left, its position gives the depth
+    const BaseType zeroFields = ~nonZeroFields & FieldTopBits;
+    return LeadingZerosToDepth[QTagUtil::CountLeadingZeros(zeroFields)];
+  }
 
-private:
-  void SetValueFromArray(const BaseType* arr, const int len)
+  constexpr void SetValueFromArray(const BaseType* arr, const int len)
   {
     for (int f = 0; f < len; ++f)
     {
@@ -249,21 +337,21 @@ private:
         // End of valid data
         return;
       }
-      const BaseType offset = GetOffset(f);
+      const unsigned int offset = GetOffset(f);
       const BaseType mask = GetMask(f);
       Value |= (arr[f] << offset) & mask;
     }
   }
 
-  static constexpr NumFieldsSizeArray GenFieldOffsets()
+  static constexpr NumFieldsOffsetArray GenFieldOffsets()
   {
-    constexpr unsigned char bits = sizeof(BaseType) * 8;
-    NumFieldsSizeArray fieldOffsets = { 0 };
+    constexpr unsigned int bits = sizeof(BaseType) * 8;
+    NumFieldsOffsetArray fieldOffsets = { 0 };
     for (int f = 0; f < NumFields; ++f)
     {
       // Pack backwards so that first field is "largest"
       // This lets us sort with <
-      unsigned char offset = Fields[0];
+      unsigned int offset = Fields[0];
       for (int nf = 1; nf < f + 1; ++nf)
       {
         offset += Fields[nf];
@@ -278,7 +366,8 @@ private:
     NumFieldsSizeArray fieldMaskSizes = { 0 };
     for (int f = 0; f < NumFields; ++f)
     {
-      fieldMaskSizes[f] = BaseType(QTagUtil::ipow(2, Fields[f]) - 1);
+      // Fields are at most 64 bits, so build the mask in 64 bits then widen
+      fieldMaskSizes[f] = BaseType(Fields[f] >= 64 ? ~std::uint64_t(0) : (std::uint64_t(1) << Fields[f]) - 1);
     }
     return fieldMaskSizes;
   }
@@ -293,7 +382,65 @@ private:
     return fieldMasks;
   }
 
-  static constexpr BaseType GetOffset(const unsigned char field)
+  static constexpr DepthSizeArray GenPrefixMasks()
+  {
+    DepthSizeArray prefixMasks = { 0 };
+    for (std::size_t depth = 1; depth <= NumFields; ++depth)
+    {
+      prefixMasks[depth] = prefixMasks[depth - 1] | GetMask(depth - 1);
+    }
+    return prefixMasks;
+  }
+
+  static constexpr BaseType GenFieldTopBits()
+  {
+    BaseType topBits = 0;
+    for (std::size_t f = 0; f < NumFields; ++f)
+    {
+      topBits |= BaseType(1) << (GetOffset(f) + Fields[f] - 1);
+    }
+    return topBits;
+  }
+
+  static constexpr LeadingZerosArray GenLeadingZerosToDepth()
+  {
+    constexpr unsigned int bits = sizeof(BaseType) * 8;
+    LeadingZerosArray leadingZerosToDepth = { 0 };
+    for (unsigned int lz = 0; lz <= bits; ++lz)
+    {
+      // Bit position lz from the top, belongs to the first field ending at or below it
+      // lz == bits means no empty field, so full depth
+      std::size_t depth = NumFields;
+      for (std::size_t f = 0; f < NumFields; ++f)
+      {
+        if (lz < bits && (bits - 1 - lz) >= GetOffset(f))
+        {
+          depth = f;
+          break;
+        }
+      }
+      leadingZerosToDepth[lz] = (unsigned char)depth;
+    }
+    return leadingZerosToDepth;
+  }
+
+  // Unchecked ToChars, out must have room for MaxStringLength chars
+  char* WriteFields(char* out) const
+  {
+    for (std::size_t f = 0; f < NumFields; ++f)
+    {
+      const std::uint64_t field = (std::uint64_t)GetField((unsigned char)f);
+      // 32-bit division is a good deal cheaper where the field fits
+      out = field <= 0xFFFFFFFFu ? QTagUtil::Internal::WriteDecimal(out, std::uint32_t(field)) : QTagUtil::Internal::WriteDecimal(out, field);
+      if (f + 1 < NumFields)
+      {
+        *out++ = '.';
+      }
+    }
+    return out;
+  }
+
+  static constexpr unsigned int GetOffset(const unsigned char field)
   {
     return FieldOffsets[field];
   }
@@ -309,7 +456,28 @@ private:
   BaseType Value;
 
   static constexpr unsigned char Fields[NumFields] = { Field... };
-  static constexpr NumFieldsSizeArray FieldOffsets = GenFieldOffsets();
+  static constexpr NumFieldsOffsetArray FieldOffsets = GenFieldOffsets();
   static constexpr NumFieldsSizeArray FieldMaskSizes = GenFieldMaskSizes();
   static constexpr NumFieldsSizeArray FieldMasks = GenFieldMasks();
+  // PrefixMasks[d] covers fields [0, d)
+  static constexpr DepthSizeArray PrefixMasks = GenPrefixMasks();
+  // Field boundary patterns, the highest bit of each field, and every other bit of each field
+  static constexpr BaseType FieldBits = PrefixMasks[NumFields];
+  static constexpr BaseType FieldTopBits = GenFieldTopBits();
+  static constexpr BaseType FieldLowBits = FieldBits & ~FieldTopBits;
+  // Maps countl_zero of the empty fields' top bits to the depth
+  static constexpr LeadingZerosArray LeadingZerosToDepth = GenLeadingZerosToDepth();
 };
+
+namespace std
+{
+  // Lets QuickTags key std::unordered_map/std::unordered_set directly
+  template<typename BaseType, unsigned char... Field>
+  struct hash<QuickTag<BaseType, Field...>>
+  {
+    std::size_t operator()(const QuickTag<BaseType, Field...>& tag) const
+    {
+      return (std::size_t)QTagUtil::HashRawValue(tag.GetRaw());
+    }
+  };
+}
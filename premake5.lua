@@ -46,3 +46,6 @@ workspace "QuickTags"
 include "quicktags-tests.lua"
 include "quicktags-loader.lua"
 include "quicktags-analyser.lua"
+include "quicktags-codegen.lua"
+include "quicktags-bench.lua"
+include "quicktags-loadbench.lua"
\ No newline at end of file
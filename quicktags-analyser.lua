@@ -14,7 +14,14 @@ project "quicktags-analyser"
     files
     {
         "include/QuickTags.hpp",
+        "include/QuickTags-WideInt.hpp",
+        "include/QuickTags-LoadStats.hpp",
+        "include/QuickTags-Layout.hpp",
         "src/quicktags-analyser.cpp",
         "quicktags.natvis"
     }
     links { "quicktags-loader" }
+
+    -- Loader runs worker threads
+    filter "system:linux"
+        links { "pthread" }
@@ -0,0 +1,20 @@
+project "quicktags-bench"
+    kind "ConsoleApp"
+    language "C++"
+    cppdialect "C++20"
+    includedirs
+    {
+        "include"
+    }
+    files
+    {
+        "include/QuickTags.hpp",
+        "include/QuickTags-WideInt.hpp",
+        "include/QuickTags-Simd.hpp",
+        "include/QuickTags-Format.hpp",
+        "include/QuickTags-Container.hpp",
+        "include/QuickTags-Codec.hpp",
+        "include/QuickTags-Map.hpp",
+        "src/quicktags-bench.cpp",
+        "quicktags.natvis"
+    }
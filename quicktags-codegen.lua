@@ -0,0 +1,26 @@
+project "quicktags-codegen"
+    kind "ConsoleApp"
+    language "C++"
+    cppdialect "C++20"
+    debugargs
+    {
+        "-f",
+        "../../../../src/Tags.txt",
+        "-o",
+        "Tags.generated.hpp"
+    }
+    includedirs
+    {
+        "include"
+    }
+    files
+    {
+        "include/QuickTags.hpp",
+        "include/QuickTags-WideInt.hpp",
+        "src/quicktags-codegen.cpp",
+        "quicktags.natvis"
+    }
+    links { "quicktags-loader" }
+    -- Loader runs worker threads
+    filter "system:linux"
+        links { "pthread" }
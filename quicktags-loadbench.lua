@@ -0,0 +1,22 @@
+project "quicktags-loadbench"
+    kind "ConsoleApp"
+    language "C++"
+    cppdialect "C++20"
+    includedirs
+    {
+        "include"
+    }
+    files
+    {
+        "include/QuickTags.hpp",
+        "include/QuickTags-WideInt.hpp",
+        "include/QuickTags-Loader.hpp",
+        "include/QuickTags-LoadStats.hpp",
+        "src/quicktags-loadbench.cpp",
+        "quicktags.natvis"
+    }
+    links { "quicktags-loader" }
+
+    -- Loader runs worker threads
+    filter "system:linux"
+        links { "pthread" }
@@ -9,7 +9,37 @@ project "quicktags-loader"
     files
     {
         "include/QuickTags.hpp",
+        "include/QuickTags-WideInt.hpp",
+        "include/QuickTags-Container.hpp",
+        "include/QuickTags-Bitset.hpp",
+        "include/QuickTags-Query.hpp",
+        "include/QuickTags-Index.hpp",
+        "include/QuickTags-Search.hpp",
+        "include/QuickTags-Format.hpp",
+        "include/QuickTags-Resolver.hpp",
+        "include/QuickTags-Codec.hpp",
+        "include/QuickTags-Map.hpp",
+        "include/QuickTags-Literal.hpp",
+        "include/QuickTags-Batch.hpp",
+        "include/QuickTags-Simd.hpp",
         "include/QuickTags-Loader.hpp",
+        "include/QuickTags-LoadStats.hpp",
+        "include/QuickTags-FlatTree.hpp",
+        "include/QuickTags-NameTable.hpp",
+        "include/QuickTags-MappedFile.hpp",
+        "include/QuickTags-Registry.hpp",
+        "include/QuickTags-IdManifest.hpp",
+        "include/QuickTags-ConcurrentRegistry.hpp",
+        "include/QuickTags-Layout.hpp",
+        "include/QuickTags-Migration.hpp",
         "src/QuickTags-Loader.cpp",
+        "src/QuickTags-FlatTree.cpp",
+        "src/QuickTags-MappedFile.cpp",
+        "src/QuickTags-Registry.cpp",
+        "src/QuickTags-IdManifest.cpp",
+        "src/QuickTags-Index.cpp",
+        "src/QuickTags-ConcurrentRegistry.cpp",
+        "src/QuickTags-Layout.cpp",
+        "src/QuickTags-Migration.cpp",
         "quicktags.natvis"
     }
\ No newline at end of file
@@ -9,7 +9,27 @@ project "quicktags-tests"
     files
     {
         "include/QuickTags.hpp",
+        "include/QuickTags-WideInt.hpp",
+        "include/QuickTags-Container.hpp",
+        "include/QuickTags-Bitset.hpp",
+        "include/QuickTags-Query.hpp",
+        "include/QuickTags-Index.hpp",
+        "include/QuickTags-Search.hpp",
+        "include/QuickTags-Format.hpp",
+        "include/QuickTags-Resolver.hpp",
+        "include/QuickTags-Codec.hpp",
+        "include/QuickTags-Map.hpp",
+        "include/QuickTags-Literal.hpp",
+        "include/QuickTags-ConcurrentRegistry.hpp",
+        "include/QuickTags-Layout.hpp",
+        "include/QuickTags-Migration.hpp",
+        "include/QuickTags-Batch.hpp",
+        "include/QuickTags-Simd.hpp",
         "src/quicktags-tests.cpp",
         "quicktags.natvis"
     }
     links { "quicktags-loader" }
+
+    -- Loader runs worker threads
+    filter "system:linux"
+        links { "pthread" }
@@ -0,0 +1,70 @@
+#include "QuickTags-ConcurrentRegistry.hpp"
+
+#include <thread>
+
+using QTagUtil::ReadEpochs;
+
+namespace
+{
+  // Threads take slots round robin as they first read, so up to NumSlots readers never share a line
+  std::size_t GetThreadSlot(const std::size_t numSlots)
+  {
+    static std::atomic<std::size_t> nextSlot = 0;
+    thread_local const std::size_t slot = nextSlot.fetch_add(1, std::memory_order_relaxed);
+    return slot % numSlots;
+  }
+}
+
+ReadEpochs::ReadGuard::ReadGuard(const ReadEpochs& epochs)
+{
+  ReaderSlot& slot = epochs.Slots[GetThreadSlot(NumSlots)];
+  while (true)
+  {
+    const std::uint32_t epoch = epochs.Epoch.load(std::memory_order_seq_cst);
+    Counter = &slot.Counts[epoch & 1];
+    Counter->fetch_add(1, std::memory_order_seq_cst);
+
+    // If the epoch flipped before we were counted, the writer may already be past waiting on this
+    // parity, back out and count against the new one
+    if (epochs.Epoch.load(std::memory_order_seq_cst) == epoch)
+    {
+      return;
+    }
+    Counter->fetch_sub(1, std::memory_order_release);
+  }
+}
+
+ReadEpochs::ReadGuard::~ReadGuard()
+{
+  Counter->fetch_sub(1, std::memory_order_release);
+}
+
+void ReadEpochs::Synchronize()
+{
+  // Readers entering from here on count against the new parity and see whatever was published
+  // before the flip, only the old parity can still hold the old snapshot
+  const std::uint32_t oldParity = Epoch.fetch_add(1, std::memory_order_seq_cst) & 1;
+  for (ReaderSlot& slot : Slots)
+  {
+    while (slot.Counts[oldParity].load(std::memory_order_acquire) != 0)
+    {
+      std::this_thread::yield();
+    }
+  }
+}
+
+bool QTagUtil::IsValidTagName(const std::string_view name)
+{
+  if (name.empty() || name.front() == '.' || name.back() == '.')
+  {
+    return false;
+  }
+  for (std::size_t c = 0; c < name.size(); ++c)
+  {
+    if (name[c] == ' ' || name[c] == '\t' || name[c] == '\r' || name[c] == '\n' || (name[c] == '.' && name[c + 1] == '.'))
+    {
+      return false;
+    }
+  }
+  return true;
+}
@@ -0,0 +1,173 @@
+#include "QuickTags-FlatTree.hpp"
+#include "QuickTags.hpp"
+
+#include <algorithm>
+#include <unordered_map>
+
+using QTagUtil::FlatTagNode;
+using QTagUtil::FlatTagTree;
+
+namespace
+{
+  constexpr std::uint32_t InvalidIndex = FlatTagNode::InvalidIndex;
+
+  // Nodes in creation order, children as linked lists until the final layout is known
+  struct BuildNode
+  {
+    std::uint32_t Parent;
+    std::uint32_t FirstChild;
+    std::uint32_t LastChild;
+    std::uint32_t NextSibling;
+    std::uint32_t Depth;
+    std::string_view Segment; // Views the input strings, which outlive the build
+  };
+
+  struct ChildKey
+  {
+    std::uint32_t Parent;
+    std::string_view Segment;
+
+    bool operator==(const ChildKey& other) const
+    {
+      return Parent == other.Parent && Segment == other.Segment;
+    }
+  };
+
+  struct ChildKeyHash
+  {
+    std::size_t operator()(const ChildKey& key) const
+    {
+      return (std::size_t)QTagUtil::HashTagName(key.Segment, key.Parent);
+    }
+  };
+}
+
+template<class StringRange>
+void FlatTagTree::BuildImpl(const StringRange& inSortedTags)
+{
+  Reset();
+
+  std::vector<BuildNode> buildNodes;
+  std::unordered_map<ChildKey, std::uint32_t, ChildKeyHash> childIndex;
+  childIndex.reserve(inSortedTags.size());
+  std::uint32_t firstRoot = InvalidIndex;
+  std::uint32_t lastRoot = InvalidIndex;
+  std::size_t segmentBytes = 0;
+
+  for (const std::string_view tagString : inSortedTags)
+  {
+    // Split on '.', matching std::getline semantics (a trailing empty segment is dropped)
+    std::uint32_t parent = InvalidIndex;
+    std::uint32_t depth = 0;
+    for (std::size_t segmentStart = 0; segmentStart < tagString.size(); ++depth)
+    {
+      std::size_t segmentEnd = tagString.find('.', segmentStart);
+      if (segmentEnd == std::string_view::npos)
+      {
+        segmentEnd = tagString.size();
+      }
+      const std::string_view segment = tagString.substr(segmentStart, segmentEnd - segmentStart);
+      segmentStart = segmentEnd + 1;
+
+      const std::pair<std::unordered_map<ChildKey, std::uint32_t, ChildKeyHash>::iterator, bool> inserted =
+        childIndex.try_emplace(ChildKey{ parent, segment }, (std::uint32_t)buildNodes.size());
+      if (!inserted.second)
+      {
+        parent = inserted.first->second;
+        continue;
+      }
+
+      // Not seen before, append to the parent's (or the root) child list
+      const std::uint32_t idx = (std::uint32_t)buildNodes.size();
+      buildNodes.push_back({ parent, InvalidIndex, InvalidIndex, InvalidIndex, depth, segment });
+      segmentBytes += segment.size();
+
+      std::uint32_t& firstSibling = parent == InvalidIndex ? firstRoot : buildNodes[parent].FirstChild;
+      std::uint32_t& lastSibling = parent == InvalidIndex ? lastRoot : buildNodes[parent].LastChild;
+      if (lastSibling == InvalidIndex)
+      {
+        firstSibling = idx;
+      }
+      else
+      {
+        buildNodes[lastSibling].NextSibling = idx;
+      }
+      lastSibling = idx;
+      parent = idx;
+    }
+  }
+
+  // Breadth first layout, a node's children are pushed together so their indices are contiguous
+  std::vector<std::uint32_t> order;
+  order.reserve(buildNodes.size());
+  std::vector<std::uint32_t> newIndex(buildNodes.size());
+  for (std::uint32_t root = firstRoot; root != InvalidIndex; root = buildNodes[root].NextSibling)
+  {
+    newIndex[root] = (std::uint32_t)order.size();
+    order.push_back(root);
+  }
+  NumRoots = (std::uint32_t)order.size();
+
+  Nodes.resize(buildNodes.size());
+  SegmentPool.reserve(segmentBytes);
+  for (std::size_t pos = 0; pos < order.size(); ++pos)
+  {
+    const BuildNode& buildNode = buildNodes[order[pos]];
+    FlatTagNode& node = Nodes[pos];
+    node.Parent = buildNode.Parent == InvalidIndex ? InvalidIndex : newIndex[buildNode.Parent];
+    node.FirstChild = (std::uint32_t)order.size();
+    node.NumChildren = 0;
+    node.SegmentOffset = (std::uint32_t)SegmentPool.size();
+    node.SegmentLength = (std::uint32_t)buildNode.Segment.size();
+    node.Depth = buildNode.Depth;
+    node.TagAsInt = node.Parent == InvalidIndex ? pos + 1 : pos - Nodes[node.Parent].FirstChild + 1;
+    SegmentPool.append(buildNode.Segment);
+
+    for (std::uint32_t child = buildNode.FirstChild; child != InvalidIndex; child = buildNodes[child].NextSibling)
+    {
+      newIndex[child] = (std::uint32_t)order.size();
+      order.push_back(child);
+      ++node.NumChildren;
+    }
+  }
+}
+
+void FlatTagTree::Build(std::span<const std::string_view> inSortedTags)
+{
+  BuildImpl(inSortedTags);
+}
+
+void FlatTagTree::Build(const std::set<std::string>& inStringSet)
+{
+  BuildImpl(inStringSet);
+}
+
+void FlatTagTree::Reset()
+{
+  Nodes.clear();
+  SegmentPool.clear();
+  NumRoots = 0;
+}
+
+void FlatTagTree::FindTagRanges(std::vector<std::uint32_t>& outRanges) const
+{
+  outRanges.clear();
+  if (NumRoots == 0)
+  {
+    return;
+  }
+
+  outRanges.push_back(NumRoots);
+  for (const FlatTagNode& node : Nodes)
+  {
+    if (node.NumChildren == 0)
+    {
+      continue;
+    }
+    if (outRanges.size() <= node.Depth + 1)
+    {
+      outRanges.resize(node.Depth + 2, 0);
+    }
+    outRanges[node.Depth + 1] = std::max(outRanges[node.Depth + 1], node.NumChildren);
+  }
+}
@@ -0,0 +1,276 @@
+#include "QuickTags-IdManifest.hpp"
+#include "QuickTags-Registry.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <fstream>
+#include <set>
+#include <sstream>
+#include <unordered_map>
+
+using QTagUtil::TagIdManifest;
+using QTagUtil::TagTreeNode;
+
+namespace
+{
+  // Top-level tags' parent key, '\n' can't appear in a tag name
+  const std::string RootParentKey = "\n";
+
+  std::string GetParentKey(const std::string& name)
+  {
+    const std::size_t lastDot = name.rfind('.');
+    return lastDot == std::string::npos ? RootParentKey : name.substr(0, lastDot);
+  }
+}
+
+bool TagIdManifest::Read(std::istream& inStream)
+{
+  Reset();
+
+  for (std::string line; std::getline(inStream, line); )
+  {
+    if (!line.empty() && line.back() == '\r')
+    {
+      line.pop_back();
+    }
+    if (line.empty() || line[0] == '#')
+    {
+      continue;
+    }
+
+    std::istringstream ss(line);
+    std::string kind;
+    ss >> kind;
+    if (kind == "layout")
+    {
+      Layout.clear();
+      for (std::uint32_t bits; ss >> bits; )
+      {
+        Layout.push_back(bits);
+      }
+      if (!ss.eof())
+      {
+        Reset();
+        return false;
+      }
+    }
+    else if (kind == "tag" || kind == "dead")
+    {
+      std::string name;
+      Entry entry;
+      entry.bTombstone = kind == "dead";
+      if (!(ss >> name >> entry.Value) || entry.Value == 0)
+      {
+        Reset();
+        return false;
+      }
+      Entries[name] = entry;
+    }
+    else
+    {
+      Reset();
+      return false;
+    }
+  }
+  return true;
+}
+
+bool TagIdManifest::ReadFile(const std::string& path)
+{
+  std::ifstream file(path);
+  if (!file.is_open())
+  {
+    Reset();
+    return true;
+  }
+  return Read(file);
+}
+
+bool TagIdManifest::Write(std::ostream& outStream) const
+{
+  outStream << "# QuickTags ID manifest, keep under source control alongside the tag files\n";
+  if (!Layout.empty())
+  {
+    outStream << "layout";
+    for (const std::uint32_t bits : Layout)
+    {
+      outStream << " " << bits;
+    }
+    outStream << "\n";
+  }
+  for (const std::pair<const std::string, Entry>& entry : Entries)
+  {
+    outStream << (entry.second.bTombstone ? "dead " : "tag ") << entry.first << " " << entry.second.Value << "\n";
+  }
+  return outStream.good();
+}
+
+bool TagIdManifest::WriteFile(const std::string& path) const
+{
+  std::ofstream file(path, std::ios_base::out | std::ios_base::trunc);
+  return file.is_open() && Write(file);
+}
+
+void TagIdManifest::ReadFromRegistry(const TagRegistry& registry)
+{
+  Reset();
+  if (!registry.IsOpen())
+  {
+    return;
+  }
+
+  const std::span<const std::uint8_t> fieldBits = registry.GetFieldBits();
+  Layout.assign(fieldBits.begin(), fieldBits.end());
+
+  const std::uint32_t baseBits = std::uint32_t(8) << (std::uint32_t)registry.GetIntBase();
+  const std::span<const TagRegistryNode> nodes = registry.GetNodes();
+  std::vector<char> nameBuffer;
+  for (std::uint32_t idx = 0; idx < registry.Num(); ++idx)
+  {
+    std::uint32_t depth = 0;
+    for (std::uint32_t parent = nodes[idx].Parent; parent != TagRegistryNode::InvalidIndex; parent = nodes[parent].Parent)
+    {
+      ++depth;
+    }
+
+    // Unpack this tag's own field, first field in the highest bits
+    std::uint32_t offset = baseBits;
+    for (std::uint32_t f = 0; f <= depth; ++f)
+    {
+      offset -= fieldBits[f];
+    }
+    const std::uint64_t fieldMask = fieldBits[depth] >= 64 ? ~std::uint64_t(0) : (std::uint64_t(1) << fieldBits[depth]) - 1;
+
+    nameBuffer.resize(nodes[idx].NameLength + 1);
+    Entry entry;
+    entry.Value = (registry.GetRawValue(idx) >> offset) & fieldMask;
+    entry.bTombstone = false;
+    Entries.emplace(std::string(registry.GetName(idx, nameBuffer)), entry);
+  }
+}
+
+void TagIdManifest::Reset()
+{
+  Entries.clear();
+  Layout.clear();
+}
+
+const TagIdManifest::Entry* TagIdManifest::Find(const std::string& name) const
+{
+  std::map<std::string, Entry>::const_iterator it = Entries.find(name);
+  return it == Entries.end() ? nullptr : &it->second;
+}
+
+namespace
+{
+  struct StableEnumerator
+  {
+    std::map<std::string, TagIdManifest::Entry>& Entries;
+    QTagUtil::StableEnumerateStats& Stats;
+    // Values held by each parent's children in the manifest, live or tombstoned
+    std::unordered_map<std::string, std::set<std::uint64_t>> ReservedValues;
+    std::set<std::string> SeenNames;
+
+    void Enumerate(std::list<TagTreeNode>& nodes, const std::string& parentKey)
+    {
+      std::set<std::uint64_t>& reserved = ReservedValues[parentKey];
+
+      // Known names keep their value first, so new tags can't take a slot a later sibling owns
+      std::vector<std::pair<TagTreeNode*, std::string>> newNodes;
+      std::vector<std::string> names;
+      names.reserve(nodes.size());
+      for (TagTreeNode& node : nodes)
+      {
+        const std::string& name = names.emplace_back(parentKey == RootParentKey ? node.Tag : parentKey + "." + node.Tag);
+        SeenNames.insert(name);
+
+        std::map<std::string, TagIdManifest::Entry>::iterator it = Entries.find(name);
+        if (it == Entries.end())
+        {
+          newNodes.emplace_back(&node, name);
+          continue;
+        }
+
+        node.TagAsInt = it->second.Value;
+        if (it->second.bTombstone)
+        {
+          it->second.bTombstone = false;
+          ++Stats.NumRevived;
+        }
+        else
+        {
+          ++Stats.NumKept;
+        }
+      }
+
+      // Lowest free slots, in sibling order
+      std::uint64_t candidate = 1;
+      for (std::pair<TagTreeNode*, std::string>& newNode : newNodes)
+      {
+        while (reserved.count(candidate))
+        {
+          ++candidate;
+        }
+        reserved.insert(candidate);
+        newNode.first->TagAsInt = candidate;
+        Entries[newNode.second] = TagIdManifest::Entry{ candidate, false };
+        ++Stats.NumAdded;
+      }
+
+      std::size_t nameIdx = 0;
+      for (TagTreeNode& node : nodes)
+      {
+        Enumerate(node.SubTags, names[nameIdx++]);
+      }
+
+      nodes.sort([](const TagTreeNode& a, const TagTreeNode& b)
+        {
+          return a.TagAsInt < b.TagAsInt;
+        });
+    }
+  };
+}
+
+void QTagUtil::EnumerateTagsStable(std::list<TagTreeNode>& tags, TagIdManifest& ioManifest, StableEnumerateStats* outStats)
+{
+  StableEnumerateStats stats;
+  StableEnumerator enumerator = { ioManifest.Entries, stats, {}, {} };
+  for (const std::pair<const std::string, TagIdManifest::Entry>& entry : ioManifest.Entries)
+  {
+    enumerator.ReservedValues[GetParentKey(entry.first)].insert(entry.second.Value);
+  }
+
+  enumerator.Enumerate(tags, RootParentKey);
+
+  // Anything the tree no longer has keeps its value reserved
+  for (std::pair<const std::string, TagIdManifest::Entry>& entry : ioManifest.Entries)
+  {
+    if (!entry.second.bTombstone && !enumerator.SeenNames.count(entry.first))
+    {
+      entry.second.bTombstone = true;
+      ++stats.NumRemoved;
+    }
+  }
+
+  if (outStats)
+  {
+    *outStats = stats;
+  }
+}
+
+bool QTagUtil::FitsLayout(const std::vector<std::uint32_t>& requiredBits, std::span<const std::uint32_t> layoutBits, std::vector<std::uint32_t>* outOverflowingFields)
+{
+  bool bFits = true;
+  for (std::size_t f = 0; f < requiredBits.size(); ++f)
+  {
+    if (f >= layoutBits.size() || requiredBits[f] > layoutBits[f])
+    {
+      bFits = false;
+      if (outOverflowingFields)
+      {
+        outOverflowingFields->push_back((std::uint32_t)f);
+      }
+    }
+  }
+  return bFits;
+}
@@ -0,0 +1,266 @@
+#include "QuickTags-Index.hpp"
+
+#include <bit>
+#include <utility>
+
+using QTagUtil::TagPostingList;
+
+namespace
+{
+  constexpr std::size_t BitmapWords = 65536 / 64;
+
+  std::uint16_t GetHigh(const std::uint32_t id) { return std::uint16_t(id >> 16); }
+  std::uint16_t GetLow(const std::uint32_t id) { return std::uint16_t(id & 0xFFFF); }
+
+  bool TestBit(const std::vector<std::uint64_t>& bitmap, const std::uint16_t low)
+  {
+    return (bitmap[low / 64] >> (low % 64)) & 1;
+  }
+
+  // Appends (key << 16 | bit) for every set bit
+  void ExtractBits(const std::uint64_t* bitmap, const std::uint32_t key, std::vector<std::uint32_t>& outIds)
+  {
+    const std::uint32_t high = key << 16;
+    for (std::size_t w = 0; w < BitmapWords; ++w)
+    {
+      std::uint64_t bits = bitmap[w];
+      while (bits)
+      {
+        outIds.push_back(high | std::uint32_t(w * 64 + (std::size_t)std::countr_zero(bits)));
+        bits &= bits - 1; // Clear lowest set bit
+      }
+    }
+  }
+}
+
+bool TagPostingList::Add(const std::uint32_t id)
+{
+  const std::uint16_t high = GetHigh(id);
+  const std::uint16_t low = GetLow(id);
+
+  std::vector<Chunk>::iterator chunkIt = std::lower_bound(Chunks.begin(), Chunks.end(), high, [](const Chunk& chunk, const std::uint16_t key)
+    {
+      return chunk.Key < key;
+    });
+  if (chunkIt == Chunks.end() || chunkIt->Key != high)
+  {
+    chunkIt = Chunks.insert(chunkIt, Chunk{ high, 0, {}, {} });
+  }
+  Chunk& chunk = *chunkIt;
+
+  if (chunk.IsBitmap())
+  {
+    std::uint64_t& word = chunk.Bitmap[low / 64];
+    const std::uint64_t bit = std::uint64_t(1) << (low % 64);
+    if (word & bit)
+    {
+      return false;
+    }
+    word |= bit;
+  }
+  else
+  {
+    std::vector<std::uint16_t>::iterator it = std::lower_bound(chunk.Array.begin(), chunk.Array.end(), low);
+    if (it != chunk.Array.end() && *it == low)
+    {
+      return false;
+    }
+
+    if (chunk.Cardinality < MaxArrayCardinality)
+    {
+      chunk.Array.insert(it, low);
+    }
+    else
+    {
+      // Array would pass the size of a bitmap, switch over
+      chunk.Bitmap.assign(BitmapWords, 0);
+      for (const std::uint16_t existing : chunk.Array)
+      {
+        chunk.Bitmap[existing / 64] |= std::uint64_t(1) << (existing % 64);
+      }
+      chunk.Bitmap[low / 64] |= std::uint64_t(1) << (low % 64);
+      std::vector<std::uint16_t>().swap(chunk.Array);
+    }
+  }
+
+  ++chunk.Cardinality;
+  ++NumIds;
+  return true;
+}
+
+bool TagPostingList::Remove(const std::uint32_t id)
+{
+  const std::uint16_t high = GetHigh(id);
+  const std::uint16_t low = GetLow(id);
+
+  std::vector<Chunk>::iterator chunkIt = std::lower_bound(Chunks.begin(), Chunks.end(), high, [](const Chunk& chunk, const std::uint16_t key)
+    {
+      return chunk.Key < key;
+    });
+  if (chunkIt == Chunks.end() || chunkIt->Key != high)
+  {
+    return false;
+  }
+  Chunk& chunk = *chunkIt;
+
+  if (chunk.IsBitmap())
+  {
+    std::uint64_t& word = chunk.Bitmap[low / 64];
+    const std::uint64_t bit = std::uint64_t(1) << (low % 64);
+    if (!(word & bit))
+    {
+      return false;
+    }
+    word &= ~bit;
+
+    // Back to an array once it is no bigger than the bitmap
+    if (chunk.Cardinality - 1 <= MaxArrayCardinality)
+    {
+      chunk.Array.reserve(chunk.Cardinality - 1);
+      for (std::size_t w = 0; w < BitmapWords; ++w)
+      {
+        for (std::uint64_t bits = chunk.Bitmap[w]; bits; bits &= bits - 1)
+        {
+          chunk.Array.push_back(std::uint16_t(w * 64 + (std::size_t)std::countr_zero(bits)));
+        }
+      }
+      std::vector<std::uint64_t>().swap(chunk.Bitmap);
+    }
+  }
+  else
+  {
+    std::vector<std::uint16_t>::iterator it = std::lower_bound(chunk.Array.begin(), chunk.Array.end(), low);
+    if (it == chunk.Array.end() || *it != low)
+    {
+      return false;
+    }
+    chunk.Array.erase(it);
+  }
+
+  --NumIds;
+  if (--chunk.Cardinality == 0)
+  {
+    Chunks.erase(chunkIt);
+  }
+  return true;
+}
+
+bool TagPostingList::Contains(const std::uint32_t id) const
+{
+  const std::uint16_t high = GetHigh(id);
+  const std::uint16_t low = GetLow(id);
+
+  std::vector<Chunk>::const_iterator chunkIt = std::lower_bound(Chunks.begin(), Chunks.end(), high, [](const Chunk& chunk, const std::uint16_t key)
+    {
+      return chunk.Key < key;
+    });
+  if (chunkIt == Chunks.end() || chunkIt->Key != high)
+  {
+    return false;
+  }
+  if (chunkIt->IsBitmap())
+  {
+    return TestBit(chunkIt->Bitmap, low);
+  }
+  return std::binary_search(chunkIt->Array.begin(), chunkIt->Array.end(), low);
+}
+
+void TagPostingList::Reset()
+{
+  Chunks.clear();
+  NumIds = 0;
+}
+
+void TagPostingList::DecodeChunk(const Chunk& chunk, std::vector<std::uint32_t>& outIds)
+{
+  if (chunk.IsBitmap())
+  {
+    ExtractBits(chunk.Bitmap.data(), chunk.Key, outIds);
+    return;
+  }
+
+  const std::uint32_t high = std::uint32_t(chunk.Key) << 16;
+  for (const std::uint16_t low : chunk.Array)
+  {
+    outIds.push_back(high | low);
+  }
+}
+
+void TagPostingList::Decode(std::vector<std::uint32_t>& outIds) const
+{
+  outIds.reserve(outIds.size() + NumIds);
+  for (const Chunk& chunk : Chunks)
+  {
+    DecodeChunk(chunk, outIds);
+  }
+}
+
+std::size_t TagPostingList::GetMemoryUsage() const
+{
+  std::size_t bytes = Chunks.capacity() * sizeof(Chunk);
+  for (const Chunk& chunk : Chunks)
+  {
+    bytes += chunk.Array.capacity() * sizeof(std::uint16_t) + chunk.Bitmap.capacity() * sizeof(std::uint64_t);
+  }
+  return bytes;
+}
+
+void TagPostingList::Union(std::span<const TagPostingList* const> lists, std::vector<std::uint32_t>& outIds)
+{
+  // Every list's chunks, grouped by key, a key only one list has is decoded directly
+  std::vector<std::pair<std::uint16_t, const Chunk*>> chunks;
+  std::size_t maxIds = 0;
+  for (const TagPostingList* list : lists)
+  {
+    for (const Chunk& chunk : list->Chunks)
+    {
+      chunks.emplace_back(chunk.Key, &chunk);
+    }
+    maxIds += list->NumIds;
+  }
+  std::sort(chunks.begin(), chunks.end(), [](const std::pair<std::uint16_t, const Chunk*>& a, const std::pair<std::uint16_t, const Chunk*>& b)
+    {
+      return a.first < b.first;
+    });
+  outIds.reserve(outIds.size() + maxIds);
+
+  std::vector<std::uint64_t> scratch;
+  for (std::size_t groupStart = 0; groupStart < chunks.size(); )
+  {
+    std::size_t groupEnd = groupStart + 1;
+    while (groupEnd < chunks.size() && chunks[groupEnd].first == chunks[groupStart].first)
+    {
+      ++groupEnd;
+    }
+
+    if (groupEnd - groupStart == 1)
+    {
+      DecodeChunk(*chunks[groupStart].second, outIds);
+    }
+    else
+    {
+      // OR the group into one bitmap, which also drops IDs several lists share
+      scratch.assign(BitmapWords, 0);
+      for (std::size_t c = groupStart; c < groupEnd; ++c)
+      {
+        const Chunk& chunk = *chunks[c].second;
+        if (chunk.IsBitmap())
+        {
+          for (std::size_t w = 0; w < BitmapWords; ++w)
+          {
+            scratch[w] |= chunk.Bitmap[w];
+          }
+        }
+        else
+        {
+          for (const std::uint16_t low : chunk.Array)
+          {
+            scratch[low / 64] |= std::uint64_t(1) << (low % 64);
+          }
+        }
+      }
+      ExtractBits(scratch.data(), chunks[groupStart].first, outIds);
+    }
+    groupStart = groupEnd;
+  }
+}
@@ -0,0 +1,333 @@
+#include "QuickTags-Layout.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <numeric>
+
+using QTagUtil::TagTreeNode;
+using QTagUtil::LayoutReport;
+
+namespace
+{
+  constexpr std::uint32_t InvalidIndex = ~std::uint32_t(0);
+
+  // Tree in pre-order, so every subtree is the contiguous range [idx, SubtreeEnd)
+  struct LayoutNode
+  {
+    const TagTreeNode* Node;
+    std::uint32_t Parent;
+    std::uint32_t Depth;
+    std::uint32_t SubtreeEnd;
+    std::uint64_t MaxChildValue; // 0 for leaves
+  };
+
+  void FlattenTree(const std::list<TagTreeNode>& nodes, const std::uint32_t parentIdx, const std::uint32_t depth, std::vector<LayoutNode>& outNodes)
+  {
+    for (const TagTreeNode& node : nodes)
+    {
+      const std::uint32_t idx = (std::uint32_t)outNodes.size();
+      outNodes.push_back({ &node, parentIdx, depth, 0, 0 });
+      for (const TagTreeNode& subTag : node.SubTags)
+      {
+        outNodes[idx].MaxChildValue = std::max(outNodes[idx].MaxChildValue, subTag.TagAsInt);
+      }
+      FlattenTree(node.SubTags, idx, depth + 1, outNodes);
+      outNodes[idx].SubtreeEnd = (std::uint32_t)outNodes.size();
+    }
+  }
+
+  std::uint32_t GetBits(const std::uint64_t value)
+  {
+    return (std::uint32_t)std::bit_width(value);
+  }
+
+  void TrimLayout(std::vector<std::uint32_t>& layoutBits)
+  {
+    while (!layoutBits.empty() && layoutBits.back() == 0)
+    {
+      layoutBits.pop_back();
+    }
+  }
+
+  void Widen(std::vector<std::uint32_t>& layoutBits, const std::size_t field, const std::uint32_t bits)
+  {
+    if (layoutBits.size() <= field)
+    {
+      layoutBits.resize(field + 1, 0);
+    }
+    layoutBits[field] = std::max(layoutBits[field], bits);
+  }
+
+  // Bits per field for every tag outside [skipBegin, skipEnd), as GetRequiredBitsPerField would give
+  std::vector<std::uint32_t> GetLayoutExcluding(const std::vector<LayoutNode>& nodes, const std::uint32_t skipBegin, const std::uint32_t skipEnd)
+  {
+    std::vector<std::uint32_t> layoutBits;
+    for (std::uint32_t idx = 0; idx < (std::uint32_t)nodes.size(); ++idx)
+    {
+      if (idx >= skipBegin && idx < skipEnd)
+      {
+        continue;
+      }
+      Widen(layoutBits, nodes[idx].Depth, GetBits(nodes[idx].Node->TagAsInt));
+    }
+    TrimLayout(layoutBits);
+    return layoutBits;
+  }
+
+  std::uint32_t SumBits(const std::vector<std::uint32_t>& layoutBits)
+  {
+    return std::accumulate(layoutBits.begin(), layoutBits.end(), 0u);
+  }
+
+  std::string GetFullName(const std::vector<LayoutNode>& nodes, std::uint32_t idx)
+  {
+    std::string name = nodes[idx].Node->Tag;
+    for (idx = nodes[idx].Parent; idx != InvalidIndex; idx = nodes[idx].Parent)
+    {
+      name.insert(0, nodes[idx].Node->Tag + '.');
+    }
+    return name;
+  }
+
+  void ReportDepths(const std::vector<LayoutNode>& nodes, LayoutReport& outReport)
+  {
+    const std::size_t numDepths = outReport.LayoutBits.size();
+    outReport.Depths.assign(numDepths, QTagUtil::LayoutDepthReport());
+    for (std::size_t d = 0; d < numDepths; ++d)
+    {
+      outReport.Depths[d].FieldBits = outReport.LayoutBits[d];
+    }
+
+    std::vector<double> wastedSum(numDepths, 0.0);
+    std::vector<std::uint32_t> widestParent(numDepths, InvalidIndex);
+    std::vector<std::uint32_t> widestBits(numDepths, 0);
+    std::uint64_t maxRootValue = 0;
+    for (std::uint32_t idx = 0; idx < (std::uint32_t)nodes.size(); ++idx)
+    {
+      const LayoutNode& node = nodes[idx];
+      ++outReport.Depths[node.Depth].NumTags;
+      if (node.Parent == InvalidIndex)
+      {
+        maxRootValue = std::max(maxRootValue, node.Node->TagAsInt);
+      }
+      if (node.MaxChildValue == 0)
+      {
+        continue;
+      }
+
+      const std::size_t childDepth = node.Depth + 1;
+      QTagUtil::LayoutDepthReport& depth = outReport.Depths[childDepth];
+      const std::uint32_t childBits = GetBits(node.MaxChildValue);
+      ++depth.NumParents;
+      wastedSum[childDepth] += double(depth.FieldBits - childBits);
+      if (childBits > widestBits[childDepth])
+      {
+        depth.RunnerUpBits = widestBits[childDepth];
+        widestBits[childDepth] = childBits;
+        widestParent[childDepth] = idx;
+      }
+      else
+      {
+        depth.RunnerUpBits = std::max(depth.RunnerUpBits, childBits);
+      }
+    }
+
+    for (std::size_t d = 0; d < numDepths; ++d)
+    {
+      QTagUtil::LayoutDepthReport& depth = outReport.Depths[d];
+      if (d == 0)
+      {
+        depth.NumParents = 1;
+        wastedSum[0] = double(depth.FieldBits - GetBits(maxRootValue));
+      }
+      depth.MeanWastedBits = depth.NumParents > 0 ? wastedSum[d] / depth.NumParents : 0.0;
+      if (widestParent[d] != InvalidIndex)
+      {
+        depth.WidestParent = GetFullName(nodes, widestParent[d]);
+      }
+    }
+  }
+
+  // Parents setting each depth's width, and their ancestors, the only subtrees whose removal can
+  // narrow a field
+  std::vector<std::uint32_t> FindCandidates(const std::vector<LayoutNode>& nodes, const std::vector<std::uint32_t>& layoutBits)
+  {
+    constexpr std::size_t MaxWidestPerDepth = 16;
+    constexpr std::size_t MaxCandidates = 64;
+
+    std::vector<std::size_t> numWidest(layoutBits.size(), 0);
+    std::vector<bool> bCandidate(nodes.size(), false);
+    std::vector<std::uint32_t> candidates;
+    for (std::uint32_t idx = 0; idx < (std::uint32_t)nodes.size() && candidates.size() < MaxCandidates; ++idx)
+    {
+      const LayoutNode& node = nodes[idx];
+      const std::size_t childDepth = node.Depth + 1;
+      if (node.MaxChildValue == 0 || GetBits(node.MaxChildValue) != layoutBits[childDepth] || numWidest[childDepth] >= MaxWidestPerDepth)
+      {
+        continue;
+      }
+      ++numWidest[childDepth];
+      for (std::uint32_t ancestor = idx; ancestor != InvalidIndex && !bCandidate[ancestor]; ancestor = nodes[ancestor].Parent)
+      {
+        bCandidate[ancestor] = true;
+        candidates.push_back(ancestor);
+      }
+    }
+    return candidates;
+  }
+
+  void ProposeSplit(const std::vector<LayoutNode>& nodes, const std::uint32_t idx, const std::vector<std::uint32_t>& mainLayout, LayoutReport& outReport)
+  {
+    const LayoutNode& root = nodes[idx];
+    const QTagUtil::EQTagIntBase mainBase = QTagUtil::FindSmallestIntBase(mainLayout);
+    if (QTagUtil::GetIntBaseBytes(mainBase, mainLayout) >= QTagUtil::GetIntBaseBytes(outReport.Base, outReport.LayoutBits))
+    {
+      return;
+    }
+
+    QTagUtil::LayoutProposal proposal;
+    proposal.Kind = QTagUtil::ELayoutProposal::SplitSubtree;
+    proposal.Subtree = GetFullName(nodes, idx);
+    proposal.LayoutBits = mainLayout;
+    proposal.Base = mainBase;
+    for (std::uint32_t sub = idx + 1; sub < root.SubtreeEnd; ++sub)
+    {
+      Widen(proposal.SplitLayoutBits, nodes[sub].Depth - root.Depth - 1, GetBits(nodes[sub].Node->TagAsInt));
+    }
+    proposal.SplitBase = QTagUtil::FindSmallestIntBase(proposal.SplitLayoutBits);
+    proposal.NumTagsAffected = root.SubtreeEnd - idx - 1;
+    proposal.BytesBefore = outReport.NumTags * QTagUtil::GetIntBaseBytes(outReport.Base, outReport.LayoutBits);
+    proposal.BytesAfter = (outReport.NumTags - proposal.NumTagsAffected) * QTagUtil::GetIntBaseBytes(mainBase, mainLayout)
+      + proposal.NumTagsAffected * QTagUtil::GetIntBaseBytes(proposal.SplitBase, proposal.SplitLayoutBits);
+    // A big subtree in a wide type of its own can cost more than it saves
+    if (proposal.BytesAfter < proposal.BytesBefore)
+    {
+      outReport.Proposals.push_back(std::move(proposal));
+    }
+  }
+
+  void ProposeGrouping(const std::vector<LayoutNode>& nodes, const std::uint32_t idx, const std::vector<std::uint32_t>& otherLayout, LayoutReport& outReport)
+  {
+    const LayoutNode& parent = nodes[idx];
+    const std::uint32_t childBits = GetBits(parent.MaxChildValue);
+    const std::size_t baseBytes = QTagUtil::GetIntBaseBytes(outReport.Base, outReport.LayoutBits);
+
+    // Try every split of the children's bits between group and child, keep the smallest
+    QTagUtil::LayoutProposal best;
+    std::uint32_t bestBits = ~std::uint32_t(0);
+    for (std::uint32_t groupBits = 1; groupBits < childBits; ++groupBits)
+    {
+      const std::uint64_t maxGroups = (std::uint64_t(1) << groupBits) - 1;
+      const std::uint64_t perGroup = (parent.MaxChildValue + maxGroups - 1) / maxGroups;
+
+      std::vector<std::uint32_t> layoutBits = otherLayout;
+      Widen(layoutBits, parent.Depth + 1, groupBits);
+      Widen(layoutBits, parent.Depth + 2, GetBits(perGroup));
+      for (std::uint32_t sub = idx + 1; sub < parent.SubtreeEnd; ++sub)
+      {
+        if (nodes[sub].Depth > parent.Depth + 1)
+        {
+          Widen(layoutBits, nodes[sub].Depth + 1, GetBits(nodes[sub].Node->TagAsInt));
+        }
+      }
+
+      const std::uint32_t numBits = SumBits(layoutBits);
+      if (numBits < bestBits)
+      {
+        bestBits = numBits;
+        best.LayoutBits = std::move(layoutBits);
+        best.NumGroups = (std::uint32_t)((parent.MaxChildValue + perGroup - 1) / perGroup);
+      }
+    }
+    if (best.LayoutBits.empty())
+    {
+      return;
+    }
+
+    best.Kind = QTagUtil::ELayoutProposal::GroupChildren;
+    best.Subtree = GetFullName(nodes, idx);
+    best.Base = QTagUtil::FindSmallestIntBase(best.LayoutBits);
+    if (QTagUtil::GetIntBaseBytes(best.Base, best.LayoutBits) >= baseBytes)
+    {
+      return;
+    }
+    best.NumTagsAffected = parent.SubtreeEnd - idx - 1;
+    best.BytesBefore = outReport.NumTags * baseBytes;
+    best.BytesAfter = (outReport.NumTags + best.NumGroups) * QTagUtil::GetIntBaseBytes(best.Base, best.LayoutBits);
+    if (best.BytesAfter < best.BytesBefore)
+    {
+      outReport.Proposals.push_back(std::move(best));
+    }
+  }
+}
+
+std::size_t QTagUtil::GetIntBaseBytes(const EQTagIntBase base, const std::vector<std::uint32_t>& layoutBits)
+{
+  switch (base)
+  {
+  case EQTagIntBase::UInt8  : return 1;
+  case EQTagIntBase::UInt16 : return 2;
+  case EQTagIntBase::UInt32 : return 4;
+  case EQTagIntBase::UInt64 : return 8;
+  case EQTagIntBase::UInt128: return 16;
+  case EQTagIntBase::UInt256: return 32;
+  default:
+  case EQTagIntBase::UIntN  : return (SumBits(layoutBits) + 63) / 64 * 8;
+  }
+}
+
+void QTagUtil::AnalyseLayout(const std::list<TagTreeNode>& inTags, LayoutReport& outReport, const std::size_t maxSubtrees)
+{
+  outReport = LayoutReport();
+
+  std::vector<LayoutNode> nodes;
+  FlattenTree(inTags, InvalidIndex, 0, nodes);
+  if (nodes.empty())
+  {
+    return;
+  }
+
+  outReport.NumTags = nodes.size();
+  outReport.LayoutBits = GetLayoutExcluding(nodes, InvalidIndex, InvalidIndex);
+  outReport.UsedBits = SumBits(outReport.LayoutBits);
+  outReport.Base = FindSmallestIntBase(outReport.LayoutBits);
+  ReportDepths(nodes, outReport);
+
+  for (const std::uint32_t idx : FindCandidates(nodes, outReport.LayoutBits))
+  {
+    const LayoutNode& node = nodes[idx];
+    const std::vector<std::uint32_t> layoutWithout = GetLayoutExcluding(nodes, idx + 1, node.SubtreeEnd);
+
+    LayoutSubtree subtree;
+    subtree.Name = GetFullName(nodes, idx);
+    subtree.NumTags = node.SubtreeEnd - idx - 1;
+    subtree.BitsFreed = outReport.UsedBits - SumBits(layoutWithout);
+    if (subtree.BitsFreed > 0)
+    {
+      outReport.HeaviestSubtrees.push_back(std::move(subtree));
+    }
+
+    ProposeSplit(nodes, idx, layoutWithout, outReport);
+    if (GetBits(node.MaxChildValue) == outReport.LayoutBits[node.Depth + 1])
+    {
+      ProposeGrouping(nodes, idx, layoutWithout, outReport);
+    }
+  }
+
+  std::stable_sort(outReport.HeaviestSubtrees.begin(), outReport.HeaviestSubtrees.end(), [](const LayoutSubtree& lhs, const LayoutSubtree& rhs)
+    {
+      // Of two subtrees freeing the same bits, the smaller one is cheaper to move
+      return lhs.BitsFreed != rhs.BitsFreed ? lhs.BitsFreed > rhs.BitsFreed : lhs.NumTags < rhs.NumTags;
+    });
+  if (outReport.HeaviestSubtrees.size() > maxSubtrees)
+  {
+    outReport.HeaviestSubtrees.resize(maxSubtrees);
+  }
+
+  std::stable_sort(outReport.Proposals.begin(), outReport.Proposals.end(), [](const LayoutProposal& lhs, const LayoutProposal& rhs)
+    {
+      const std::uint64_t lhsSaving = lhs.BytesBefore - lhs.BytesAfter;
+      const std::uint64_t rhsSaving = rhs.BytesBefore - rhs.BytesAfter;
+      return lhsSaving != rhsSaving ? lhsSaving > rhsSaving : lhs.NumTagsAffected < rhs.NumTagsAffected;
+    });
+}
@@ -1,8 +1,12 @@
 #include "QuickTags-Loader.hpp"
+#include "QuickTags-MappedFile.hpp"
+#include "QuickTags-Simd.hpp"
 #include <bit>
 #include <numeric>
 #include <algorithm>
+#include <atomic>
 #include <cstdio>
+#include <thread>
 
 using QTagUtil::TagTreeNode;
 
@@ -12,11 +16,75 @@ using QTagUtil::TagTreeNode;
 #define QTAG_LOG(...)
 #endif
 
-void QTagUtil::BuildTagStringSetFromFiles(std::vector<std::fstream>& inFiles, std::set<std::string>& outStringSet, ETagSetFlags flags)
+namespace
 {
-  for (std::fstream& file : inFiles)
+  unsigned int ResolveNumThreads(const unsigned int numThreads, const std::size_t numItems)
   {
-    BuildTagStringSetFromFile(file, outStringSet, flags);
+    unsigned int resolved = numThreads != 0 ? numThreads : std::max(1u, std::thread::hardware_concurrency());
+    return (unsigned int)std::min<std::size_t>(resolved, std::max<std::size_t>(1, numItems));
+  }
+
+  // Calls func(item, threadIdx) for every item in [0, numItems), items are handed out one at a time
+  // so a few large files don't leave the other threads idle. Runs inline with one thread.
+  template<class Func>
+  void ParallelFor(const std::size_t numItems, const unsigned int numThreads, Func&& func)
+  {
+    if (numThreads <= 1)
+    {
+      for (std::size_t item = 0; item < numItems; ++item)
+      {
+        func(item, 0u);
+      }
+      return;
+    }
+
+    std::atomic<std::size_t> nextItem = 0;
+    auto worker = [&](const unsigned int threadIdx)
+      {
+        for (std::size_t item = nextItem++; item < numItems; item = nextItem++)
+        {
+          func(item, threadIdx);
+        }
+      };
+
+    std::vector<std::thread> threads;
+    threads.reserve(numThreads - 1);
+    for (unsigned int t = 1; t < numThreads; ++t)
+    {
+      threads.emplace_back(worker, t);
+    }
+    worker(0);
+    for (std::thread& thread : threads)
+    {
+      thread.join();
+    }
+  }
+}
+
+void QTagUtil::BuildTagStringSetFromFiles(std::vector<std::fstream>& inFiles, std::set<std::string>& outStringSet, ETagSetFlags flags, unsigned int numThreads)
+{
+  numThreads = ResolveNumThreads(numThreads, inFiles.size());
+  if (numThreads == 1)
+  {
+    for (std::fstream& file : inFiles)
+    {
+      BuildTagStringSetFromFile(file, outStringSet, flags);
+    }
+    return;
+  }
+
+  // Each thread fills its own set, a set's contents don't depend on insertion order so merging
+  // them gives the same result as the sequential path
+  std::vector<std::set<std::string>> threadSets(numThreads);
+  ParallelFor(inFiles.size(), numThreads, [&](const std::size_t fileIdx, const unsigned int threadIdx)
+    {
+      BuildTagStringSetFromFile(inFiles[fileIdx], threadSets[threadIdx], flags);
+    });
+
+  for (std::set<std::string>& threadSet : threadSets)
+  {
+    // Splices nodes across rather than copying strings
+    outStringSet.merge(threadSet);
   }
 }
 
@@ -51,107 +119,353 @@ void QTagUtil::BuildTagStringSetFromFile(std::fstream& inFile, std::set<std::str
   }
 }
 
-void SplitString(const std::string& inStr, std::vector<std::string>& outSubStrs)
+namespace
 {
-  std::stringstream ss(inStr);
+  // Splits on '.', matching std::getline semantics (a trailing empty segment is dropped)
+  void SplitString(const std::string_view inStr, std::vector<std::string_view>& outSubStrs)
+  {
+    outSubStrs.clear();
+    std::size_t segmentStart = 0;
+    for (std::size_t dot = inStr.find('.'); dot != std::string_view::npos; dot = inStr.find('.', segmentStart))
+    {
+      outSubStrs.push_back(inStr.substr(segmentStart, dot - segmentStart));
+      segmentStart = dot + 1;
+    }
+    if (segmentStart < inStr.size())
+    {
+      outSubStrs.push_back(inStr.substr(segmentStart));
+    }
+  }
 
-  for (std::string subStr; std::getline(ss, subStr, '.'); )
+  // Children of each node keyed by (parent, segment), parent is null for top-level nodes
+  // Keys view the nodes' own strings, which don't move since list nodes are stable
+  struct SubTagKey
   {
-    outSubStrs.push_back(subStr);
+    const TagTreeNode* Parent;
+    std::string_view Tag;
+
+    bool operator==(const SubTagKey& other) const
+    {
+      return Parent == other.Parent && Tag == other.Tag;
+    }
+  };
+
+  struct SubTagKeyHash
+  {
+    std::size_t operator()(const SubTagKey& key) const
+    {
+      return (std::size_t)QTagUtil::HashTagName(key.Tag, (std::uint64_t)(std::uintptr_t)key.Parent);
+    }
+  };
+
+  using SubTagIndex = std::unordered_map<SubTagKey, TagTreeNode*, SubTagKeyHash>;
+
+  void IndexSubTags(std::list<TagTreeNode>& subTags, const TagTreeNode* parent, SubTagIndex& outIndex)
+  {
+    for (TagTreeNode& node : subTags)
+    {
+      outIndex.try_emplace(SubTagKey{ parent, node.Tag }, &node);
+      IndexSubTags(node.SubTags, &node, outIndex);
+    }
+  }
+
+  template<class StringRange>
+  void TreeifyTagsImpl(const StringRange& inSortedTags, std::list<TagTreeNode>& outTagTrees)
+  {
+    // Hashed lookup rather than a linear search of each level, wide levels would otherwise be quadratic
+    SubTagIndex subTagIndex;
+    subTagIndex.reserve(inSortedTags.size());
+    IndexSubTags(outTagTrees, nullptr, subTagIndex);
+
+    std::vector<std::string_view> subStrings;
+    for (const std::string_view tagString : inSortedTags)
+    {
+      QTAG_LOG("Tag String: %.*s\n", (int)tagString.size(), tagString.data());
+      // Split tag string into components
+      SplitString(tagString, subStrings);
+
+      // Walk down the tree, adding new nodes as needed
+      TagTreeNode* node = nullptr;
+      for (const std::string_view subString : subStrings)
+      {
+        SubTagIndex::const_iterator it = subTagIndex.find(SubTagKey{ node, subString });
+        if (it != subTagIndex.end())
+        {
+          QTAG_LOG("\t%.*s seen before, switching to that node\n", (int)subString.size(), subString.data());
+          node = it->second;
+          continue;
+        }
+
+        QTAG_LOG("\t%.*s not seen before, emplacing below %s\n", (int)subString.size(), subString.data(), node ? node->Tag.c_str() : "root");
+        TagTreeNode* parentNode = node;
+        std::list<TagTreeNode>& subTags = parentNode ? parentNode->SubTags : outTagTrees;
+        node = &subTags.emplace_back(subString);
+        node->ParentTag = parentNode;
+        subTagIndex.emplace(SubTagKey{ parentNode, node->Tag }, node);
+      }
+    }
   }
 }
 
 void QTagUtil::TreeifyTags(const std::set<std::string>& inStringSet, std::list<TagTreeNode>& outTagTrees)
 {
-  for (const std::string& tagString : inStringSet)
+  TreeifyTagsImpl(inStringSet, outTagTrees);
+}
+
+void QTagUtil::TreeifyTags(std::span<const std::string_view> inSortedTags, std::list<TagTreeNode>& outTagTrees)
+{
+  TreeifyTagsImpl(inSortedTags, outTagTrees);
+}
+
+namespace
+{
+  // Bit i of outNewlines is set where block[i] == '\n', and of outWhitespace where block[i] is ' ' or '\t'
+  void ClassifyBlockScalar(const char* block, std::uint64_t& outNewlines, std::uint64_t& outWhitespace)
+  {
+    std::uint64_t newlines = 0;
+    std::uint64_t whitespace = 0;
+    for (int i = 0; i < 64; ++i)
+    {
+      newlines |= std::uint64_t(block[i] == '\n') << i;
+      whitespace |= std::uint64_t(block[i] == ' ' || block[i] == '\t') << i;
+    }
+    outNewlines = newlines;
+    outWhitespace = whitespace;
+  }
+
+#if QTAG_SIMD_X86
+  QTAG_TARGET("sse2") void ClassifyBlockSSE2(const char* block, std::uint64_t& outNewlines, std::uint64_t& outWhitespace)
   {
-    QTAG_LOG("Tag String: %s\n", tagString.c_str());
-    // Split tag string into components
-    std::vector<std::string> subStrings;
-    SplitString(tagString, subStrings);
+    const __m128i newline = _mm_set1_epi8('\n');
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i tab = _mm_set1_epi8('\t');
+    std::uint64_t newlines = 0;
+    std::uint64_t whitespace = 0;
+    for (int i = 0; i < 4; ++i)
+    {
+      const __m128i chars = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block) + i);
+      const __m128i isWhitespace = _mm_or_si128(_mm_cmpeq_epi8(chars, space), _mm_cmpeq_epi8(chars, tab));
+      newlines |= std::uint64_t((std::uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(chars, newline))) << (i * 16);
+      whitespace |= std::uint64_t((std::uint16_t)_mm_movemask_epi8(isWhitespace)) << (i * 16);
+    }
+    outNewlines = newlines;
+    outWhitespace = whitespace;
+  }
 
-    // Shouldn't happen, but guard against it anyway
-    if (subStrings.size() == 0)
+  QTAG_TARGET("avx2") void ClassifyBlockAVX2(const char* block, std::uint64_t& outNewlines, std::uint64_t& outWhitespace)
+  {
+    const __m256i newline = _mm256_set1_epi8('\n');
+    const __m256i space = _mm256_set1_epi8(' ');
+    const __m256i tab = _mm256_set1_epi8('\t');
+    std::uint64_t newlines = 0;
+    std::uint64_t whitespace = 0;
+    for (int i = 0; i < 2; ++i)
     {
-      continue;
+      const __m256i chars = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block) + i);
+      const __m256i isWhitespace = _mm256_or_si256(_mm256_cmpeq_epi8(chars, space), _mm256_cmpeq_epi8(chars, tab));
+      newlines |= std::uint64_t((std::uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(chars, newline))) << (i * 32);
+      whitespace |= std::uint64_t((std::uint32_t)_mm256_movemask_epi8(isWhitespace)) << (i * 32);
     }
-    
-    std::vector<std::string>::const_iterator subStrIt = subStrings.begin();
+    outNewlines = newlines;
+    outWhitespace = whitespace;
+  }
+#endif
+
+  struct LineSplitter
+  {
+    const char* Buffer;
+    std::vector<std::string_view>& OutLines;
+    std::size_t LineStart = 0;
+    bool bLineHasWhitespace = false;
 
-    // Check if top-level node exists
-    const std::string& first = *subStrIt;
-    std::list<TagTreeNode>::iterator tagTreeIt = std::find(outTagTrees.begin(), outTagTrees.end(), first);
-    if (tagTreeIt == outTagTrees.end())
+    void EmitLine(const std::size_t lineEnd, const bool bHasWhitespace)
     {
-      QTAG_LOG("%s top-level tag not seen before, creating\n", first.c_str());
+      std::size_t end = lineEnd;
+      if (end > LineStart && Buffer[end - 1] == '\r')
+      {
+        --end;
+      }
+      if (!bHasWhitespace && end > LineStart)
+      {
+        OutLines.emplace_back(Buffer + LineStart, end - LineStart);
+      }
+    }
 
-      // Create new top-level node
-      outTagTrees.emplace_back(subStrings[0]);
-      if (subStrings.size() == 1)
+    void ProcessBlock(const std::size_t blockStart, std::uint64_t newlines, std::uint64_t whitespace)
+    {
+      while (newlines)
       {
-        continue;
+        const int pos = std::countr_zero(newlines);
+        const std::uint64_t upToNewline = pos == 63 ? ~std::uint64_t(0) : (std::uint64_t(1) << (pos + 1)) - 1;
+        EmitLine(blockStart + pos, bLineHasWhitespace || (whitespace & upToNewline) != 0);
+
+        LineStart = blockStart + pos + 1;
+        bLineHasWhitespace = false;
+        whitespace &= ~upToNewline;
+        newlines &= newlines - 1;
       }
-      tagTreeIt = --outTagTrees.end();
+      bLineHasWhitespace |= whitespace != 0;
     }
+  };
+}
 
-    // Working sub-tag
-    std::list<TagTreeNode>::iterator subTagTreeIt;
+void QTagUtil::SplitTagLines(std::string_view inBuffer, std::vector<std::string_view>& outLines)
+{
+  using ClassifyFunc = void(*)(const char*, std::uint64_t&, std::uint64_t&);
+  ClassifyFunc classify = ClassifyBlockScalar;
+#if QTAG_SIMD_X86
+  switch (Simd::GetLevel())
+  {
+  case Simd::ELevel::AVX512:
+  case Simd::ELevel::AVX2: classify = ClassifyBlockAVX2; break;
+  case Simd::ELevel::SSE2: classify = ClassifyBlockSSE2; break;
+  default: break;
+  }
+#endif
 
-    // Starting values
-    TagTreeNode* node = &*tagTreeIt;
-    std::list<TagTreeNode>* subTags = &node->SubTags;
+  LineSplitter splitter = { inBuffer.data(), outLines };
+  const std::size_t size = inBuffer.size();
+  const std::size_t fullBlocksEnd = size - (size % 64);
+
+  std::uint64_t newlines;
+  std::uint64_t whitespace;
+  for (std::size_t blockStart = 0; blockStart < fullBlocksEnd; blockStart += 64)
+  {
+    classify(inBuffer.data() + blockStart, newlines, whitespace);
+    splitter.ProcessBlock(blockStart, newlines, whitespace);
+  }
+
+  // Pad the tail out to a block, zeroes are neither newlines nor whitespace
+  if (fullBlocksEnd < size)
+  {
+    char tail[64] = { 0 };
+    std::copy(inBuffer.begin() + fullBlocksEnd, inBuffer.end(), tail);
+    classify(tail, newlines, whitespace);
+    splitter.ProcessBlock(fullBlocksEnd, newlines, whitespace);
+  }
 
-    // For each substring, walk down the tree, adding new nodes as needed
-    for (++subStrIt; subStrIt != subStrings.end(); ++subStrIt)
+  // Last line may not end with a newline
+  if (splitter.LineStart < size)
+  {
+    splitter.EmitLine(size, splitter.bLineHasWhitespace);
+  }
+}
+
+namespace
+{
+  // Sorted, unique tag lines viewing mapped (or case folded) files, which are kept alive alongside
+  struct MappedTagLines
+  {
+    std::vector<QTagUtil::MappedFile> MappedFiles;
+    std::vector<std::string> FoldedFiles;
+    std::vector<std::string_view> Lines;
+
+    bool Load(const std::vector<std::string>& inPaths, QTagUtil::ETagSetFlags flags, unsigned int numThreads)
     {
-      // Does this sub-tag exist on this node?
-      QTAG_LOG("Current Node: %s\n", node->Tag.c_str());
-      QTAG_LOG("\tLooking for %s\n", subStrIt->c_str());
-      subTagTreeIt = std::find(subTags->begin(), subTags->end(), *subStrIt);
-      if (subTagTreeIt == subTags->end())
+      const bool bCaseInsensitive = (unsigned int)flags & (unsigned int)QTagUtil::ETagSetFlags::CaseInsensitive;
+      numThreads = ResolveNumThreads(numThreads, inPaths.size());
+
+      // Map, split and sort each file on its own, no shared state between files
+      MappedFiles.resize(inPaths.size());
+      FoldedFiles.resize(bCaseInsensitive ? inPaths.size() : 0);
+      std::vector<std::vector<std::string_view>> fileLines(inPaths.size());
+      std::atomic<bool> bFailed = false;
+      ParallelFor(inPaths.size(), numThreads, [&](const std::size_t i, unsigned int)
+        {
+          if (bFailed || !MappedFiles[i].Open(inPaths[i]))
+          {
+            bFailed = true;
+            return;
+          }
+
+          std::string_view fileView = MappedFiles[i].GetView();
+          if (bCaseInsensitive)
+          {
+            // Mapping is read-only, so folding takes one copy of the file
+            // NOTE: As with BuildTagStringSetFromFile, this only handles basic ascii
+            std::string& folded = FoldedFiles[i];
+            folded.assign(fileView);
+            std::transform(folded.begin(), folded.end(), folded.begin(), [](unsigned char c)
+              {
+                return (char)std::toupper(c);
+              });
+            fileView = folded;
+          }
+
+          std::vector<std::string_view>& lines = fileLines[i];
+          QTagUtil::SplitTagLines(fileView, lines);
+          std::sort(lines.begin(), lines.end());
+          lines.erase(std::unique(lines.begin(), lines.end()), lines.end());
+        });
+      if (bFailed)
       {
-        QTAG_LOG("\t%s not seen before, emplacing below %s\n", subStrIt->c_str(), node->Tag.c_str());
+        return false;
+      }
 
-        TagTreeNode* parentNode = node;
-        // Tag not seen before, add to list
-        node = &(subTags->emplace_back(*subStrIt));
-        node->ParentTag = parentNode;
-        QTAG_LOG("\tSetting %s's parent to be %s\n", node->Tag.c_str(), node->ParentTag->Tag.c_str());
-        
-        // Fast-path, add rest of sub strings going down from this node
-        for (++subStrIt; subStrIt != subStrings.end(); ++subStrIt)
+      // Pairwise merge rounds, always pairing neighbours so the result doesn't depend on timing
+      // Same order and uniqueness as inserting into a std::set<std::string>
+      while (fileLines.size() > 1)
+      {
+        const std::size_t numPairs = fileLines.size() / 2;
+        std::vector<std::vector<std::string_view>> merged((fileLines.size() + 1) / 2);
+        ParallelFor(numPairs, ResolveNumThreads(numThreads, numPairs), [&](const std::size_t pair, unsigned int)
+          {
+            const std::vector<std::string_view>& a = fileLines[pair * 2];
+            const std::vector<std::string_view>& b = fileLines[pair * 2 + 1];
+            std::vector<std::string_view>& out = merged[pair];
+            out.reserve(a.size() + b.size());
+            std::set_union(a.begin(), a.end(), b.begin(), b.end(), std::back_inserter(out));
+          });
+        if (fileLines.size() % 2)
         {
-          QTAG_LOG("\tEmplacing %s below %s\n", subStrIt->c_str(), node->Tag.c_str());
-
-          parentNode = node;
-          node = &(node->SubTags.emplace_back(*subStrIt));
-          node->ParentTag = parentNode;
-          QTAG_LOG("\tSetting %s's parent to be %s\n", node->Tag.c_str(), node->ParentTag->Tag.c_str());
+          merged.back() = std::move(fileLines.back());
         }
-        break;
+        fileLines = std::move(merged);
       }
-      else
-      {
-        QTAG_LOG("\t%s seen before, switching to that node\n", subTagTreeIt->Tag.c_str());
-        // Update working data
-        node = &*subTagTreeIt;
-        subTags = &node->SubTags;
 
-        // continue to next substring
-        continue;
+      if (!fileLines.empty())
+      {
+        Lines = std::move(fileLines.front());
       }
+      return true;
     }
+  };
+}
+
+bool QTagUtil::BuildTagTreeFromMappedFiles(const std::vector<std::string>& inPaths, std::list<TagTreeNode>& outTagTrees, ETagSetFlags flags, unsigned int numThreads)
+{
+  // Keep every mapping alive until the tree has copied out its segments
+  MappedTagLines tagLines;
+  if (!tagLines.Load(inPaths, flags, numThreads))
+  {
+    return false;
   }
+  TreeifyTags(std::span<const std::string_view>(tagLines.Lines), outTagTrees);
+  return true;
+}
+
+bool QTagUtil::BuildFlatTagTreeFromMappedFiles(const std::vector<std::string>& inPaths, FlatTagTree& outTagTree, ETagSetFlags flags, unsigned int numThreads)
+{
+  MappedTagLines tagLines;
+  if (!tagLines.Load(inPaths, flags, numThreads))
+  {
+    return false;
+  }
+  outTagTree.Build(std::span<const std::string_view>(tagLines.Lines));
+  return true;
+}
+
+bool QTagUtil::BuildTagTreeFromMappedFile(const std::string& inPath, std::list<TagTreeNode>& outTagTrees, ETagSetFlags flags)
+{
+  return BuildTagTreeFromMappedFiles({ inPath }, outTagTrees, flags);
 }
 
 void QTagUtil::EnumerateTags(std::list<TagTreeNode>& tags)
 {
-  for (int nodeIdx = 0; nodeIdx < tags.size(); ++nodeIdx)
+  std::uint64_t nodeIdx = 0;
+  for (TagTreeNode& node : tags)
   {
-    std::list<TagTreeNode>::iterator it = tags.begin();
-    std::advance(it, nodeIdx);
-    TagTreeNode& node = *it;
-    node.TagAsInt = nodeIdx + 1; // +1 since 0 denotes"None"/"Unset"
+    node.TagAsInt = ++nodeIdx; // +1 since 0 denotes"None"/"Unset"
     if (node.SubTags.size() > 0)
     {
       EnumerateTags(node.SubTags);
@@ -221,6 +535,28 @@ void QTagUtil::FindTagRanges(const std::list<TagTreeNode>& inTags, std::vector<u
   }
 }
 
+namespace
+{
+  void DescendTreeValues(const std::list<TagTreeNode>& nodes, const std::size_t depth, std::vector<std::uint32_t>& outRanges)
+  {
+    for (const TagTreeNode& node : nodes)
+    {
+      if (outRanges.size() <= depth)
+      {
+        outRanges.resize(depth + 1, 0);
+      }
+      outRanges[depth] = std::max(outRanges[depth], (std::uint32_t)node.TagAsInt);
+      DescendTreeValues(node.SubTags, depth + 1, outRanges);
+    }
+  }
+}
+
+void QTagUtil::FindTagValueRanges(const std::list<TagTreeNode>& inTags, std::vector<std::uint32_t>& outRanges)
+{
+  outRanges.clear();
+  DescendTreeValues(inTags, 0, outRanges);
+}
+
 void QTagUtil::GetRequiredBitsPerField(const std::vector<unsigned int>& fieldRanges, std::vector<unsigned int>& outBits)
 {
   for (const unsigned int field : fieldRanges)
@@ -232,17 +568,18 @@ void QTagUtil::GetRequiredBitsPerField(const std::vector<unsigned int>& fieldRan
 QTagUtil::EQTagIntBase QTagUtil::FindSmallestIntBase(const std::vector<unsigned int>& inBits)
 {
   unsigned int sumOfBits = std::accumulate(inBits.begin(), inBits.end(), 0);
-  unsigned int nextPow2 = std::bit_ceil(sumOfBits);
+  unsigned int nextPow2 = std::bit_ceil(std::max(sumOfBits, 8u));
 
   switch (nextPow2)
   {
-  case 8 : return EQTagIntBase::UInt8;
-  case 16: return EQTagIntBase::UInt16;
-  case 32: return EQTagIntBase::UInt32;
-  case 64: return EQTagIntBase::UInt64;
+  case 8  : return EQTagIntBase::UInt8;
+  case 16 : return EQTagIntBase::UInt16;
+  case 32 : return EQTagIntBase::UInt32;
+  case 64 : return EQTagIntBase::UInt64;
+  case 128: return EQTagIntBase::UInt128;
+  case 256: return EQTagIntBase::UInt256;
   }
-  // If you need more than 64 bits, add your own 128bit case
-  return EQTagIntBase::UInt64;
+  return EQTagIntBase::UIntN;
 }
 
 std::string QTagUtil::GetTemplateString(const EQTagIntBase base, const std::vector<unsigned int>& fieldBits)
@@ -255,8 +592,11 @@ std::string QTagUtil::GetTemplateString(const EQTagIntBase base, const std::vect
   case EQTagIntBase::UInt8 : ss << "std::uint8_t, " ; break;
   case EQTagIntBase::UInt16: ss << "std::uint16_t, "; break;
   case EQTagIntBase::UInt32: ss << "std::uint32_t, "; break;
-  default:
   case EQTagIntBase::UInt64: ss << "std::uint64_t, "; break;
+  case EQTagIntBase::UInt128: ss << "QTagUtil::UInt128, "; break;
+  case EQTagIntBase::UInt256: ss << "QTagUtil::UInt256, "; break;
+  default:
+  case EQTagIntBase::UIntN: ss << "QTagUtil::UIntN<" << (std::accumulate(fieldBits.begin(), fieldBits.end(), 0u) + 63) / 64 << ">, "; break;
   }
 
   for (size_t f = 0; f < fieldBits.size(); ++f)
@@ -0,0 +1,141 @@
+#include "QuickTags-MappedFile.hpp"
+
+#include <utility>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using QTagUtil::MappedFile;
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+{
+  *this = std::move(other);
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept
+{
+  if (this != &other)
+  {
+    Close();
+    std::swap(Data, other.Data);
+    std::swap(Size, other.Size);
+    std::swap(bOpen, other.bOpen);
+#ifdef _WIN32
+    std::swap(FileHandle, other.FileHandle);
+    std::swap(MappingHandle, other.MappingHandle);
+#endif
+  }
+  return *this;
+}
+
+bool MappedFile::Open(const std::string& path)
+{
+  Close();
+
+#ifdef _WIN32
+  HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+  if (file == INVALID_HANDLE_VALUE)
+  {
+    return false;
+  }
+
+  LARGE_INTEGER fileSize;
+  if (!GetFileSizeEx(file, &fileSize))
+  {
+    CloseHandle(file);
+    return false;
+  }
+
+  FileHandle = file;
+  bOpen = true;
+  if (fileSize.QuadPart == 0)
+  {
+    // Can't map an empty file, but it's still a valid (empty) file
+    return true;
+  }
+
+  HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  if (!mapping)
+  {
+    Close();
+    return false;
+  }
+  MappingHandle = mapping;
+
+  Data = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+  if (!Data)
+  {
+    Close();
+    return false;
+  }
+  Size = (std::size_t)fileSize.QuadPart;
+#else
+  const int fd = open(path.c_str(), O_RDONLY);
+  if (fd == -1)
+  {
+    return false;
+  }
+
+  struct stat fileStat;
+  if (fstat(fd, &fileStat) != 0)
+  {
+    close(fd);
+    return false;
+  }
+
+  bOpen = true;
+  if (fileStat.st_size > 0)
+  {
+    void* mapped = mmap(nullptr, (std::size_t)fileStat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (mapped == MAP_FAILED)
+    {
+      close(fd);
+      bOpen = false;
+      return false;
+    }
+    // Parsed front to back exactly once
+    madvise(mapped, (std::size_t)fileStat.st_size, MADV_SEQUENTIAL);
+    Data = static_cast<const char*>(mapped);
+    Size = (std::size_t)fileStat.st_size;
+  }
+  // Mapping keeps its own reference to the file
+  close(fd);
+#endif
+  return true;
+}
+
+void MappedFile::Close()
+{
+#ifdef _WIN32
+  if (Data)
+  {
+    UnmapViewOfFile(Data);
+  }
+  if (MappingHandle)
+  {
+    CloseHandle(MappingHandle);
+  }
+  if (FileHandle)
+  {
+    CloseHandle(FileHandle);
+  }
+  MappingHandle = nullptr;
+  FileHandle = nullptr;
+#else
+  if (Data)
+  {
+    munmap(const_cast<char*>(Data), Size);
+  }
+#endif
+  Data = nullptr;
+  Size = 0;
+  bOpen = false;
+}
@@ -0,0 +1,149 @@
+#include "QuickTags-Migration.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+#include <sstream>
+#include <unordered_map>
+
+namespace
+{
+  // Longest redirect covering name (the name itself or one of its ancestors), or null
+  const QTagUtil::TagRedirect* FindRedirect(const std::unordered_map<std::string_view, const QTagUtil::TagRedirect*>& redirectsByName, std::string_view name, std::size_t& outPrefixLength)
+  {
+    while (true)
+    {
+      const auto it = redirectsByName.find(name);
+      if (it != redirectsByName.end())
+      {
+        outPrefixLength = name.size();
+        return it->second;
+      }
+      const std::size_t lastDot = name.rfind('.');
+      if (lastDot == std::string_view::npos)
+      {
+        return nullptr;
+      }
+      name = name.substr(0, lastDot);
+    }
+  }
+}
+
+bool QTagUtil::ReadTagRedirects(std::istream& inStream, std::vector<TagRedirect>& outRedirects, ETagSetFlags flags)
+{
+  const bool bCaseInsensitive = (unsigned int)flags & (unsigned int)ETagSetFlags::CaseInsensitive;
+
+  for (std::string line; std::getline(inStream, line); )
+  {
+    std::istringstream ss(line);
+    std::string kind;
+    ss >> kind;
+    if (kind != "redirect")
+    {
+      continue;
+    }
+
+    TagRedirect redirect;
+    std::string extra;
+    if (!(ss >> redirect.From >> redirect.To) || (ss >> extra))
+    {
+      return false;
+    }
+    if (bCaseInsensitive)
+    {
+      // NOTE: As with BuildTagStringSetFromFile, this only handles basic ascii
+      for (std::string* name : { &redirect.From, &redirect.To })
+      {
+        std::transform(name->begin(), name->end(), name->begin(), [](unsigned char c)
+          {
+            return (char)std::toupper(c);
+          });
+      }
+    }
+    outRedirects.push_back(std::move(redirect));
+  }
+  return true;
+}
+
+bool QTagUtil::ReadTagRedirectsFromFiles(const std::vector<std::string>& inPaths, std::vector<TagRedirect>& outRedirects, ETagSetFlags flags)
+{
+  for (const std::string& path : inPaths)
+  {
+    std::ifstream file(path);
+    if (!file.is_open() || !ReadTagRedirects(file, outRedirects, flags))
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool QTagUtil::MatchTagNames(std::span<const std::string_view> oldNames, std::span<const std::string_view> newNames, std::span<const TagRedirect> redirects,
+  ERemovedTagPolicy policy, std::vector<std::uint32_t>& outNewIndices, std::vector<ETagRemapKind>& outKinds)
+{
+  outNewIndices.clear();
+  outKinds.clear();
+
+  std::unordered_map<std::string_view, std::uint32_t> newIndices;
+  newIndices.reserve(newNames.size());
+  for (std::size_t i = 0; i < newNames.size(); ++i)
+  {
+    newIndices.emplace(newNames[i], (std::uint32_t)i);
+  }
+
+  // In history order, latest wins. A redirect to a name means the name is live again, so it also
+  // drops any earlier redirect away from it (A -> B then B -> A leaves only B -> A)
+  std::unordered_map<std::string_view, const TagRedirect*> redirectsByName;
+  for (const TagRedirect& redirect : redirects)
+  {
+    redirectsByName.erase(redirect.To);
+    redirectsByName[redirect.From] = &redirect;
+  }
+
+  outNewIndices.reserve(oldNames.size());
+  outKinds.reserve(oldNames.size());
+  std::string name;
+  for (const std::string_view oldName : oldNames)
+  {
+    // Each redirect applies at most once in a chain that ends, so more steps than redirects left is a cycle
+    name.assign(oldName);
+    ETagRemapKind kind = ETagRemapKind::SameName;
+    std::size_t prefixLength = 0;
+    std::size_t numSteps = 0;
+    while (const TagRedirect* redirect = FindRedirect(redirectsByName, name, prefixLength))
+    {
+      if (++numSteps > redirectsByName.size())
+      {
+        outNewIndices.clear();
+        outKinds.clear();
+        return false;
+      }
+      name.replace(0, prefixLength, redirect->To);
+      kind = ETagRemapKind::Redirected;
+    }
+
+    std::string_view matchName = name;
+    auto it = newIndices.find(matchName);
+    if (it == newIndices.end() && policy == ERemovedTagPolicy::NearestAncestor)
+    {
+      for (std::size_t lastDot = matchName.rfind('.'); lastDot != std::string_view::npos && it == newIndices.end(); lastDot = matchName.rfind('.'))
+      {
+        matchName = matchName.substr(0, lastDot);
+        it = newIndices.find(matchName);
+      }
+      kind = it != newIndices.end() ? ETagRemapKind::Ancestor : kind;
+    }
+
+    if (it == newIndices.end())
+    {
+      outNewIndices.push_back(Migration::InvalidIndex);
+      outKinds.push_back(ETagRemapKind::Cleared);
+    }
+    else
+    {
+      outNewIndices.push_back(it->second);
+      outKinds.push_back(kind);
+    }
+  }
+  return true;
+}
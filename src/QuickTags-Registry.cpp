@@ -0,0 +1,389 @@
+#include "QuickTags-Registry.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <numeric>
+#include <unordered_map>
+
+using QTagUtil::TagRegistry;
+using QTagUtil::TagRegistryHeader;
+using QTagUtil::TagRegistryNode;
+using QTagUtil::TagTreeNode;
+
+namespace
+{
+  constexpr char RegistryMagic[4] = { 'Q', 'T', 'R', 'G' };
+
+  std::uint64_t AlignUp(const std::uint64_t value)
+  {
+    return (value + 7) & ~std::uint64_t(7);
+  }
+
+  // True if [offset, offset + size) lies within limit bytes, without the sum overflowing
+  bool FitsWithin(const std::uint64_t offset, const std::uint64_t size, const std::uint64_t limit)
+  {
+    return offset <= limit && size <= limit - offset;
+  }
+
+  // One pass over the nodes, so the accessors can trust them after Open. Parents come before their
+  // children (so there are no cycles), segments lie within the pool and each NameLength is its
+  // parent's plus the segment, which is what GetName writes by.
+  bool ValidateNodes(std::span<const TagRegistryNode> nodes, const std::uint64_t stringPoolSize)
+  {
+    for (std::uint32_t idx = 0; idx < nodes.size(); ++idx)
+    {
+      const TagRegistryNode& node = nodes[idx];
+      const bool bRoot = node.Parent == TagRegistryNode::InvalidIndex;
+      if (!bRoot && node.Parent >= idx)
+      {
+        return false;
+      }
+      const std::uint64_t nameLength = node.SegmentLength + (bRoot ? 0 : std::uint64_t(nodes[node.Parent].NameLength) + 1);
+      const bool bValid = node.NameLength == nameLength
+        && FitsWithin(node.SegmentOffset, node.SegmentLength, stringPoolSize)
+        && (node.FirstChild == TagRegistryNode::InvalidIndex || (node.FirstChild > idx && node.FirstChild < nodes.size()))
+        && (node.NextSibling == TagRegistryNode::InvalidIndex || (node.NextSibling > idx && node.NextSibling < nodes.size()));
+      if (!bValid)
+      {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  std::uint32_t GetBaseTypeBytes(const QTagUtil::EQTagIntBase base)
+  {
+    switch (base)
+    {
+    case QTagUtil::EQTagIntBase::UInt8 : return 1;
+    case QTagUtil::EQTagIntBase::UInt16: return 2;
+    case QTagUtil::EQTagIntBase::UInt32: return 4;
+    default:
+    // Registry values are read back as 64 bits, WriteTagRegistry rejects wider layouts
+    case QTagUtil::EQTagIntBase::UInt64: return 8;
+    }
+  }
+
+  struct RegistryBuilder
+  {
+    std::vector<std::uint32_t> FieldBits;
+    std::uint32_t BaseTypeBits = 0;
+
+    std::vector<std::uint64_t> Values;
+    std::vector<TagRegistryNode> Nodes;
+    std::string StringPool;
+    std::unordered_map<std::string_view, std::uint32_t> SegmentOffsets;
+
+    // Pre-order walk, which is also raw value order for an enumerated tree
+    void AddNodes(const std::list<TagTreeNode>& nodes, const std::uint64_t parentValue, const std::uint32_t depth, const std::uint32_t parentIdx)
+    {
+      std::uint32_t prevSiblingIdx = TagRegistryNode::InvalidIndex;
+      for (const TagTreeNode& node : nodes)
+      {
+        // Same packing as QuickTag::GenFieldOffsets, first field in the highest bits
+        std::uint32_t offset = BaseTypeBits;
+        for (std::uint32_t f = 0; f <= depth; ++f)
+        {
+          offset -= FieldBits[f];
+        }
+        const std::uint64_t value = parentValue | (node.TagAsInt << offset);
+
+        std::uint32_t segmentOffset;
+        std::unordered_map<std::string_view, std::uint32_t>::const_iterator it = SegmentOffsets.find(node.Tag);
+        if (it != SegmentOffsets.end())
+        {
+          segmentOffset = it->second;
+        }
+        else
+        {
+          segmentOffset = (std::uint32_t)StringPool.size();
+          StringPool.append(node.Tag);
+          SegmentOffsets.emplace(node.Tag, segmentOffset);
+        }
+
+        const std::uint32_t idx = (std::uint32_t)Nodes.size();
+        TagRegistryNode& registryNode = Nodes.emplace_back();
+        registryNode.Parent = parentIdx;
+        registryNode.FirstChild = TagRegistryNode::InvalidIndex;
+        registryNode.NextSibling = TagRegistryNode::InvalidIndex;
+        registryNode.SegmentOffset = segmentOffset;
+        registryNode.SegmentLength = (std::uint32_t)node.Tag.size();
+        registryNode.NameLength = registryNode.SegmentLength + (parentIdx == TagRegistryNode::InvalidIndex ? 0 : Nodes[parentIdx].NameLength + 1);
+        Values.push_back(value);
+
+        if (prevSiblingIdx != TagRegistryNode::InvalidIndex)
+        {
+          Nodes[prevSiblingIdx].NextSibling = idx;
+        }
+        else if (parentIdx != TagRegistryNode::InvalidIndex)
+        {
+          Nodes[parentIdx].FirstChild = idx;
+        }
+        prevSiblingIdx = idx;
+
+        AddNodes(node.SubTags, value, depth + 1, idx);
+      }
+    }
+  };
+
+  template<class T>
+  void WriteValues(std::ofstream& file, const std::vector<std::uint64_t>& values)
+  {
+    for (const std::uint64_t value : values)
+    {
+      const T narrowed = (T)value;
+      file.write(reinterpret_cast<const char*>(&narrowed), sizeof(T));
+    }
+  }
+
+  void WritePadding(std::ofstream& file, const std::uint64_t toOffset)
+  {
+    static const char zeroes[8] = { 0 };
+    const std::uint64_t pos = (std::uint64_t)file.tellp();
+    if (toOffset > pos)
+    {
+      file.write(zeroes, (std::streamsize)(toOffset - pos));
+    }
+  }
+}
+
+bool QTagUtil::ComputeTagFilesChecksum(const std::vector<std::string>& inPaths, std::uint64_t& outChecksum)
+{
+  std::uint64_t checksum = HashTagName(std::string_view(), TagRegistryVersion);
+  for (const std::string& path : inPaths)
+  {
+    MappedFile file;
+    if (!file.Open(path))
+    {
+      return false;
+    }
+    // Chain file hashes so that moving content between files still changes the result
+    checksum = HashTagName(file.GetView(), checksum ^ file.GetSize());
+  }
+  outChecksum = checksum;
+  return true;
+}
+
+bool QTagUtil::WriteTagRegistry(const std::string& outPath, const std::list<TagTreeNode>& inTagTrees, std::uint64_t sourceChecksum, ETagSetFlags flags, std::span<const std::uint32_t> layoutFieldBits)
+{
+  // Value ranges rather than sibling counts, stable enumeration can leave gaps
+  std::vector<unsigned int> ranges;
+  FindTagValueRanges(inTagTrees, ranges);
+
+  RegistryBuilder builder;
+  GetRequiredBitsPerField(ranges, builder.FieldBits);
+  if (!layoutFieldBits.empty())
+  {
+    // An explicit layout has to hold every value, and is used as is so packed values don't move
+    for (std::size_t f = 0; f < builder.FieldBits.size(); ++f)
+    {
+      if (f >= layoutFieldBits.size() || builder.FieldBits[f] > layoutFieldBits[f])
+      {
+        return false;
+      }
+    }
+    builder.FieldBits.assign(layoutFieldBits.begin(), layoutFieldBits.end());
+  }
+  if (std::accumulate(builder.FieldBits.begin(), builder.FieldBits.end(), 0u) > 64)
+  {
+    return false;
+  }
+  const EQTagIntBase base = FindSmallestIntBase(builder.FieldBits);
+  const std::uint32_t baseTypeBytes = GetBaseTypeBytes(base);
+  builder.BaseTypeBits = baseTypeBytes * 8;
+  builder.AddNodes(inTagTrees, 0, 0, TagRegistryNode::InvalidIndex);
+
+  TagRegistryHeader header = {};
+  std::memcpy(header.Magic, RegistryMagic, sizeof(RegistryMagic));
+  header.Version = TagRegistryVersion;
+  header.SourceChecksum = sourceChecksum;
+  header.Flags = (std::uint32_t)flags;
+  header.BaseTypeBytes = baseTypeBytes;
+  header.NumFields = (std::uint32_t)builder.FieldBits.size();
+  header.NumTags = (std::uint32_t)builder.Values.size();
+  header.FieldBitsOffset = AlignUp(sizeof(TagRegistryHeader));
+  header.TagsOffset = AlignUp(header.FieldBitsOffset + header.NumFields);
+  header.NodesOffset = AlignUp(header.TagsOffset + (std::uint64_t)header.NumTags * baseTypeBytes);
+  header.StringPoolOffset = AlignUp(header.NodesOffset + (std::uint64_t)header.NumTags * sizeof(TagRegistryNode));
+  header.StringPoolSize = builder.StringPool.size();
+  header.FileSize = header.StringPoolOffset + header.StringPoolSize;
+
+  const std::string tempPath = outPath + ".tmp";
+  {
+    std::ofstream file(tempPath, std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
+    if (!file.is_open())
+    {
+      return false;
+    }
+
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    WritePadding(file, header.FieldBitsOffset);
+    for (const std::uint32_t bits : builder.FieldBits)
+    {
+      file.put((char)bits);
+    }
+
+    WritePadding(file, header.TagsOffset);
+    switch (baseTypeBytes)
+    {
+    case 1: WriteValues<std::uint8_t>(file, builder.Values); break;
+    case 2: WriteValues<std::uint16_t>(file, builder.Values); break;
+    case 4: WriteValues<std::uint32_t>(file, builder.Values); break;
+    default: WriteValues<std::uint64_t>(file, builder.Values); break;
+    }
+
+    WritePadding(file, header.NodesOffset);
+    file.write(reinterpret_cast<const char*>(builder.Nodes.data()), (std::streamsize)(builder.Nodes.size() * sizeof(TagRegistryNode)));
+
+    WritePadding(file, header.StringPoolOffset);
+    file.write(builder.StringPool.data(), (std::streamsize)builder.StringPool.size());
+
+    if (!file.good())
+    {
+      return false;
+    }
+  }
+
+  std::error_code error;
+  std::filesystem::rename(tempPath, outPath, error);
+  return !error;
+}
+
+bool TagRegistry::Open(const std::string& path)
+{
+  Close();
+  if (!File.Open(path) || File.GetSize() < sizeof(TagRegistryHeader))
+  {
+    File.Close();
+    return false;
+  }
+
+  // Validate once up front, accessors trust the header and nodes after this
+  const TagRegistryHeader* header = reinterpret_cast<const TagRegistryHeader*>(File.GetData());
+  const std::uint64_t bytes = header->BaseTypeBytes;
+  const std::uint64_t fileSize = File.GetSize();
+  const bool bValidHeader = std::memcmp(header->Magic, RegistryMagic, sizeof(RegistryMagic)) == 0
+    && header->Version == TagRegistryVersion
+    && header->FileSize == fileSize
+    && (bytes == 1 || bytes == 2 || bytes == 4 || bytes == 8)
+    && FitsWithin(header->FieldBitsOffset, header->NumFields, header->TagsOffset)
+    && FitsWithin(header->TagsOffset, header->NumTags * bytes, header->NodesOffset)
+    && FitsWithin(header->NodesOffset, header->NumTags * sizeof(TagRegistryNode), header->StringPoolOffset)
+    && FitsWithin(header->StringPoolOffset, header->StringPoolSize, fileSize)
+    && (header->TagsOffset % 8) == 0 && (header->NodesOffset % 8) == 0;
+  const bool bValid = bValidHeader && ValidateNodes(std::span<const TagRegistryNode>(
+    reinterpret_cast<const TagRegistryNode*>(File.GetData() + header->NodesOffset), header->NumTags), header->StringPoolSize);
+  if (!bValid)
+  {
+    File.Close();
+    return false;
+  }
+
+  Header = header;
+  return true;
+}
+
+void TagRegistry::Close()
+{
+  Header = nullptr;
+  File.Close();
+}
+
+QTagUtil::EQTagIntBase TagRegistry::GetIntBase() const
+{
+  switch (Header->BaseTypeBytes)
+  {
+  case 1: return EQTagIntBase::UInt8;
+  case 2: return EQTagIntBase::UInt16;
+  case 4: return EQTagIntBase::UInt32;
+  default: return EQTagIntBase::UInt64;
+  }
+}
+
+std::span<const std::uint8_t> TagRegistry::GetFieldBits() const
+{
+  if (!Header)
+  {
+    return {};
+  }
+  return std::span<const std::uint8_t>(reinterpret_cast<const std::uint8_t*>(File.GetData() + Header->FieldBitsOffset), Header->NumFields);
+}
+
+std::span<const TagRegistryNode> TagRegistry::GetNodes() const
+{
+  return std::span<const TagRegistryNode>(reinterpret_cast<const TagRegistryNode*>(File.GetData() + Header->NodesOffset), Header->NumTags);
+}
+
+std::string_view TagRegistry::GetSegment(const std::uint32_t idx) const
+{
+  const TagRegistryNode& node = GetNodes()[idx];
+  return std::string_view(File.GetData() + Header->StringPoolOffset + node.SegmentOffset, node.SegmentLength);
+}
+
+std::string_view TagRegistry::GetName(const std::uint32_t idx, std::span<char> buffer) const
+{
+  const std::span<const TagRegistryNode> nodes = GetNodes();
+  const std::uint32_t nameLength = nodes[idx].NameLength;
+  if (nameLength + 1 > buffer.size())
+  {
+    return std::string_view();
+  }
+
+  buffer[nameLength] = '\0';
+  std::size_t writePos = nameLength;
+  for (std::uint32_t nodeIdx = idx; nodeIdx != TagRegistryNode::InvalidIndex; nodeIdx = nodes[nodeIdx].Parent)
+  {
+    const std::string_view segment = GetSegment(nodeIdx);
+    writePos -= segment.size();
+    std::copy(segment.begin(), segment.end(), buffer.begin() + writePos);
+    if (writePos > 0)
+    {
+      buffer[--writePos] = '.';
+    }
+  }
+  return std::string_view(buffer.data(), nameLength);
+}
+
+std::uint64_t TagRegistry::GetRawValue(const std::uint32_t idx) const
+{
+  const char* values = File.GetData() + Header->TagsOffset;
+  switch (Header->BaseTypeBytes)
+  {
+  case 1: return reinterpret_cast<const std::uint8_t*>(values)[idx];
+  case 2: return reinterpret_cast<const std::uint16_t*>(values)[idx];
+  case 4: return reinterpret_cast<const std::uint32_t*>(values)[idx];
+  default: return reinterpret_cast<const std::uint64_t*>(values)[idx];
+  }
+}
+
+bool QTagUtil::LoadOrBuildTagRegistry(const std::string& registryPath, const std::vector<std::string>& tagFiles, TagRegistry& outRegistry, ETagSetFlags flags)
+{
+  std::uint64_t checksum;
+  if (!ComputeTagFilesChecksum(tagFiles, checksum))
+  {
+    return false;
+  }
+
+  if (outRegistry.Open(registryPath) && outRegistry.GetSourceChecksum() == checksum && outRegistry.GetFlags() == flags)
+  {
+    return true;
+  }
+  outRegistry.Close();
+
+  // Missing or stale, rebuild
+  std::list<TagTreeNode> tagTrees;
+  if (!BuildTagTreeFromMappedFiles(tagFiles, tagTrees, flags))
+  {
+    return false;
+  }
+  EnumerateTags(tagTrees);
+
+  if (!WriteTagRegistry(registryPath, tagTrees, checksum, flags))
+  {
+    return false;
+  }
+  return outRegistry.Open(registryPath);
+}
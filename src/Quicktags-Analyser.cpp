@@ -1,16 +1,82 @@
 #include "QuickTags.hpp"
 #include "QuickTags-Loader.hpp"
+#include "QuickTags-LoadStats.hpp"
+#include "QuickTags-IdManifest.hpp"
+#include "QuickTags-Registry.hpp"
+#include "QuickTags-Layout.hpp"
 
+#include <algorithm>
 #include <cstdio>
 #include <fstream>
 #include <string>
 
+// Lets -stats report allocations per stage
+QTAG_DEFINE_ALLOCATION_TRACKING();
+
+namespace
+{
+  void PrintLayoutReport(const QTagUtil::LayoutReport& report)
+  {
+    using namespace QTagUtil;
+
+    const std::size_t baseBits = GetIntBaseBytes(report.Base, report.LayoutBits) * 8;
+    printf("Layout: %u of %zu bits used, %zu tags, %zu bytes per tag\n", report.UsedBits, baseBits, report.NumTags, GetIntBaseBytes(report.Base, report.LayoutBits));
+    for (std::size_t d = 0; d < report.Depths.size(); ++d)
+    {
+      const LayoutDepthReport& depth = report.Depths[d];
+      printf("  Depth %zu: %2u bits, %8u tags, %8u parents, %5.2f mean wasted bits", d, depth.FieldBits, depth.NumTags, depth.NumParents, depth.MeanWastedBits);
+      if (!depth.WidestParent.empty())
+      {
+        printf(", widest %s (next widest needs %u bits)", depth.WidestParent.c_str(), depth.RunnerUpBits);
+      }
+      printf("\n");
+    }
+
+    if (!report.HeaviestSubtrees.empty())
+    {
+      printf("Heaviest subtrees:\n");
+      for (const LayoutSubtree& subtree : report.HeaviestSubtrees)
+      {
+        printf("  %s: %zu descendants, %u bits freed without them\n", subtree.Name.c_str(), subtree.NumTags, subtree.BitsFreed);
+      }
+    }
+
+    if (report.Proposals.empty())
+    {
+      printf("No layout change fits a smaller base type\n");
+      return;
+    }
+    printf("Layout proposals:\n");
+    for (const LayoutProposal& proposal : report.Proposals)
+    {
+      const double savedPercent = 100.0 * double(proposal.BytesBefore - proposal.BytesAfter) / double(proposal.BytesBefore);
+      if (proposal.Kind == ELayoutProposal::SplitSubtree)
+      {
+        printf("  Split %s (%zu tags) into its own tag type\n", proposal.Subtree.c_str(), proposal.NumTagsAffected);
+        printf("    Main:  %s\n", GetTemplateString(proposal.Base, proposal.LayoutBits).c_str());
+        printf("    Split: %s\n", GetTemplateString(proposal.SplitBase, proposal.SplitLayoutBits).c_str());
+      }
+      else
+      {
+        printf("  Group the children of %s under %u new group tags (%zu tags renamed)\n", proposal.Subtree.c_str(), proposal.NumGroups, proposal.NumTagsAffected);
+        printf("    %s\n", GetTemplateString(proposal.Base, proposal.LayoutBits).c_str());
+      }
+      printf("    %llu -> %llu bytes for one of every tag, %.1f%% saved\n", (unsigned long long)proposal.BytesBefore, (unsigned long long)proposal.BytesAfter, savedPercent);
+    }
+  }
+}
+
 int main(int argc, char** argv)
 {
   using namespace QTagUtil;
 
   std::vector<std::string> tagsFiles;
+  std::string registryFile;
+  std::string manifestFile;
+  unsigned int numThreads = 1;
   bool bCaseInsensitive = false;
+  bool bStats = false;
+  bool bLayoutReport = false;
 
   for (int i = 0; i < argc; ++i)
   {
@@ -41,11 +107,66 @@ int main(int argc, char** argv)
       }
     } // end -f
 
+    if (arg == "-registry" || arg == "-manifest")
+    {
+      if (i + 1 < argc)
+      {
+        ++i;
+        std::string nextArg = argv[i];
+        if (char firstChar = *nextArg.begin())
+        {
+          if (firstChar == '-')
+          {
+            printf("%s param missing or invalid (%s)", arg.c_str(), nextArg.c_str());
+            return -1;
+          }
+        }
+        printf("%s", argv[i]);
+        (arg == "-registry" ? registryFile : manifestFile) = nextArg;
+      }
+      else
+      {
+        printf("%s param but no file provided", arg.c_str());
+        return -1;
+      }
+    } // end -registry/-manifest
+
+    if (arg == "-j")
+    {
+      if (i + 1 < argc)
+      {
+        ++i;
+        std::string nextArg = argv[i];
+        if (nextArg.empty() || nextArg.find_first_not_of("0123456789") != std::string::npos)
+        {
+          printf("Thread count param missing or invalid (%s)", nextArg.c_str());
+          return -1;
+        }
+        printf("%s", argv[i]);
+        numThreads = (unsigned int)std::stoul(nextArg); // 0 for one per hardware thread
+      }
+      else
+      {
+        printf("-j param but no thread count provided");
+        return -1;
+      }
+    } // end -j
+
     if (arg == "-case-insensitive")
     {
       bCaseInsensitive = true;
     }
 
+    if (arg == "-stats")
+    {
+      bStats = true;
+    }
+
+    if (arg == "-layout")
+    {
+      bLayoutReport = true;
+    }
+
     printf("\n");
   }
 
@@ -76,8 +197,20 @@ int main(int argc, char** argv)
     flags = (ETagSetFlags)((unsigned int)flags | (unsigned int)ETagSetFlags::CaseInsensitive);
   }
 
+  // Printed as each stage finishes, so the stages that did run still show if a later one fails
+  LoadStats stats;
+  stats.OnStageComplete = [](const LoadStageStats& stage)
+    {
+      printf("Stage %-28s %10.3f ms %10llu allocs %12llu peak bytes %12lld retained bytes\n", stage.Stage, stage.Milliseconds,
+        (unsigned long long)stage.NumAllocations, (unsigned long long)stage.PeakBytes, (long long)stage.RetainedBytes);
+    };
+  LoadStats* const statsPtr = bStats ? &stats : nullptr;
+
   std::set<std::string> tagStringSet;
-  BuildTagStringSetFromFiles(files, tagStringSet, flags);
+  {
+    ScopedLoadStage stage(statsPtr, "BuildTagStringSetFromFiles");
+    BuildTagStringSetFromFiles(files, tagStringSet, flags, numThreads);
+  }
 
   if (tagStringSet.size() == 0)
   {
@@ -93,20 +226,113 @@ int main(int argc, char** argv)
 
   // Build tree of tags
   std::list<TagTreeNode> tagTrees;
-  TreeifyTags(tagStringSet, tagTrees);
+  {
+    ScopedLoadStage stage(statsPtr, "TreeifyTags");
+    TreeifyTags(tagStringSet, tagTrees);
+  }
 
-  // Enumerate (not necessary for analysis)
-  EnumerateTags(tagTrees);
+  // Enumerate, keeping the values from a previous run if there's a manifest
+  TagIdManifest manifest;
+  if (!manifestFile.empty())
+  {
+    if (!manifest.ReadFile(manifestFile))
+    {
+      printf("Failed to read manifest %s\n", manifestFile.c_str());
+      return -5;
+    }
+    StableEnumerateStats enumerateStats;
+    {
+      ScopedLoadStage stage(statsPtr, "EnumerateTagsStable");
+      EnumerateTagsStable(tagTrees, manifest, &enumerateStats);
+    }
+    printf("Stable IDs: %d kept, %d added, %d revived, %d removed\n", (int)enumerateStats.NumKept, (int)enumerateStats.NumAdded, (int)enumerateStats.NumRevived, (int)enumerateStats.NumRemoved);
+  }
+  else
+  {
+    ScopedLoadStage stage(statsPtr, "EnumerateTags");
+    EnumerateTags(tagTrees);
+  }
 
   std::vector<unsigned int> ranges;
-  FindTagRanges(tagTrees, ranges);
+  {
+    ScopedLoadStage stage(statsPtr, "FindTagValueRanges");
+    FindTagValueRanges(tagTrees, ranges);
+  }
 
   std::vector<unsigned int> requiredBitsPerField;
   GetRequiredBitsPerField(ranges, requiredBitsPerField);
 
+  // A manifest's layout is kept while the tags fit it, changing any field width moves every packed value
+  std::vector<unsigned int> layoutBits = requiredBitsPerField;
+  bool bLayoutOverflow = false;
+  if (!manifestFile.empty() && !manifest.GetLayout().empty())
+  {
+    const std::vector<unsigned int>& oldLayout = manifest.GetLayout();
+    std::vector<unsigned int> overflowingFields;
+    if (FitsLayout(requiredBitsPerField, oldLayout, &overflowingFields))
+    {
+      layoutBits = oldLayout;
+    }
+    else
+    {
+      bLayoutOverflow = true;
+      for (const unsigned int field : overflowingFields)
+      {
+        printf("Layout overflow: field %u needs %u bits but the current layout has %u\n", field, requiredBitsPerField[field], field < oldLayout.size() ? oldLayout[field] : 0);
+      }
+      printf("The current QTag layout can no longer fit the tags, packed values will change\n");
+
+      // Only widen, so the change is as small as it can be
+      for (size_t f = 0; f < oldLayout.size(); ++f)
+      {
+        if (f < layoutBits.size())
+        {
+          layoutBits[f] = std::max(layoutBits[f], oldLayout[f]);
+        }
+        else
+        {
+          layoutBits.push_back(oldLayout[f]);
+        }
+      }
+    }
+  }
+
   // Output template configuration
-  std::string usingString = GetTemplateString(FindSmallestIntBase(requiredBitsPerField), requiredBitsPerField);
+  std::string usingString = GetTemplateString(FindSmallestIntBase(layoutBits), layoutBits);
   printf("Recommended QTag Configuration:\n%s\n", usingString.c_str());
 
-  return 0;
+  if (bLayoutReport)
+  {
+    LayoutReport layoutReport;
+    {
+      ScopedLoadStage stage(statsPtr, "AnalyseLayout");
+      AnalyseLayout(tagTrees, layoutReport);
+    }
+    PrintLayoutReport(layoutReport);
+  }
+
+  if (!manifestFile.empty())
+  {
+    manifest.SetLayout(layoutBits);
+    if (!manifest.WriteFile(manifestFile))
+    {
+      printf("Failed to write manifest %s\n", manifestFile.c_str());
+      return -5;
+    }
+    printf("Wrote manifest %s\n", manifestFile.c_str());
+  }
+
+  // Optionally precompile the tags so programs can map them instead of parsing text at startup
+  if (!registryFile.empty())
+  {
+    std::uint64_t checksum;
+    if (!ComputeTagFilesChecksum(tagsFiles, checksum) || !WriteTagRegistry(registryFile, tagTrees, checksum, flags, layoutBits))
+    {
+      printf("Failed to write registry %s\n", registryFile.c_str());
+      return -4;
+    }
+    printf("Wrote registry %s\n", registryFile.c_str());
+  }
+
+  return bLayoutOverflow ? -6 : 0;
 }
\ No newline at end of file
@@ -0,0 +1,595 @@
+#include "QuickTags.hpp"
+#include "QuickTags-Simd.hpp"
+#include "QuickTags-Format.hpp"
+#include "QuickTags-Codec.hpp"
+#include "QuickTags-Map.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <random>
+#include <string>
+#include <system_error>
+#include <vector>
+
+// Microbenchmarks for the core QuickTag operations, formatting, tag maps and tag set encoding,
+// written out as JSON for regression tracking.
+//
+// Every layout gets the same operations over the same number of tags. Tag sets come from a fixed
+// seed through std::mt19937_64 and plain modulo (the std distributions differ between standard
+// libraries), so every build benchmarks identical data. Each benchmark is calibrated to run for at
+// least -min-time ms per repetition, and reports the median, min and max ns per op over -reps
+// repetitions.
+
+namespace
+{
+  constexpr std::size_t TagsPerPass = 4096;
+
+  struct BenchConfig
+  {
+    std::uint64_t Seed = 1;
+    unsigned int Reps = 10;
+    double MinRepMs = 20.0;
+    std::string Filter;
+  };
+
+  struct BenchResult
+  {
+    std::string Name;
+    std::string Op;
+    std::string Layout;
+    double MedianNsPerOp;
+    double MinNsPerOp;
+    double MaxNsPerOp;
+    std::uint64_t OpsPerRep;
+  };
+
+  // Keeps value (and everything it depends on) from being optimised away
+  template<class T>
+  void DoNotOptimize(const T& value)
+  {
+#if defined(_MSC_VER) && !defined(__clang__)
+    static volatile char sink;
+    sink = *reinterpret_cast<const volatile char*>(&value);
+#else
+    asm volatile("" : : "g"(&value) : "memory");
+#endif
+  }
+
+  template<class BaseType>
+  const char* GetBaseTypeName()
+  {
+    if constexpr (std::is_same_v<BaseType, std::uint8_t>) return "uint8_t";
+    else if constexpr (std::is_same_v<BaseType, std::uint16_t>) return "uint16_t";
+    else if constexpr (std::is_same_v<BaseType, std::uint32_t>) return "uint32_t";
+    else if constexpr (std::is_same_v<BaseType, std::uint64_t>) return "uint64_t";
+#if QTAG_HAS_INT128
+    else if constexpr (std::is_same_v<BaseType, unsigned __int128>) return "UInt128";
+    else if constexpr (std::is_same_v<BaseType, QTagUtil::UIntN<2>>) return "UIntN<2>";
+#else
+    else if constexpr (std::is_same_v<BaseType, QTagUtil::UIntN<2>>) return "UInt128";
+#endif
+    else if constexpr (std::is_same_v<BaseType, QTagUtil::UInt256>) return "UInt256";
+    else return "unknown";
+  }
+
+  template<class QTag>
+  std::string GetLayoutName()
+  {
+    std::string name = "QuickTag<";
+    name += GetBaseTypeName<typename QTag::TagBaseType>();
+    for (std::size_t f = 0; f < QTag::GetNumFields(); ++f)
+    {
+      name += ", " + std::to_string(QTag::GetFieldBitWidth((unsigned char)f));
+    }
+    return name + ">";
+  }
+
+  // Random value for field f, never zero
+  template<class QTag>
+  std::uint64_t RandomFieldValue(std::mt19937_64& rng, const std::size_t field)
+  {
+    const unsigned int bits = QTag::GetFieldBitWidth((unsigned char)field);
+    const std::uint64_t maxValue = bits >= 64 ? ~std::uint64_t(0) : (std::uint64_t(1) << bits) - 1;
+    return 1 + rng() % maxValue;
+  }
+
+  template<class QTag>
+  QTag RandomTag(std::mt19937_64& rng)
+  {
+    QTag tag;
+    const std::size_t depth = 1 + rng() % QTag::GetNumFields();
+    for (std::size_t f = 0; f < depth; ++f)
+    {
+      tag.SetField((unsigned char)f, (typename QTag::TagBaseType)RandomFieldValue<QTag>(rng, f));
+    }
+    return tag;
+  }
+
+  // Calls pass() (which does opsPerPass operations) enough times per repetition to fill MinRepMs
+  template<class PassFn>
+  void RunBench(const BenchConfig& config, const std::string& op, const std::string& layout, const std::size_t opsPerPass, PassFn&& pass, std::vector<BenchResult>& outResults)
+  {
+    const std::string name = op + "/" + layout;
+    if (!config.Filter.empty() && name.find(config.Filter) == std::string::npos)
+    {
+      return;
+    }
+
+    using Clock = std::chrono::steady_clock;
+    const auto runPasses = [&](const std::uint64_t numPasses)
+    {
+      const Clock::time_point start = Clock::now();
+      for (std::uint64_t p = 0; p < numPasses; ++p)
+      {
+        pass();
+      }
+      return std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+    };
+
+    // Calibrate, doubling until a repetition is long enough to time reliably (this also warms up)
+    std::uint64_t numPasses = 1;
+    while (runPasses(numPasses) < config.MinRepMs * 1e6 && numPasses < (std::uint64_t(1) << 40))
+    {
+      numPasses *= 2;
+    }
+
+    std::vector<double> nsPerOp;
+    for (unsigned int rep = 0; rep < config.Reps; ++rep)
+    {
+      nsPerOp.push_back(runPasses(numPasses) / double(numPasses * opsPerPass));
+    }
+    std::sort(nsPerOp.begin(), nsPerOp.end());
+
+    BenchResult result;
+    result.Name = name;
+    result.Op = op;
+    result.Layout = layout;
+    result.MedianNsPerOp = nsPerOp[nsPerOp.size() / 2];
+    result.MinNsPerOp = nsPerOp.front();
+    result.MaxNsPerOp = nsPerOp.back();
+    result.OpsPerRep = numPasses * opsPerPass;
+    outResults.push_back(result);
+
+    fprintf(stderr, "%-68s %10.3f ns/op\n", name.c_str(), result.MedianNsPerOp);
+  }
+
+  template<class QTag>
+  void BenchLayout(const BenchConfig& config, std::vector<BenchResult>& outResults)
+  {
+    using BaseType = typename QTag::TagBaseType;
+    const std::string layout = GetLayoutName<QTag>();
+
+    // Seeded per layout, so adding a layout doesn't change the data the others see
+    std::mt19937_64 rng(config.Seed ^ QTagUtil::HashTagName(layout));
+
+    std::vector<QTag> tags(TagsPerPass);
+    std::vector<QTag> queries(TagsPerPass);
+    std::vector<unsigned char> fieldIndices(TagsPerPass);
+    std::vector<BaseType> fieldValues(TagsPerPass);
+    std::vector<BaseType> makeTagValues(TagsPerPass * 3);
+    for (std::size_t i = 0; i < TagsPerPass; ++i)
+    {
+      tags[i] = RandomTag<QTag>(rng);
+
+      // Half ancestors (or the tag itself) so Matches sees both outcomes, half unrelated tags
+      if (rng() % 2)
+      {
+        const int depth = 1 + int(rng() % (std::uint64_t)tags[i].GetDepth());
+        queries[i] = QTag(BaseType(tags[i].GetRaw() & QTag::GetPrefixMask(depth)));
+      }
+      else
+      {
+        queries[i] = RandomTag<QTag>(rng);
+      }
+
+      fieldIndices[i] = (unsigned char)(rng() % QTag::GetNumFields());
+      fieldValues[i] = (BaseType)RandomFieldValue<QTag>(rng, fieldIndices[i]);
+      for (std::size_t f = 0; f < 3; ++f)
+      {
+        makeTagValues[i * 3 + f] = (BaseType)RandomFieldValue<QTag>(rng, f);
+      }
+    }
+
+    RunBench(config, "Matches", layout, TagsPerPass, [&]()
+      {
+        std::size_t numMatches = 0;
+        for (std::size_t i = 0; i < TagsPerPass; ++i)
+        {
+          numMatches += tags[i].Matches(queries[i]);
+        }
+        DoNotOptimize(numMatches);
+      }, outResults);
+
+    RunBench(config, "MatchesExact", layout, TagsPerPass, [&]()
+      {
+        std::size_t numMatches = 0;
+        for (std::size_t i = 0; i < TagsPerPass; ++i)
+        {
+          numMatches += tags[i].MatchesExact(queries[i]);
+        }
+        DoNotOptimize(numMatches);
+      }, outResults);
+
+    RunBench(config, "GetDepth", layout, TagsPerPass, [&]()
+      {
+        std::size_t depthSum = 0;
+        for (std::size_t i = 0; i < TagsPerPass; ++i)
+        {
+          depthSum += (std::size_t)tags[i].GetDepth();
+        }
+        DoNotOptimize(depthSum);
+      }, outResults);
+
+    RunBench(config, "IsValid", layout, TagsPerPass, [&]()
+      {
+        std::size_t numValid = 0;
+        for (std::size_t i = 0; i < TagsPerPass; ++i)
+        {
+          numValid += queries[i].IsValid();
+        }
+        DoNotOptimize(numValid);
+      }, outResults);
+
+    RunBench(config, "GetField", layout, TagsPerPass, [&]()
+      {
+        BaseType fieldSum = 0;
+        for (std::size_t i = 0; i < TagsPerPass; ++i)
+        {
+          fieldSum = fieldSum ^ tags[i].GetField(fieldIndices[i]);
+        }
+        DoNotOptimize(fieldSum);
+      }, outResults);
+
+    RunBench(config, "SetField", layout, TagsPerPass, [&]()
+      {
+        BaseType rawSum = 0;
+        for (std::size_t i = 0; i < TagsPerPass; ++i)
+        {
+          QTag tag = tags[i];
+          tag.SetField(fieldIndices[i], fieldValues[i]);
+          rawSum = rawSum ^ tag.GetRaw();
+        }
+        DoNotOptimize(rawSum);
+      }, outResults);
+
+    RunBench(config, "MakeTag", layout, TagsPerPass, [&]()
+      {
+        BaseType rawSum = 0;
+        for (std::size_t i = 0; i < TagsPerPass; ++i)
+        {
+          const BaseType* values = makeTagValues.data() + i * 3;
+          rawSum = rawSum ^ QTag::MakeTag(values[0], values[1], values[2]).GetRaw();
+        }
+        DoNotOptimize(rawSum);
+      }, outResults);
+
+    // Allocates per call, fewer tags per pass keeps calibration quick
+    constexpr std::size_t StringTagsPerPass = TagsPerPass / 8;
+    RunBench(config, "ValueAsString", layout, StringTagsPerPass, [&]()
+      {
+        std::size_t charSum = 0;
+        for (std::size_t i = 0; i < StringTagsPerPass; ++i)
+        {
+          char* tagString = tags[i].ValueAsString();
+          charSum += (unsigned char)tagString[0];
+          delete[] tagString;
+        }
+        DoNotOptimize(charSum);
+      }, outResults);
+
+    RunBench(config, "ToChars", layout, TagsPerPass, [&]()
+      {
+        std::size_t lengthSum = 0;
+        char tagString[QTag::MaxStringLength + 1];
+        for (std::size_t i = 0; i < TagsPerPass; ++i)
+        {
+          lengthSum += tags[i].ToChars(tagString, sizeof(tagString));
+          DoNotOptimize(tagString);
+        }
+        DoNotOptimize(lengthSum);
+      }, outResults);
+
+    std::vector<char> formatBuffer(QTagUtil::GetFormatBufferSize<QTag>(TagsPerPass));
+    RunBench(config, "FormatTags", layout, TagsPerPass, [&]()
+      {
+        const std::size_t numBytes = QTagUtil::FormatTags(std::span<const QTag>(tags), formatBuffer.data());
+        DoNotOptimize(numBytes);
+        DoNotOptimize(formatBuffer[0]);
+      }, outResults);
+
+    // Inherited config, entries on the top two levels of every fourth tag and lookups by the full tags,
+    // so most queries fall back at least once. std::map walking the prefixes is the baseline
+    QuickTagMap<QTag, std::uint32_t> configMap;
+    std::map<QTag, std::uint32_t> configStdMap;
+    for (std::size_t i = 0; i < TagsPerPass; i += 4)
+    {
+      for (int depth = 1; depth <= std::min(2, tags[i].GetDepth()); ++depth)
+      {
+        const QTag ancestor(BaseType(tags[i].GetRaw() & QTag::GetPrefixMask(depth)));
+        configMap.Add(ancestor, (std::uint32_t)i);
+        configStdMap[ancestor] = (std::uint32_t)i;
+      }
+    }
+
+    RunBench(config, "StdMapNearestAncestor", layout, TagsPerPass, [&]()
+      {
+        std::uint32_t sum = 0;
+        for (std::size_t i = 0; i < TagsPerPass; ++i)
+        {
+          for (int depth = tags[i].GetDepth(); depth > 0; --depth)
+          {
+            const auto it = configStdMap.find(QTag(BaseType(tags[i].GetRaw() & QTag::GetPrefixMask(depth))));
+            if (it != configStdMap.end())
+            {
+              sum += it->second;
+              break;
+            }
+          }
+        }
+        DoNotOptimize(sum);
+      }, outResults);
+
+    RunBench(config, "MapFindNearestAncestor", layout, TagsPerPass, [&]()
+      {
+        std::uint32_t sum = 0;
+        for (std::size_t i = 0; i < TagsPerPass; ++i)
+        {
+          const std::uint32_t* value = configMap.FindNearestAncestor(tags[i]);
+          sum += value ? *value : 0;
+        }
+        DoNotOptimize(sum);
+      }, outResults);
+
+    std::vector<const std::uint32_t*> configResults(TagsPerPass);
+    RunBench(config, "MapFindNearestAncestorMany", layout, TagsPerPass, [&]()
+      {
+        configMap.FindNearestAncestorMany(std::span<const QTag>(tags), std::span<const std::uint32_t*>(configResults));
+        DoNotOptimize(configResults.data());
+      }, outResults);
+
+    // Entity-sized sorted sets drawn from the tags, which double as the dictionary
+    constexpr std::size_t TagsPerSet = 16;
+    std::vector<QTag> dictionary(tags.begin(), tags.end());
+    std::sort(dictionary.begin(), dictionary.end());
+    dictionary.erase(std::unique(dictionary.begin(), dictionary.end()), dictionary.end());
+    std::vector<std::vector<QTag>> tagSets;
+    std::size_t numSetTags = 0;
+    for (std::size_t first = 0; first < TagsPerPass; first += TagsPerSet)
+    {
+      std::vector<QTag> tagSet(tags.begin() + first, tags.begin() + first + TagsPerSet);
+      std::sort(tagSet.begin(), tagSet.end());
+      tagSet.erase(std::unique(tagSet.begin(), tagSet.end()), tagSet.end());
+      numSetTags += tagSet.size();
+      tagSets.push_back(std::move(tagSet));
+    }
+
+    // Baseline, raw GetRaw() values at full width as the sets are replicated today
+    std::vector<std::uint8_t> rawBuffer;
+    for (const std::vector<QTag>& tagSet : tagSets)
+    {
+      const std::uint32_t num = (std::uint32_t)tagSet.size();
+      rawBuffer.insert(rawBuffer.end(), reinterpret_cast<const std::uint8_t*>(&num), reinterpret_cast<const std::uint8_t*>(&num + 1));
+      rawBuffer.insert(rawBuffer.end(), reinterpret_cast<const std::uint8_t*>(tagSet.data()), reinterpret_cast<const std::uint8_t*>(tagSet.data() + tagSet.size()));
+    }
+    std::vector<QTag> decodedSet;
+    RunBench(config, "DecodeSetsRaw", layout, numSetTags, [&]()
+      {
+        const std::uint8_t* pos = rawBuffer.data();
+        for (std::size_t s = 0; s < tagSets.size(); ++s)
+        {
+          std::uint32_t num;
+          std::memcpy(&num, pos, sizeof(num));
+          decodedSet.resize(num);
+          std::memcpy(decodedSet.data(), pos + sizeof(num), num * sizeof(QTag));
+          pos += sizeof(num) + num * sizeof(QTag);
+          DoNotOptimize(decodedSet.data());
+        }
+      }, outResults);
+
+    for (const bool bDictionary : { false, true })
+    {
+      const std::span<const QTag> codecDictionary = bDictionary ? std::span<const QTag>(dictionary) : std::span<const QTag>();
+      const auto encodeSets = [&](std::vector<std::uint8_t>& outBuffer)
+        {
+          outBuffer.clear();
+          QuickTagSetEncoder<QTag> encoder(outBuffer, codecDictionary);
+          for (const std::vector<QTag>& tagSet : tagSets)
+          {
+            encoder.Encode(tagSet);
+          }
+        };
+
+      // Encoded up front, so the decode runs on its own under -filter
+      std::vector<std::uint8_t> codecBuffer;
+      encodeSets(codecBuffer);
+
+      std::vector<std::uint8_t> encodeBuffer;
+      RunBench(config, bDictionary ? "EncodeSetsDictionary" : "EncodeSetsPrefix", layout, numSetTags, [&]()
+        {
+          encodeSets(encodeBuffer);
+          DoNotOptimize(encodeBuffer.data());
+        }, outResults);
+
+      RunBench(config, bDictionary ? "DecodeSetsDictionary" : "DecodeSetsPrefix", layout, numSetTags, [&]()
+        {
+          QuickTagSetDecoder<QTag> decoder(codecBuffer, codecDictionary);
+          while (decoder.Decode(decodedSet))
+          {
+            DoNotOptimize(decodedSet.data());
+          }
+        }, outResults);
+    }
+  }
+
+  const char* GetSimdLevelName(const QTagUtil::Simd::ELevel level)
+  {
+    switch (level)
+    {
+    case QTagUtil::Simd::ELevel::AVX512: return "AVX512";
+    case QTagUtil::Simd::ELevel::AVX2  : return "AVX2";
+    case QTagUtil::Simd::ELevel::SSE2  : return "SSE2";
+    default: return "Scalar";
+    }
+  }
+
+  const char* GetCompilerName()
+  {
+#if defined(__clang__)
+    return "clang " __clang_version__;
+#elif defined(__GNUC__)
+    return "gcc " __VERSION__;
+#elif defined(_MSC_VER)
+#define QTAG_STRINGIFY_IMPL(x) #x
+#define QTAG_STRINGIFY(x) QTAG_STRINGIFY_IMPL(x)
+    return "msvc " QTAG_STRINGIFY(_MSC_FULL_VER);
+#else
+    return "unknown";
+#endif
+  }
+
+  // Names and compiler strings don't need more than quote and backslash escaping
+  std::string EscapeJson(const std::string& str)
+  {
+    std::string escaped;
+    for (const char c : str)
+    {
+      if (c == '"' || c == '\\')
+      {
+        escaped.push_back('\\');
+      }
+      escaped.push_back(c);
+    }
+    return escaped;
+  }
+
+  void WriteJson(FILE* outFile, const BenchConfig& config, const std::vector<BenchResult>& results)
+  {
+    fprintf(outFile, "{\n");
+    fprintf(outFile, "  \"context\": {\n");
+    fprintf(outFile, "    \"compiler\": \"%s\",\n", EscapeJson(GetCompilerName()).c_str());
+#if defined(NDEBUG)
+    fprintf(outFile, "    \"build\": \"release\",\n");
+#else
+    fprintf(outFile, "    \"build\": \"debug\",\n");
+#endif
+    fprintf(outFile, "    \"simd_level\": \"%s\",\n", GetSimdLevelName(QTagUtil::Simd::GetLevel()));
+    fprintf(outFile, "    \"seed\": %llu,\n", (unsigned long long)config.Seed);
+    fprintf(outFile, "    \"repetitions\": %u,\n", config.Reps);
+    fprintf(outFile, "    \"min_rep_ms\": %g,\n", config.MinRepMs);
+    fprintf(outFile, "    \"tags_per_pass\": %zu\n", TagsPerPass);
+    fprintf(outFile, "  },\n");
+    fprintf(outFile, "  \"benchmarks\": [");
+    for (std::size_t r = 0; r < results.size(); ++r)
+    {
+      const BenchResult& result = results[r];
+      fprintf(outFile, "%s\n    {\n", r == 0 ? "" : ",");
+      fprintf(outFile, "      \"name\": \"%s\",\n", EscapeJson(result.Name).c_str());
+      fprintf(outFile, "      \"op\": \"%s\",\n", EscapeJson(result.Op).c_str());
+      fprintf(outFile, "      \"layout\": \"%s\",\n", EscapeJson(result.Layout).c_str());
+      fprintf(outFile, "      \"ns_per_op\": %.4f,\n", result.MedianNsPerOp);
+      fprintf(outFile, "      \"min_ns_per_op\": %.4f,\n", result.MinNsPerOp);
+      fprintf(outFile, "      \"max_ns_per_op\": %.4f,\n", result.MaxNsPerOp);
+      fprintf(outFile, "      \"ops_per_rep\": %llu\n", (unsigned long long)result.OpsPerRep);
+      fprintf(outFile, "    }");
+    }
+    fprintf(outFile, "\n  ]\n}\n");
+  }
+
+  // Digits only, false for anything else or a value that doesn't fit in 64 bits
+  bool ParseUnsigned(const std::string& str, std::uint64_t& outValue)
+  {
+    const char* const end = str.data() + str.size();
+    const std::from_chars_result result = std::from_chars(str.data(), end, outValue);
+    return !str.empty() && result.ec == std::errc() && result.ptr == end;
+  }
+}
+
+int main(int argc, char** argv)
+{
+  BenchConfig config;
+  std::string outputFile;
+
+  // Progress goes to stderr, so the JSON can go to stdout
+  for (int i = 1; i < argc; ++i)
+  {
+    const std::string arg = argv[i];
+    if (arg == "-o" || arg == "-filter" || arg == "-seed" || arg == "-reps" || arg == "-min-time")
+    {
+      if (i + 1 >= argc)
+      {
+        fprintf(stderr, "%s param but no value provided\n", arg.c_str());
+        return -1;
+      }
+      const std::string nextArg = argv[++i];
+
+      std::uint64_t value = 0;
+      if (arg == "-o")
+      {
+        outputFile = nextArg;
+      }
+      else if (arg == "-filter")
+      {
+        config.Filter = nextArg;
+      }
+      else if (!ParseUnsigned(nextArg, value))
+      {
+        fprintf(stderr, "%s expects a number (%s)\n", arg.c_str(), nextArg.c_str());
+        return -1;
+      }
+      else if (arg == "-seed")
+      {
+        config.Seed = value;
+      }
+      else if (arg == "-reps")
+      {
+        config.Reps = std::max(1u, (unsigned int)value);
+      }
+      else
+      {
+        config.MinRepMs = (double)value;
+      }
+    }
+    else
+    {
+      fprintf(stderr, "Unknown param %s\n", arg.c_str());
+      fprintf(stderr, "Usage: quicktags-bench [-o results.json] [-filter substring] [-seed N] [-reps N] [-min-time ms]\n");
+      return -1;
+    }
+  }
+
+  std::vector<BenchResult> results;
+  BenchLayout<QuickTag<std::uint8_t, 2, 2, 2, 1, 1>>(config, results);
+  BenchLayout<QuickTag<std::uint16_t, 4, 4, 4, 4>>(config, results);
+  BenchLayout<QuickTag<std::uint32_t, 4, 8, 12, 8>>(config, results);
+  BenchLayout<QuickTag<std::uint32_t, 8, 8, 8, 8>>(config, results);
+  BenchLayout<QuickTag<std::uint64_t, 16, 16, 16, 16>>(config, results);
+  BenchLayout<QuickTag<std::uint64_t, 8, 8, 8, 8, 8, 8, 8, 8>>(config, results);
+  BenchLayout<QuickTag<QTagUtil::UInt128, 16, 16, 16, 16, 16, 16, 16, 16>>(config, results);
+#if QTAG_HAS_INT128
+  // Portable fallback used where there's no __int128
+  BenchLayout<QuickTag<QTagUtil::UIntN<2>, 16, 16, 16, 16, 16, 16, 16, 16>>(config, results);
+#endif
+  BenchLayout<QuickTag<QTagUtil::UInt256, 32, 32, 32, 32, 32, 32, 32, 32>>(config, results);
+
+  if (outputFile.empty())
+  {
+    WriteJson(stdout, config, results);
+    return 0;
+  }
+
+  FILE* outFile = fopen(outputFile.c_str(), "w");
+  if (!outFile)
+  {
+    fprintf(stderr, "Failed to open %s\n", outputFile.c_str());
+    return -1;
+  }
+  WriteJson(outFile, config, results);
+  fclose(outFile);
+  fprintf(stderr, "Wrote %zu results to %s\n", results.size(), outputFile.c_str());
+  return 0;
+}
@@ -0,0 +1,416 @@
+#include "QuickTags.hpp"
+#include "QuickTags-Loader.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Generates a header of constexpr tag constants, e.g. Tags::A::_2::_1, plus a compile-time
+// perfect hash table from tag name to tag, so tags can be bound without loading at startup.
+
+namespace
+{
+  using namespace QTagUtil;
+
+  const std::set<std::string> CppKeywords =
+  {
+    "alignas", "alignof", "and", "and_eq", "asm", "auto", "bitand", "bitor", "bool", "break", "case", "catch",
+    "char", "char8_t", "char16_t", "char32_t", "class", "compl", "concept", "const", "consteval", "constexpr",
+    "constinit", "const_cast", "continue", "co_await", "co_return", "co_yield", "decltype", "default", "delete",
+    "do", "double", "dynamic_cast", "else", "enum", "explicit", "export", "extern", "false", "float", "for",
+    "friend", "goto", "if", "inline", "int", "long", "mutable", "namespace", "new", "noexcept", "not", "not_eq",
+    "nullptr", "operator", "or", "or_eq", "private", "protected", "public", "register", "reinterpret_cast",
+    "requires", "return", "short", "signed", "sizeof", "static", "static_assert", "static_cast", "struct",
+    "switch", "template", "this", "thread_local", "throw", "true", "try", "typedef", "typeid", "typename",
+    "union", "unsigned", "using", "virtual", "void", "volatile", "wchar_t", "while", "xor", "xor_eq"
+  };
+
+  // Name of the constant for an interior node, which is a namespace holding its children
+  const std::string SelfTagName = "Tag";
+
+  // Declared alongside the top-level tags in the root namespace
+  const std::set<std::string> RootIdentifiers = { "QTag", "NumTags", "NameTagPair", "Internal", "FindTag" };
+
+  struct GeneratedTag
+  {
+    std::string Name;
+    std::vector<std::uint64_t> Fields;
+  };
+
+  std::string MakeIdentifier(const std::string& segment)
+  {
+    std::string identifier;
+    identifier.reserve(segment.size() + 1);
+    for (const char c : segment)
+    {
+      const bool bValidChar = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+      identifier.push_back(bValidChar ? c : '_');
+    }
+    if (identifier.empty() || (identifier[0] >= '0' && identifier[0] <= '9'))
+    {
+      identifier.insert(identifier.begin(), '_');
+    }
+    if (CppKeywords.count(identifier))
+    {
+      identifier.push_back('_');
+    }
+    return identifier;
+  }
+
+  std::string MakeTagExpression(const std::vector<std::uint64_t>& fields)
+  {
+    std::stringstream ss;
+    ss << "QTag::MakeTag(";
+    for (size_t f = 0; f < fields.size(); ++f)
+    {
+      ss << fields[f];
+      if (f < fields.size() - 1)
+      {
+        ss << ", ";
+      }
+    }
+    ss << ")";
+    return ss.str();
+  }
+
+  void EmitNodes(const std::list<TagTreeNode>& nodes, const std::string& parentName, std::vector<std::uint64_t>& fields, const int depth, std::stringstream& out, std::vector<GeneratedTag>& outTags)
+  {
+    const std::string indent((depth + 1) * 2, ' ');
+
+    // Sanitising can make siblings collide with each other or with an interior node's self constant
+    std::set<std::string> usedIdentifiers = depth > 0 ? std::set<std::string>{ SelfTagName } : RootIdentifiers;
+
+    for (const TagTreeNode& node : nodes)
+    {
+      std::string identifier = MakeIdentifier(node.Tag);
+      while (usedIdentifiers.count(identifier))
+      {
+        identifier.push_back('_');
+      }
+      usedIdentifiers.insert(identifier);
+
+      const std::string name = parentName.empty() ? node.Tag : parentName + "." + node.Tag;
+      fields.push_back(node.TagAsInt);
+      outTags.push_back({ name, fields });
+
+      if (node.SubTags.empty())
+      {
+        out << indent << "inline constexpr QTag " << identifier << " = " << MakeTagExpression(fields) << "; // " << name << "\n";
+      }
+      else
+      {
+        out << indent << "namespace " << identifier << "\n" << indent << "{\n";
+        out << indent << "  inline constexpr QTag " << SelfTagName << " = " << MakeTagExpression(fields) << "; // " << name << "\n";
+        EmitNodes(node.SubTags, name, fields, depth + 1, out, outTags);
+        out << indent << "}\n";
+      }
+
+      fields.pop_back();
+    }
+  }
+
+  struct PerfectHashTable
+  {
+    std::vector<std::uint32_t> Seeds;
+    std::vector<int> Slots; // Index into tags, -1 for empty
+  };
+
+  // Hash and displace: keys are grouped into buckets by HashTagName(name, 0), then each bucket
+  // (largest first) searches for a seed that places all its keys into free slots
+  bool BuildPerfectHash(const std::vector<GeneratedTag>& tags, PerfectHashTable& outTable)
+  {
+    const size_t numKeys = tags.size();
+    const size_t numSlots = std::max<size_t>(1, numKeys + numKeys / 4);
+    const size_t numBuckets = std::max<size_t>(1, numKeys / 4);
+
+    std::vector<std::vector<int>> buckets(numBuckets);
+    for (size_t i = 0; i < numKeys; ++i)
+    {
+      buckets[HashTagName(tags[i].Name) % numBuckets].push_back((int)i);
+    }
+
+    std::vector<size_t> bucketOrder(numBuckets);
+    for (size_t b = 0; b < numBuckets; ++b)
+    {
+      bucketOrder[b] = b;
+    }
+    std::stable_sort(bucketOrder.begin(), bucketOrder.end(), [&buckets](const size_t a, const size_t b)
+      {
+        return buckets[a].size() > buckets[b].size();
+      });
+
+    outTable.Seeds.assign(numBuckets, 0);
+    outTable.Slots.assign(numSlots, -1);
+
+    constexpr std::uint32_t MaxSeed = 1u << 24;
+    std::vector<size_t> candidateSlots;
+    for (const size_t b : bucketOrder)
+    {
+      const std::vector<int>& bucket = buckets[b];
+      if (bucket.empty())
+      {
+        break;
+      }
+
+      bool bPlaced = false;
+      for (std::uint32_t seed = 1; seed < MaxSeed && !bPlaced; ++seed)
+      {
+        candidateSlots.clear();
+        bPlaced = true;
+        for (const int key : bucket)
+        {
+          const size_t slot = HashTagName(tags[key].Name, seed) % numSlots;
+          if (outTable.Slots[slot] != -1 || std::find(candidateSlots.begin(), candidateSlots.end(), slot) != candidateSlots.end())
+          {
+            bPlaced = false;
+            break;
+          }
+          candidateSlots.push_back(slot);
+        }
+
+        if (bPlaced)
+        {
+          outTable.Seeds[b] = seed;
+          for (size_t k = 0; k < bucket.size(); ++k)
+          {
+            outTable.Slots[candidateSlots[k]] = bucket[k];
+          }
+        }
+      }
+
+      if (!bPlaced)
+      {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // Packs fields the same way as QuickTag::GenFieldOffsets, first field in the highest bits
+  std::uint64_t PackFields(const std::vector<std::uint64_t>& fields, const std::vector<unsigned int>& fieldBits, const unsigned int baseBits)
+  {
+    std::uint64_t packed = 0;
+    unsigned int offset = baseBits;
+    for (size_t f = 0; f < fields.size(); ++f)
+    {
+      offset -= fieldBits[f];
+      packed |= fields[f] << offset;
+    }
+    return packed;
+  }
+
+  std::string EscapeString(const std::string& str)
+  {
+    std::string escaped;
+    for (const char c : str)
+    {
+      if (c == '"' || c == '\\')
+      {
+        escaped.push_back('\\');
+      }
+      escaped.push_back(c);
+    }
+    return escaped;
+  }
+}
+
+int main(int argc, char** argv)
+{
+  std::vector<std::string> tagsFiles;
+  std::string outputFile;
+  std::string rootNamespace = "Tags";
+  bool bCaseInsensitive = false;
+
+  for (int i = 0; i < argc; ++i)
+  {
+    printf("%s ", argv[i]);
+
+    std::string arg = argv[i];
+    if (arg == "-f" || arg == "-o" || arg == "-namespace")
+    {
+      if (i + 1 < argc)
+      {
+        ++i;
+        std::string nextArg = argv[i];
+        if (char firstChar = *nextArg.begin())
+        {
+          if (firstChar == '-')
+          {
+            printf("%s param missing or invalid (%s)", arg.c_str(), nextArg.c_str());
+            return -1;
+          }
+        }
+        printf("%s", argv[i]);
+
+        if (arg == "-f")
+        {
+          tagsFiles.push_back(nextArg);
+        }
+        else if (arg == "-o")
+        {
+          outputFile = nextArg;
+        }
+        else
+        {
+          rootNamespace = nextArg;
+        }
+      }
+      else
+      {
+        printf("%s param but no value provided", arg.c_str());
+        return -1;
+      }
+    }
+
+    if (arg == "-case-insensitive")
+    {
+      bCaseInsensitive = true;
+    }
+
+    printf("\n");
+  }
+
+  if (tagsFiles.empty())
+  {
+    printf("No file(s) provided");
+    return -1;
+  }
+
+  if (outputFile.empty())
+  {
+    printf("No output file provided (-o)");
+    return -1;
+  }
+
+  std::vector<std::fstream> files;
+  files.reserve(tagsFiles.size());
+  for (const std::string& tagsFile : tagsFiles)
+  {
+    std::fstream fileStream = std::fstream(tagsFile, std::ios_base::in);
+    if (!fileStream.is_open())
+    {
+      printf("Failed to open file %s", tagsFile.c_str());
+      continue;
+    }
+    files.push_back(std::move(fileStream));
+  }
+
+  ETagSetFlags flags = ETagSetFlags::None;
+  if (bCaseInsensitive)
+  {
+    flags = (ETagSetFlags)((unsigned int)flags | (unsigned int)ETagSetFlags::CaseInsensitive);
+  }
+
+  std::set<std::string> tagStringSet;
+  BuildTagStringSetFromFiles(files, tagStringSet, flags);
+
+  if (tagStringSet.size() == 0)
+  {
+    printf("No valid tags found in file");
+    return -3;
+  }
+
+  std::list<TagTreeNode> tagTrees;
+  TreeifyTags(tagStringSet, tagTrees);
+  EnumerateTags(tagTrees);
+
+  std::vector<unsigned int> ranges;
+  FindTagRanges(tagTrees, ranges);
+
+  std::vector<unsigned int> requiredBitsPerField;
+  GetRequiredBitsPerField(ranges, requiredBitsPerField);
+
+  const EQTagIntBase base = FindSmallestIntBase(requiredBitsPerField);
+  const std::string usingString = GetTemplateString(base, requiredBitsPerField);
+  const unsigned int baseBits = 8u << (unsigned int)base;
+
+  // Constants
+  std::stringstream constants;
+  std::vector<GeneratedTag> generatedTags;
+  std::vector<std::uint64_t> fields;
+  EmitNodes(tagTrees, "", fields, 0, constants, generatedTags);
+
+  PerfectHashTable hashTable;
+  if (!BuildPerfectHash(generatedTags, hashTable))
+  {
+    printf("Failed to build perfect hash table for %d tags", (int)generatedTags.size());
+    return -4;
+  }
+
+  std::stringstream out;
+  out << "// Generated by quicktags-codegen, do not edit\n";
+  out << "// Source files:\n";
+  for (const std::string& tagsFile : tagsFiles)
+  {
+    out << "//   " << tagsFile << "\n";
+  }
+  out << "#pragma once\n";
+  out << "#include \"QuickTags.hpp\"\n\n";
+  out << "#include <cstddef>\n";
+  out << "#include <cstdint>\n";
+  out << "#include <string_view>\n\n";
+  out << "namespace " << rootNamespace << "\n{\n";
+  out << "  " << usingString << "\n\n";
+  out << "  inline constexpr std::size_t NumTags = " << generatedTags.size() << ";\n\n";
+  out << constants.str() << "\n";
+
+  out << "  struct NameTagPair\n  {\n    std::string_view Name;\n    QTag Tag;\n  };\n\n";
+  out << "  namespace Internal\n  {\n";
+  out << "    // Perfect hash, slot = HashTagName(name, Seeds[HashTagName(name) % NumBuckets]) % NumSlots\n";
+  out << "    inline constexpr std::size_t NumBuckets = " << hashTable.Seeds.size() << ";\n";
+  out << "    inline constexpr std::size_t NumSlots = " << hashTable.Slots.size() << ";\n";
+  out << "    inline constexpr std::uint32_t Seeds[NumBuckets] =\n    {";
+  for (size_t b = 0; b < hashTable.Seeds.size(); ++b)
+  {
+    out << ((b % 16) == 0 ? "\n      " : " ") << hashTable.Seeds[b] << ",";
+  }
+  out << "\n    };\n";
+  out << "    inline constexpr NameTagPair Slots[NumSlots] =\n    {\n";
+  for (const int slot : hashTable.Slots)
+  {
+    if (slot == -1)
+    {
+      out << "      { {}, QTag() },\n";
+    }
+    else
+    {
+      const GeneratedTag& tag = generatedTags[slot];
+      // Raw values here, the table is large and MakeTag is comparatively slow to evaluate at compile time
+      // Past 64 bits there's no portable literal for the raw value, so fall back to MakeTag
+      out << "      { \"" << EscapeString(tag.Name) << "\", ";
+      if (baseBits <= 64)
+      {
+        out << "QTag(0x" << std::hex << PackFields(tag.Fields, requiredBitsPerField, baseBits) << std::dec << ")";
+      }
+      else
+      {
+        out << MakeTagExpression(tag.Fields);
+      }
+      out << " },\n";
+    }
+  }
+  out << "    };\n  }\n\n";
+
+  out << "  // Returns the tag for name, or an invalid tag if name isn't in the registry\n";
+  out << "  constexpr QTag FindTag(const std::string_view name)\n  {\n";
+  out << "    const std::uint32_t seed = Internal::Seeds[QTagUtil::HashTagName(name) % Internal::NumBuckets];\n";
+  out << "    const NameTagPair& slot = Internal::Slots[QTagUtil::HashTagName(name, seed) % Internal::NumSlots];\n";
+  out << "    return slot.Name == name ? slot.Tag : QTag();\n";
+  out << "  }\n";
+  out << "}\n";
+
+  std::fstream outFile = std::fstream(outputFile, std::ios_base::out | std::ios_base::trunc);
+  if (!outFile.is_open())
+  {
+    printf("Failed to open output file %s", outputFile.c_str());
+    return -2;
+  }
+  outFile << out.str();
+  printf("Wrote %d tags to %s\n", (int)generatedTags.size(), outputFile.c_str());
+
+  return 0;
+}
@@ -0,0 +1,404 @@
+#include "QuickTags.hpp"
+#include "QuickTags-Loader.hpp"
+#include "QuickTags-LoadStats.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <random>
+#include <string>
+#include <system_error>
+#include <unordered_set>
+#include <vector>
+
+// Loader macro-benchmark: generates synthetic tag files and times each stage of the load pipelines
+// on them, from -min-tags up to -max-tags in powers of ten.
+//
+// The generator walks down a random tree, picking a depth in [1, -depth] and then a child at each
+// level out of -fanout, with child i weighted 1 / (i + 1)^-skew. Skew 0 spreads tags evenly, higher
+// values crowd them into a few hot subtrees the way real registries do. Lines are written in the
+// order they're generated, unsorted, and the same seed always writes the same file.
+//
+// With -generate the tool only writes a file of -max-tags lines, for use with other tools.
+
+QTAG_DEFINE_ALLOCATION_TRACKING();
+
+namespace
+{
+  // Wide enough for any tree the generator can make, so no tags get dropped at load
+  constexpr unsigned int MaxGeneratedDepth = 8;
+  constexpr unsigned int MaxGeneratedFanOut = 65535;
+  using QTag = QuickTag<QTagUtil::UInt128, 16, 16, 16, 16, 16, 16, 16, 16>;
+
+  struct SyntheticTagParams
+  {
+    std::uint64_t NumTags = 0;
+    unsigned int MaxDepth = 6;
+    unsigned int FanOut = 32;
+    double Skew = 1.0;
+    std::uint64_t Seed = 1;
+  };
+
+  struct PipelineRun
+  {
+    std::string Pipeline;
+    std::uint64_t NumLines;
+    std::uint64_t NumTags;
+    std::uint64_t FileBytes;
+    QTagUtil::LoadStats Stats;
+  };
+
+  // Same name for the same child index at the same depth, so like real tags, "Fire" turns up
+  // under several parents
+  void AppendSegmentName(const unsigned int depth, unsigned int childIdx, std::string& outLine)
+  {
+    static const char* const Syllables[16] = { "ka", "lo", "mi", "ra", "te", "vu", "sho", "ne", "bi", "da", "gor", "pe", "zu", "fi", "on", "wy" };
+
+    const std::size_t start = outLine.size();
+    childIdx += depth * 7; // Vary the names between depths
+    do
+    {
+      outLine += Syllables[childIdx % 16];
+      childIdx /= 16;
+    } while (childIdx);
+    outLine[start] = (char)(outLine[start] - 'a' + 'A');
+  }
+
+  double RandomUnit(std::mt19937_64& rng)
+  {
+    return double(rng() >> 11) * (1.0 / 9007199254740992.0); // [0, 1) from the top 53 bits
+  }
+
+  // Returns the number of unique lines written, less than params.NumTags if skew and fan-out leave
+  // too few distinct tags to reach it
+  std::uint64_t GenerateTagFile(const SyntheticTagParams& params, const std::string& path)
+  {
+    FILE* file = fopen(path.c_str(), "wb");
+    if (!file)
+    {
+      return 0;
+    }
+
+    // Cumulative child weights, shared by every level
+    std::vector<double> childCdf(params.FanOut);
+    double totalWeight = 0.0;
+    for (unsigned int c = 0; c < params.FanOut; ++c)
+    {
+      totalWeight += 1.0 / std::pow(double(c + 1), params.Skew);
+      childCdf[c] = totalWeight;
+    }
+
+    std::mt19937_64 rng(params.Seed);
+    std::unordered_set<std::uint64_t> seenHashes; // Hashes rather than strings, a collision only drops a line
+    seenHashes.reserve(params.NumTags);
+
+    std::string buffer;
+    std::string line;
+    std::uint64_t numWritten = 0;
+    const std::uint64_t maxAttempts = params.NumTags * 20 + 1000;
+    for (std::uint64_t attempt = 0; attempt < maxAttempts && numWritten < params.NumTags; ++attempt)
+    {
+      line.clear();
+      const unsigned int depth = 1 + unsigned(rng() % params.MaxDepth);
+      for (unsigned int d = 0; d < depth; ++d)
+      {
+        const double pick = RandomUnit(rng) * totalWeight;
+        const unsigned int childIdx = std::min(unsigned(std::upper_bound(childCdf.begin(), childCdf.end(), pick) - childCdf.begin()), params.FanOut - 1);
+        if (d > 0)
+        {
+          line.push_back('.');
+        }
+        AppendSegmentName(d, childIdx, line);
+      }
+
+      if (seenHashes.insert(QTagUtil::HashTagName(line)).second)
+      {
+        buffer.append(line).push_back('\n');
+        ++numWritten;
+        if (buffer.size() > (1 << 20))
+        {
+          fwrite(buffer.data(), 1, buffer.size(), file);
+          buffer.clear();
+        }
+      }
+    }
+    fwrite(buffer.data(), 1, buffer.size(), file);
+    fclose(file);
+    return numWritten;
+  }
+
+  std::uint64_t GetFileSize(const std::string& path)
+  {
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    return file ? (std::uint64_t)file.tellg() : 0;
+  }
+
+  bool RunStreamPipeline(const std::string& path, PipelineRun& outRun)
+  {
+    std::fstream file(path, std::ios_base::in);
+    if (!file.is_open())
+    {
+      return false;
+    }
+    std::map<QTag, std::string> tagStringMap;
+    std::vector<QTag> tags;
+    QTagUtil::LoadQuickTagsFromFile(file, tagStringMap, tags, &outRun.Stats);
+    outRun.NumTags = tags.size();
+    return true;
+  }
+
+  bool RunMappedPipeline(const std::string& path, PipelineRun& outRun)
+  {
+    std::map<QTag, std::string> tagStringMap;
+    std::vector<QTag> tags;
+    if (!QTagUtil::LoadQuickTagsFromMappedFile(path, tagStringMap, tags, &outRun.Stats))
+    {
+      return false;
+    }
+    outRun.NumTags = tags.size();
+    return true;
+  }
+
+  // The analyser's pipeline, through the std::list tree
+  bool RunListTreePipeline(const std::string& path, PipelineRun& outRun)
+  {
+    using namespace QTagUtil;
+
+    std::fstream file(path, std::ios_base::in);
+    if (!file.is_open())
+    {
+      return false;
+    }
+    LoadStats& stats = outRun.Stats;
+    std::set<std::string> stringSet;
+    std::list<TagTreeNode> tagTrees;
+    std::vector<std::uint32_t> ranges;
+    std::map<QTag, std::string> tagStringMap;
+    std::vector<QTag> tags;
+    {
+      ScopedLoadStage stage(&stats, "BuildTagStringSetFromFile");
+      BuildTagStringSetFromFile(file, stringSet);
+    }
+    {
+      ScopedLoadStage stage(&stats, "TreeifyTags");
+      TreeifyTags(stringSet, tagTrees);
+    }
+    {
+      ScopedLoadStage stage(&stats, "EnumerateTags");
+      EnumerateTags(tagTrees);
+    }
+    {
+      ScopedLoadStage stage(&stats, "FindTagRanges");
+      FindTagRanges(tagTrees, ranges);
+    }
+    {
+      ScopedLoadStage stage(&stats, "GetEachTagAsQTag");
+      for (const TagTreeNode& tree : tagTrees)
+      {
+        Internal::GetEachTagAsQTag(tree, tagStringMap, tags);
+      }
+    }
+    outRun.NumTags = tags.size();
+    return true;
+  }
+
+  void PrintRun(const PipelineRun& run)
+  {
+    const double totalMs = run.Stats.GetTotalMilliseconds();
+    printf("%s: %llu lines, %llu tags, %.3f ms total, %.1f ns/tag\n", run.Pipeline.c_str(), (unsigned long long)run.NumLines, (unsigned long long)run.NumTags,
+      totalMs, run.NumTags ? totalMs * 1e6 / double(run.NumTags) : 0.0);
+    for (const QTagUtil::LoadStageStats& stage : run.Stats.Stages)
+    {
+      printf("  %-32s %10.3f ms %10llu allocs %12llu peak bytes %12lld retained bytes\n", stage.Stage, stage.Milliseconds,
+        (unsigned long long)stage.NumAllocations, (unsigned long long)stage.PeakBytes, (long long)stage.RetainedBytes);
+    }
+  }
+
+  void WriteJson(FILE* outFile, const SyntheticTagParams& params, const unsigned int reps, const std::vector<PipelineRun>& runs)
+  {
+    fprintf(outFile, "{\n");
+    fprintf(outFile, "  \"context\": {\n");
+#if defined(NDEBUG)
+    fprintf(outFile, "    \"build\": \"release\",\n");
+#else
+    fprintf(outFile, "    \"build\": \"debug\",\n");
+#endif
+    fprintf(outFile, "    \"seed\": %llu,\n", (unsigned long long)params.Seed);
+    fprintf(outFile, "    \"max_depth\": %u,\n", params.MaxDepth);
+    fprintf(outFile, "    \"fan_out\": %u,\n", params.FanOut);
+    fprintf(outFile, "    \"skew\": %g,\n", params.Skew);
+    fprintf(outFile, "    \"repetitions\": %u,\n", reps);
+    fprintf(outFile, "    \"allocation_tracking\": %s\n", QTagUtil::AllocTracking::IsEnabled() ? "true" : "false");
+    fprintf(outFile, "  },\n");
+    fprintf(outFile, "  \"runs\": [");
+    for (std::size_t r = 0; r < runs.size(); ++r)
+    {
+      const PipelineRun& run = runs[r];
+      const double totalMs = run.Stats.GetTotalMilliseconds();
+      fprintf(outFile, "%s\n    {\n", r == 0 ? "" : ",");
+      fprintf(outFile, "      \"pipeline\": \"%s\",\n", run.Pipeline.c_str());
+      fprintf(outFile, "      \"lines\": %llu,\n", (unsigned long long)run.NumLines);
+      fprintf(outFile, "      \"tags\": %llu,\n", (unsigned long long)run.NumTags);
+      fprintf(outFile, "      \"file_bytes\": %llu,\n", (unsigned long long)run.FileBytes);
+      fprintf(outFile, "      \"total_ms\": %.4f,\n", totalMs);
+      fprintf(outFile, "      \"ns_per_tag\": %.4f,\n", run.NumTags ? totalMs * 1e6 / double(run.NumTags) : 0.0);
+      fprintf(outFile, "      \"stages\": [");
+      for (std::size_t s = 0; s < run.Stats.Stages.size(); ++s)
+      {
+        const QTagUtil::LoadStageStats& stage = run.Stats.Stages[s];
+        fprintf(outFile, "%s\n        { \"stage\": \"%s\", \"ms\": %.4f, \"allocations\": %llu, \"peak_bytes\": %llu, \"retained_bytes\": %lld }",
+          s == 0 ? "" : ",", stage.Stage, stage.Milliseconds, (unsigned long long)stage.NumAllocations, (unsigned long long)stage.PeakBytes, (long long)stage.RetainedBytes);
+      }
+      fprintf(outFile, "\n      ]\n    }");
+    }
+    fprintf(outFile, "\n  ]\n}\n");
+  }
+
+  // Digits only, false for anything else or a value that doesn't fit in 64 bits
+  bool ParseUnsigned(const std::string& str, std::uint64_t& outValue)
+  {
+    const char* const end = str.data() + str.size();
+    const std::from_chars_result result = std::from_chars(str.data(), end, outValue);
+    return !str.empty() && result.ec == std::errc() && result.ptr == end;
+  }
+}
+
+int main(int argc, char** argv)
+{
+  SyntheticTagParams params;
+  std::uint64_t minTags = 1000;
+  std::uint64_t maxTags = 1000000;
+  unsigned int reps = 3;
+  std::string outputFile;
+  std::string generateFile;
+  std::string workDir = ".";
+
+  for (int i = 1; i < argc; ++i)
+  {
+    const std::string arg = argv[i];
+    if (i + 1 >= argc)
+    {
+      fprintf(stderr, "%s param but no value provided\n", arg.c_str());
+      return -1;
+    }
+    const std::string nextArg = argv[++i];
+
+    std::uint64_t value = 0;
+    if (arg == "-o")
+    {
+      outputFile = nextArg;
+    }
+    else if (arg == "-generate")
+    {
+      generateFile = nextArg;
+    }
+    else if (arg == "-dir")
+    {
+      workDir = nextArg;
+    }
+    else if (arg == "-skew")
+    {
+      params.Skew = std::max(0.0, std::atof(nextArg.c_str()));
+    }
+    else if (!ParseUnsigned(nextArg, value))
+    {
+      fprintf(stderr, "Unknown param %s, or %s isn't a number\n", arg.c_str(), nextArg.c_str());
+      fprintf(stderr, "Usage: quicktags-loadbench [-o results.json] [-generate tags.txt] [-dir workdir] [-min-tags N] [-max-tags N] "
+        "[-depth N] [-fanout N] [-skew X] [-seed N] [-reps N]\n");
+      return -1;
+    }
+    else if (arg == "-min-tags") minTags = std::max<std::uint64_t>(1, value);
+    else if (arg == "-max-tags") maxTags = std::max<std::uint64_t>(1, value);
+    else if (arg == "-depth") params.MaxDepth = (unsigned int)std::clamp<std::uint64_t>(value, 1, MaxGeneratedDepth);
+    else if (arg == "-fanout") params.FanOut = (unsigned int)std::clamp<std::uint64_t>(value, 1, MaxGeneratedFanOut);
+    else if (arg == "-seed") params.Seed = value;
+    else if (arg == "-reps") reps = (unsigned int)std::max<std::uint64_t>(1, value);
+    else
+    {
+      fprintf(stderr, "Unknown param %s\n", arg.c_str());
+      return -1;
+    }
+  }
+
+  if (!generateFile.empty())
+  {
+    params.NumTags = maxTags;
+    const std::uint64_t numLines = GenerateTagFile(params, generateFile);
+    printf("Wrote %llu tags to %s\n", (unsigned long long)numLines, generateFile.c_str());
+    return numLines ? 0 : -2;
+  }
+
+  using PipelineFunc = bool(*)(const std::string&, PipelineRun&);
+  const std::pair<const char*, PipelineFunc> pipelines[] =
+  {
+    { "LoadQuickTagsFromFile", RunStreamPipeline },
+    { "LoadQuickTagsFromMappedFile", RunMappedPipeline },
+    { "ListTree", RunListTreePipeline },
+  };
+
+  std::vector<PipelineRun> runs;
+  for (std::uint64_t numTags = minTags; numTags <= maxTags; numTags *= 10)
+  {
+    params.NumTags = numTags;
+    const std::string path = workDir + "/quicktags-loadbench-" + std::to_string(numTags) + ".txt";
+    const std::uint64_t numLines = GenerateTagFile(params, path);
+    if (numLines == 0)
+    {
+      fprintf(stderr, "Failed to write %s\n", path.c_str());
+      return -2;
+    }
+    if (numLines < numTags)
+    {
+      printf("Only %llu distinct tags with this depth, fan-out and skew\n", (unsigned long long)numLines);
+    }
+
+    for (const std::pair<const char*, PipelineFunc>& pipeline : pipelines)
+    {
+      // Keep the fastest repetition, the others mostly measure noise
+      PipelineRun best;
+      for (unsigned int rep = 0; rep < reps; ++rep)
+      {
+        PipelineRun run;
+        run.Pipeline = pipeline.first;
+        run.NumLines = numLines;
+        run.FileBytes = GetFileSize(path);
+        if (!pipeline.second(path, run))
+        {
+          fprintf(stderr, "Failed to load %s\n", path.c_str());
+          return -3;
+        }
+        if (rep == 0 || run.Stats.GetTotalMilliseconds() < best.Stats.GetTotalMilliseconds())
+        {
+          best = std::move(run);
+        }
+      }
+      PrintRun(best);
+      runs.push_back(std::move(best));
+    }
+    std::remove(path.c_str());
+
+    if (numTags > maxTags / 10)
+    {
+      break;
+    }
+  }
+
+  if (!outputFile.empty())
+  {
+    FILE* outFile = fopen(outputFile.c_str(), "w");
+    if (!outFile)
+    {
+      fprintf(stderr, "Failed to open %s\n", outputFile.c_str());
+      return -1;
+    }
+    WriteJson(outFile, params, reps, runs);
+    fclose(outFile);
+    printf("Wrote %zu runs to %s\n", runs.size(), outputFile.c_str());
+  }
+  return 0;
+}
@@ -1,8 +1,28 @@
 #include "QuickTags.hpp"
 #include "QuickTags-Loader.hpp"
+#include "QuickTags-Container.hpp"
+#include "QuickTags-Batch.hpp"
+#include "QuickTags-Bitset.hpp"
+#include "QuickTags-Query.hpp"
+#include "QuickTags-Index.hpp"
+#include "QuickTags-Search.hpp"
+#include "QuickTags-Format.hpp"
+#include "QuickTags-Resolver.hpp"
+#include "QuickTags-ConcurrentRegistry.hpp"
+#include "QuickTags-Layout.hpp"
+#include "QuickTags-Codec.hpp"
+#include "QuickTags-Map.hpp"
+#include "QuickTags-Migration.hpp"
+#include "QuickTags-Literal.hpp"
 
 #include <cstdio>
 
+// Tags.txt embedded, so literals resolve against the registry the loader reads at runtime
+constexpr std::string_view EmbeddedTagNames[] =
+{
+  "A", "A.1", "A.2", "A.2.1", "A.2.2", "A.2.3", "A.3", "B.1", "B.1.1.1", "B.2", "B.3", "C.A.B.C.D"
+};
+
 int main(int argc, char** argv)
 {
   using QTag = QuickTag<uint32_t, 4, 8, 12, 8>;
@@ -20,6 +40,86 @@ int main(int argc, char** argv)
   printf("tag.Matches(tag2): %d\n", tag.Matches(tag2));
   printf("tag2.Matches(tag): %d\n", tag2.Matches(tag));
 
+  QuickTagContainer<QTag> container = { tag, QTag::MakeTag(2, 1) };
+  QuickTagContainer<QTag> query = { tag2, QTag::MakeTag(3) };
+  printf("container.HasTag(tag2): %d\n", container.HasTag(tag2));
+  printf("container.HasTagExact(tag2): %d\n", container.HasTagExact(tag2));
+  printf("container.HasAny(query): %d\n", container.HasAny(query));
+  printf("container.HasAll(query): %d\n", container.HasAll(query));
+
+  const QTag batchTags[] = { tag, tag2, QTag::MakeTag(1, 3), QTag::MakeTag(2, 2) };
+  std::uint64_t batchBits[QTagUtil::Batch::GetNumResultWords(4)];
+  QTagUtil::MatchesBatch<QTag>(batchTags, tag2, batchBits);
+  printf("MatchesBatch(tag2): 0x%llx\n", (unsigned long long)batchBits[0]);
+
+  // 24-byte base type, which has no SIMD kernel, over enough tags for several full blocks
+  using WideQTag = QuickTag<QTagUtil::UIntN<3>, 60, 60, 60>;
+  std::vector<WideQTag> wideTags;
+  for (std::uint64_t i = 0; i < 200; ++i)
+  {
+    wideTags.push_back(WideQTag::MakeTag(1 + i % 3, 1 + i % 5, 1 + i % 7));
+  }
+  const WideQTag wideQuery = WideQTag::MakeTag(2, 3);
+  std::uint64_t wideBits[QTagUtil::Batch::GetNumResultWords(200)];
+  QTagUtil::MatchesBatch<WideQTag>(wideTags, wideQuery, wideBits);
+  int wideMismatches = 0;
+  for (std::size_t i = 0; i < wideTags.size(); ++i)
+  {
+    wideMismatches += int(bool((wideBits[i / 64] >> (i % 64)) & 1) != wideTags[i].Matches(wideQuery));
+  }
+  printf("MatchesBatch(UIntN<3>): %d mismatches\n", wideMismatches);
+
+  using QTagExpr = QuickTagQueryExpr<QTag>;
+  const QuickTagQuery<QTag> compiledQuery(QTagExpr::AllExprMatch({
+    QTagExpr::AnyTagsMatch({ tag2, QTag::MakeTag(3) }),
+    QTagExpr::NoTagsExact({ tag2 }) }));
+  printf("compiledQuery.Evaluate(container): %d\n", compiledQuery.Evaluate(container));
+
+  QuickTagIndex<QTag> entityIndex;
+  entityIndex.Add(tag, 7);
+  entityIndex.Add(QTag::MakeTag(1, 3), 9);
+  entityIndex.Add(QTag::MakeTag(2, 1), 11);
+  std::vector<std::uint32_t> entities;
+  entityIndex.Find(QTag::MakeTag(1), entities);
+  printf("entityIndex.Find(1): %zu entities\n", entities.size());
+
+  const QTag sortedTags[] = { tag2, tag, QTag::MakeTag(1, 3), QTag::MakeTag(2, 2) };
+  QuickTagSortedSearch<QTag> search;
+  search.Build(sortedTags);
+  const QuickTagSortedSearch<QTag>::Range range = search.FindRange(tag2);
+  printf("search.FindRange(tag2): [%u, %u)\n", range.Begin, range.End);
+
+  // Inherited config: 1.2.3 has no entry of its own and falls back to 1.2, then 1
+  QuickTagMap<QTag, float> modifiers;
+  modifiers.Add(QTag::MakeTag(1), 1.0f);
+  modifiers.Add(tag2, 1.5f);
+  QTag modifierTag;
+  const float* modifier = modifiers.FindNearestAncestor(tag, &modifierTag);
+  const QTag modifierQueries[] = { tag, QTag::MakeTag(1, 3), QTag::MakeTag(2) };
+  const float* modifierResults[std::size(modifierQueries)];
+  modifiers.FindNearestAncestorMany(modifierQueries, modifierResults);
+  printf("modifiers.FindNearestAncestor(tag): %.1f from depth %d, 1.3 = %.1f, 2 found = %d\n", *modifier, modifierTag.GetDepth(),
+    *modifierResults[1], modifierResults[2] != nullptr);
+
+  // Runtime additions keep earlier values, and are refused once a field is full
+  QuickTagConcurrentRegistry<QTag> liveRegistry;
+  const std::string_view liveTags[] = { "A.2.1", "B" };
+  liveRegistry.AddTags(liveTags);
+  const QTag liveTag = liveRegistry.Resolve("A.2.1");
+  liveRegistry.AddTag("A.1");
+  std::vector<std::uint32_t> overflowingFields;
+  liveRegistry.AddTag("C.D.E.F.G", &overflowingFields);
+  char liveName[64];
+  printf("liveRegistry v%llu: A.2.1 kept = %d, %s, overflowing fields = %zu\n", (unsigned long long)liveRegistry.GetVersion(),
+    liveRegistry.Resolve("A.2.1") == liveTag, liveRegistry.GetName(QTag::MakeTag(1, 1), liveName).data(), overflowingFields.size());
+
+  // A restart seeded with the manifest gives the same values, even with the tags added in another order
+  QuickTagConcurrentRegistry<QTag> restartedRegistry(liveRegistry.GetManifest());
+  restartedRegistry.AddTag("A.1");
+  restartedRegistry.AddTags(liveTags);
+  printf("restartedRegistry: A.2.1 kept = %d, A.1 kept = %d\n", restartedRegistry.Resolve("A.2.1") == liveTag,
+    restartedRegistry.Resolve("A.1") == liveRegistry.Resolve("A.1"));
+
   using QTag2 = QuickTag<uint8_t, 2, 2, 2, 1, 1>;
 
   std::fstream file = std::fstream("../../../../src/Tags.txt", std::ios_base::in);
@@ -34,15 +134,94 @@ int main(int argc, char** argv)
 
   for (const std::pair<QTag2, std::string>& tag : tagStringMap)
   {
-    char* tagString = tag.first.ValueAsString();
+    char tagString[QTag2::MaxStringLength + 1];
+    tag.first.ToChars(tagString, sizeof(tagString));
     printf("%s:\t%s\n", tagString, tag.second.c_str());
-    delete[] tagString;
   }
 
+  // Whole batch in one buffer, sized once
+  std::string tagDump;
+  QTagUtil::AppendTags(std::span<const QTag2>(tags), tagDump, ' ');
+  printf("All tags: %s\n", tagDump.c_str());
+
   for (const QTag2& tag : tags)
   {
     printf("%d\n", tag.GetRaw());
   }
 
+  // Resolved at compile time, C.A.B is only there as the parent of C.A.B.C.D
+  constexpr QTag2 literalTag = QTAG_LITERAL(QTag2, EmbeddedTagNames, "A.2.1");
+  constexpr QTag2 parentLiteralTag = QTAG_LITERAL(QTag2, EmbeddedTagNames, "C.A.B");
+  printf("QTAG_LITERAL: A.2.1 = %d matches loader %d, C.A.B = %d matches loader %d\n", literalTag.GetRaw(), tagStringMap[literalTag] == "A.2.1",
+    parentLiteralTag.GetRaw(), tagStringMap[parentLiteralTag] == "C.A.B");
+
+  // Names back to tags, folding case on the way in
+  std::fstream resolverFile = std::fstream("../../../../src/Tags.txt", std::ios_base::in);
+  std::set<std::string> resolverStrings;
+  QTagUtil::BuildTagStringSetFromFile(resolverFile, resolverStrings, QTagUtil::ETagSetFlags::CaseInsensitive);
+  QTagUtil::FlatTagTree resolverTree;
+  resolverTree.Build(resolverStrings);
+  QuickTagResolver<QTag2> resolver;
+  resolver.Build(resolverTree, QTagUtil::ETagSetFlags::CaseInsensitive);
+  const std::string_view namesToResolve[] = { "C.A.B", "c.a.b.c", "C.A.X", "B.A" };
+  QTag2 resolvedTags[std::size(namesToResolve)];
+  const std::size_t numResolved = resolver.ResolveMany(namesToResolve, resolvedTags);
+  printf("resolver.ResolveMany: %zu resolved, C.A.B = %d, c.a.b.c = %d\n", numResolved, resolvedTags[0].GetRaw(), resolvedTags[1].GetRaw());
+
+  // Every depth here is needed in full, so there's nothing smaller to propose
+  std::list<QTagUtil::TagTreeNode> layoutTrees;
+  QTagUtil::TreeifyTags(resolverStrings, layoutTrees);
+  QTagUtil::EnumerateTags(layoutTrees);
+  QTagUtil::LayoutReport layoutReport;
+  QTagUtil::AnalyseLayout(layoutTrees, layoutReport);
+  printf("AnalyseLayout: %u bits, heaviest %s, %zu proposals\n", layoutReport.UsedBits,
+    layoutReport.HeaviestSubtrees.empty() ? "none" : layoutReport.HeaviestSubtrees.front().Name.c_str(), layoutReport.Proposals.size());
+
+  // Tag sets to bytes and back, with and without the registry as a dictionary
+  const QuickTagContainer<QTag2> codecSets[] = { { tags[1], tags[2], tags[4] }, { tags.back() }, {} };
+  for (const std::span<const QTag2> dictionary : { std::span<const QTag2>(), std::span<const QTag2>(tags) })
+  {
+    std::vector<std::uint8_t> codecBuffer;
+    QuickTagSetEncoder<QTag2> encoder(codecBuffer, dictionary);
+    encoder.EncodeMany(std::span<const QuickTagContainer<QTag2>>(codecSets));
+    QuickTagContainer<QTag2> decodedSets[std::size(codecSets)];
+    QuickTagSetDecoder<QTag2> decoder(codecBuffer, dictionary);
+    const std::size_t numDecoded = decoder.DecodeMany(std::span<QuickTagContainer<QTag2>>(decodedSets));
+    printf("QuickTagSetDecoder (%s): %zu bytes, %zu sets, first set equal %d\n", dictionary.empty() ? "prefix" : "dictionary",
+      codecBuffer.size(), numDecoded, decodedSets[0] == codecSets[0]);
+  }
+
+  // Next revision of the tag files renames A.2 with a redirect and drops B.1.1.1
+  std::fstream renamedFile = std::fstream("../../../../src/Tags_Renamed.txt", std::ios_base::in);
+  std::map<QTag2, std::string> renamedStringMap;
+  std::vector<QTag2> renamedTags;
+  QTagUtil::LoadQuickTagsFromFile(renamedFile, renamedStringMap, renamedTags);
+  renamedFile.clear();
+  renamedFile.seekg(0);
+  std::vector<QTagUtil::TagRedirect> redirects;
+  QTagUtil::ReadTagRedirects(renamedFile, redirects);
+  QuickTagRemap<QTag2> remap;
+  QTagUtil::TagRemapStats remapStats;
+  remap.Build(tagStringMap, renamedStringMap, redirects, QTagUtil::ERemovedTagPolicy::NearestAncestor, &remapStats);
+  std::vector<QTag2> migratedTags = tags;
+  const std::size_t numUnknown = remap.RemapInPlace(migratedTags);
+  printf("QuickTagRemap: %zu unchanged, %zu moved, %zu redirected, %zu to ancestor, %zu unknown, A.2.1 -> %s\n", remapStats.NumUnchanged,
+    remapStats.NumMoved, remapStats.NumRedirected, remapStats.NumToAncestor, numUnknown, renamedStringMap[remap.Remap(QTag2::MakeTag(1, 2, 1))].c_str());
+
+  // A rename that a later revision undoes isn't a cycle, the latest redirect wins
+  const QTagUtil::TagRedirect undoneRedirects[] = { { "A.2", "A.Two" }, { "A.Two", "A.2" } };
+  QuickTagRemap<QTag2> undoneRemap;
+  const bool bUndoneBuilt = undoneRemap.Build(tagStringMap, tagStringMap, undoneRedirects);
+  printf("QuickTagRemap (undone rename): built = %d, A.2.1 -> %s\n", bUndoneBuilt, tagStringMap[undoneRemap.Remap(QTag2::MakeTag(1, 2, 1))].c_str());
+
+  // Loaded tags come out sorted, so they can seed the ordinals directly
+  QuickTagOrdinalTable<QTag2> ordinals;
+  ordinals.Build(tags);
+  QuickTagBitset<QTag2> entityTags(ordinals);
+  QuickTagBitset<QTag2> queryTags(ordinals);
+  entityTags.AddTag(tags.back());
+  queryTags.AddTag(QTag2(tags.back().GetRaw() & QTag2::GetPrefixMask(1)));
+  printf("entityTags.HasAll(queryTags): %d\n", entityTags.HasAll(queryTags));
+
   return 0;
 }
\ No newline at end of file